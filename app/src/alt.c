@@ -0,0 +1,429 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include "map.h"
+#include "path.h"
+#include "world.h"
+#include "graph.h"
+#include "heap.h"
+#include "alt.h"
+
+//#define dprintf(...) fprintf(stderr, __VA_ARGS__)
+#define dprintf(str, ...)
+
+// ALT: A* with landmark bounds
+//
+// For any landmark L, the triangle inequality gives two lower bounds on the
+// cost of getting from v to the goal t:
+//     d(L, t) - d(L, v)   since d(L, t) <= d(L, v) + d(v, t)
+//     d(v, L) - d(t, L)   since d(v, L) <= d(v, t) + d(t, L)
+// A move pays the tile it enters, so costs are not symmetric and both
+// directions are kept: a Dijkstra from each landmark fills the from table,
+// one over reversed moves fills the to table. Each bound is consistent, so
+// their maximum with the octile distance is too, and A* still settles every
+// node once. Around walls and expensive tiles the bounds are far tighter
+// than the octile distance, which cannot see them.
+//
+// Landmarks are placed farthest first: the first is the cell farthest from
+// the middle of the map, every next one the cell farthest from all landmarks
+// so far. Landmarks on the rim of the map bound best, and this finds them.
+
+void alt_ctor(alt * alt, int size)
+{
+    alt->size = size > 0 ? size : ALT_LANDMARKS;
+    alt->w = 0;
+    alt->h = 0;
+    alt->count = 0;
+    alt->marks = NULL;
+    alt->from = NULL;
+    alt->to = NULL;
+    alt->checksum = 0;
+}
+
+void alt_dtor(alt * alt)
+{
+    free(alt->marks);
+    free(alt->from);
+    free(alt->to);
+}
+
+static
+void alt_alloc(alt * alt, int w, int h, int stride)
+{
+    size_t n = (size_t) w * h * stride;
+    alt->w = w;
+    alt->h = h;
+    alt->marks = (coord *) realloc(alt->marks, sizeof(coord) * stride);
+    alt->from = (uint32_t *) realloc(alt->from, sizeof(uint32_t) * n);
+    alt->to = (uint32_t *) realloc(alt->to, sizeof(uint32_t) * n);
+}
+
+// Dijkstra over the whole map from root. reverse follows moves backwards,
+// so a node's cost is that of getting from it to root: the move from a
+// node pays the tile it enters, which is the node just expanded
+static
+void sweep(const map * map, search * search, const coord * root, bool reverse)
+{
+    graph graph;
+    heap heap;
+
+    gen_graph(&graph, search);
+    heap_ctor(&heap, search);
+
+    idx_t idx = graph_idx(&graph, root->x, root->y);
+    graph_touch(&graph, idx);
+    graph.cost[idx] = 0;
+    heap_push(&heap, idx, 0);
+
+    while (heap_pop(&heap, &idx)) {
+        coord curr = {.x = idx % graph.w, .y = idx / graph.w};
+        bit_set(graph.visit, idx);
+
+        // a wall can start a path but never be passed through
+        int32_t here = tile_cost(map, curr.x, curr.y);
+        if (reverse && here == (int32_t) 0xDEADBEEF)
+            continue;
+
+        for (int i = 0; i < 8; i += 1) {
+            coord next = {.x = curr.x + dirs[i][0], .y = curr.y + dirs[i][1]};
+
+            if (next.x < 0 || next.x >= graph.w ||
+                next.y < 0 || next.y >= graph.h)
+                continue;
+
+            int32_t tile = tile_cost(map, next.x, next.y);
+            if (!reverse && tile == (int32_t) 0xDEADBEEF)
+                continue;
+
+            idx_t n = graph_idx(&graph, next.x, next.y);
+            graph_touch(&graph, n);
+            if (bit_get(graph.visit, n))
+                continue;
+
+            cost_t cost = graph.cost[idx] + dirs[i][2] +
+                          ((reverse ? here : tile) << 1);
+            if (cost < graph.cost[n]) {
+                graph.cost[n] = cost;
+                heap_push(&heap, n, cost);
+            }
+        }
+    }
+    heap_dtor(&heap);
+}
+
+// copy the last sweep's costs into column k of table. a landmark with a
+// cost too large to store gives no bounds at all rather than wrong ones
+static
+void store(search * search, uint32_t * table, int stride, int k)
+{
+    graph graph;
+    graph_view(&graph, search);
+    idx_t n = (idx_t) graph.w * graph.h;
+    bool wide = false;
+    for (idx_t i = 0; i < n; ++i) {
+        graph_touch(&graph, i);
+        cost_t c = graph.cost[i];
+        wide |= c != COST_INF && c >= ALT_INF;
+        table[i * stride + k] = c >= ALT_INF ? ALT_INF : (uint32_t) c;
+    }
+    if (wide) {
+        for (idx_t i = 0; i < n; ++i)
+            table[i * stride + k] = ALT_INF;
+    }
+}
+
+// the passable cell farthest from its nearest landmark in the first
+// placed columns of the from table; false if every reachable cell is one
+static
+bool farthest(const alt * alt, const map * map, int stride, int placed, coord * out)
+{
+    uint32_t best = 0;
+    idx_t at = -1;
+    idx_t n = (idx_t) map->w * map->h;
+    for (idx_t i = 0; i < n; ++i) {
+        if (tile_cost_idx(map, i) == (int32_t) 0xDEADBEEF)
+            continue;
+        uint32_t near = ALT_INF;
+        for (int k = 0; k < placed; ++k) {
+            uint32_t d = alt->from[i * stride + k];
+            near = d < near ? d : near;
+        }
+        if (near != ALT_INF && near > best) {
+            best = near;
+            at = i;
+        }
+    }
+    if (at < 0)
+        return false;
+    out->x = at % map->w;
+    out->y = at / map->w;
+    return true;
+}
+
+void alt_build(alt * alt, search * search, const map * map)
+{
+    struct search_ scratch;
+    int stride = alt->size;
+
+    search = search_acquire(search, &scratch, map);
+    alt_alloc(alt, map->w, map->h, stride);
+    alt->count = 0;
+    alt->checksum = map_hash(map);
+
+    // the first landmark is measured from the passable cell nearest the
+    // middle, which is most likely in the map's main open region
+    idx_t n = (idx_t) map->w * map->h;
+    idx_t seed = n;
+    coord mid = {.x = map->w / 2, .y = map->h / 2};
+    int64_t near = INT64_MAX;
+    for (idx_t i = 0; i < n; ++i) {
+        int64_t dx = i % map->w - mid.x;
+        int64_t dy = i / map->w - mid.y;
+        if (dx * dx + dy * dy < near && tile_cost_idx(map, i) != (int32_t) 0xDEADBEEF) {
+            near = dx * dx + dy * dy;
+            seed = i;
+        }
+    }
+
+    if (seed < n) {
+        coord root = {.x = seed % map->w, .y = seed / map->w};
+        sweep(map, search, &root, false);
+        store(search, alt->from, stride, 0);
+    }
+
+    // column 0 holds the seed's costs until the first landmark's replace
+    // them; the next landmark is always the farthest from those placed
+    while (alt->count < stride && seed < n) {
+        coord mark;
+        int placed = alt->count > 0 ? alt->count : 1;
+        if (!farthest(alt, map, stride, placed, &mark))
+            break;
+        dprintf("landmark %d: (%d, %d)\n", alt->count, mark.x, mark.y);
+
+        int k = alt->count;
+        alt->marks[k] = mark;
+        sweep(map, search, &mark, false);
+        store(search, alt->from, stride, k);
+        sweep(map, search, &mark, true);
+        store(search, alt->to, stride, k);
+        alt->count += 1;
+    }
+
+    // fewer landmarks than asked for: close up the tables
+    if (alt->count < stride) {
+        for (idx_t i = 0; i < n; ++i) {
+            for (int k = 0; k < alt->count; ++k) {
+                alt->from[i * alt->count + k] = alt->from[i * stride + k];
+                alt->to[i * alt->count + k] = alt->to[i * stride + k];
+            }
+        }
+    }
+    search_release(search, &scratch);
+}
+
+int alt_save(const alt * alt, const char * file_name)
+{
+    FILE * file = fopen(file_name, "wb");
+    if (file == NULL)
+        return 1;
+
+    char head[ALT_DATA] = {0};
+    alt_header * header = (alt_header *) head;
+    header->magic = ALT_MAGIC;
+    header->version = ALT_VERSION;
+    header->w = alt->w;
+    header->h = alt->h;
+    header->count = alt->count;
+    header->checksum = alt->checksum;
+
+    size_t cells = (size_t) alt->w * alt->h * alt->count;
+    int err = fwrite(head, 1, ALT_DATA, file) != ALT_DATA ||
+              fwrite(alt->marks, sizeof(coord), alt->count, file) != (size_t) alt->count ||
+              fwrite(alt->from, sizeof(uint32_t), cells, file) != cells ||
+              fwrite(alt->to, sizeof(uint32_t), cells, file) != cells;
+    err |= fclose(file) != 0;
+    return err;
+}
+
+int alt_load(alt * alt, const char * file_name, const map * map)
+{
+    FILE * file = fopen(file_name, "rb");
+    if (file == NULL)
+        return 1;
+
+    char head[ALT_DATA];
+    alt_header * header = (alt_header *) head;
+    if (fread(head, 1, ALT_DATA, file) != ALT_DATA ||
+        header->magic != ALT_MAGIC || header->version != ALT_VERSION ||
+        header->w != map->w || header->h != map->h ||
+        header->count < 0 || header->count > alt->size ||
+        header->checksum != map_hash(map)) {
+        fclose(file);
+        return 1;
+    }
+
+    alt_alloc(alt, header->w, header->h, header->count);
+    alt->count = header->count;
+    alt->checksum = header->checksum;
+
+    size_t cells = (size_t) alt->w * alt->h * alt->count;
+    int err = fread(alt->marks, sizeof(coord), alt->count, file) != (size_t) alt->count ||
+              fread(alt->from, sizeof(uint32_t), cells, file) != cells ||
+              fread(alt->to, sizeof(uint32_t), cells, file) != cells;
+    fclose(file);
+    if (err) {
+        // never leave tables that only look built
+        alt->w = 0;
+        alt->h = 0;
+        alt->count = 0;
+    }
+    return err;
+}
+
+// the landmarks one query bounds with, and their costs to and from its goal
+typedef struct target_
+{
+    const coord * goal;
+    int count;
+    int mark[ALT_ACTIVE];
+    uint32_t from_goal[ALT_ACTIVE];     // d(L, goal); 0 gives no bound
+    uint32_t to_goal[ALT_ACTIVE];       // d(goal, L); ALT_INF gives none
+} target;
+
+// the octile distance or the tightest landmark bound, whichever is larger
+static inline
+cost_t bound(const alt * alt, const target * t, idx_t v, const coord * at)
+{
+    cost_t h = octile(at, t->goal);
+    const uint32_t * from = alt->from + v * alt->count;
+    const uint32_t * to = alt->to + v * alt->count;
+    for (int j = 0; j < t->count; ++j) {
+        uint32_t f = from[t->mark[j]];
+        uint32_t b = to[t->mark[j]];
+        if (t->from_goal[j] > f && t->from_goal[j] - f > h)
+            h = t->from_goal[j] - f;
+        if (b != ALT_INF && b > t->to_goal[j] && b - t->to_goal[j] > h)
+            h = b - t->to_goal[j];
+    }
+    return h;
+}
+
+// keep the ALT_ACTIVE landmarks that bound the start best
+static
+void target_ctor(target * t, const alt * alt, const map * map,
+                 const coord * start, const coord * goal)
+{
+    idx_t s = start->x + (idx_t) map->w * start->y;
+    idx_t g = goal->x + (idx_t) map->w * goal->y;
+    cost_t gain[ALT_ACTIVE];
+
+    t->goal = goal;
+    t->count = 0;
+    for (int k = 0; k < alt->count; ++k) {
+        target one = {.goal = goal, .count = 1, .mark = {k}};
+        one.from_goal[0] = alt->from[g * alt->count + k];
+        one.to_goal[0] = alt->to[g * alt->count + k];
+        if (one.from_goal[0] == ALT_INF)
+            one.from_goal[0] = 0;
+        cost_t h = bound(alt, &one, s, start);
+
+        // the list stays sorted, best first; once full the worst drops out
+        int j = t->count;
+        if (j == ALT_ACTIVE) {
+            if (h <= gain[j - 1])
+                continue;
+            j -= 1;
+        }
+        else {
+            t->count += 1;
+        }
+        for (; j > 0 && gain[j - 1] < h; --j) {
+            gain[j] = gain[j - 1];
+            t->mark[j] = t->mark[j - 1];
+            t->from_goal[j] = t->from_goal[j - 1];
+            t->to_goal[j] = t->to_goal[j - 1];
+        }
+        gain[j] = h;
+        t->mark[j] = k;
+        t->from_goal[j] = one.from_goal[0];
+        t->to_goal[j] = one.to_goal[0];
+    }
+}
+
+static
+void alt_search(const alt * alt, const map * map, graph * graph, heap * heap,
+                const coord * start, const target * t, prof * prof)
+{
+    idx_t idx = graph_idx(graph, start->x, start->y);
+    graph_touch(graph, idx);
+    graph->cost[idx] = 0;
+    heap_push(heap, idx, bound(alt, t, idx, start));
+
+    while (heap_pop(heap, &idx)) {
+        prof->expand += 1;
+        coord curr = {.x = idx % graph->w, .y = idx / graph->w};
+        bit_set(graph->visit, idx);
+        dprintf("curr: (%d, %d)\n", curr.x, curr.y);
+        if (curr.x == t->goal->x && curr.y == t->goal->y)
+            break;
+
+        for (int i = 0; i < 8; i += 1) {
+            coord next = {.x = curr.x + dirs[i][0], .y = curr.y + dirs[i][1]};
+
+            if (next.x < 0 || next.x >= graph->w ||
+                next.y < 0 || next.y >= graph->h)
+                continue;
+
+            int32_t tile = tile_cost(map, next.x, next.y);
+            if (tile == (int32_t) 0xDEADBEEF)
+                continue;
+
+            idx_t n = graph_idx(graph, next.x, next.y);
+            graph_touch(graph, n);
+            if (bit_get(graph->visit, n))
+                continue;
+
+            cost_t cost = graph->cost[idx] + dirs[i][2] + (tile << 1);
+            if (cost < graph->cost[n]) {
+                graph->cost[n] = cost;
+                graph->dir[n] = dir_codes[(i + 4) & 7];
+                heap_push(heap, n, cost + bound(alt, t, n, &next));
+            }
+        }
+    }
+}
+
+void altpath_find(alt * alt, search * search, const map * map,
+                  const coord * start, const coord * end, path * path,
+                  prof * prof)
+{
+    struct search_ scratch;
+    target t;
+    heap heap;
+    graph graph;
+
+    prof_ctor(prof);
+
+    prof_start(prof);
+    path_ctor(path);
+    search = search_acquire(search, &scratch, map);
+    // map_hash is kept with the map, so this is cheap after the first query
+    if (alt->from == NULL || alt->checksum != map_hash(map))
+        alt_build(alt, search, map);
+    target_ctor(&t, alt, map, start, end);
+    gen_graph(&graph, search);
+    heap_ctor(&heap, search);
+    prof_end(prof); prof->prproc = prof_dt(prof);
+
+    prof_start(prof);
+    alt_search(alt, map, &graph, &heap, start, &t, prof);
+    prof_end(prof); prof->exec = prof_dt(prof);
+
+    prof_start(prof);
+    gen_path(&graph, start, end, path);
+    heap_dtor(&heap);
+    search_release(search, &scratch);
+    prof_end(prof); prof->poproc = prof_dt(prof);
+}
@@ -0,0 +1,84 @@
+#ifndef __ALT_H__
+#define __ALT_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+#include "map.h"
+#include "path.h"
+#include "world.h"
+#include "prof.h"
+
+// default number of landmarks
+#define ALT_LANDMARKS 8
+
+// landmarks a query takes its bounds from: the ones giving the best bound
+// at its start
+#define ALT_ACTIVE 4
+
+// distance too large to store, or unreachable; gives no bound
+#define ALT_INF UINT32_MAX
+
+// landmark files: a header, then the landmarks' coordinates at ALT_DATA,
+// then the from and to tables, in the byte order of the machine that wrote
+// them. checksum is map_hash of the map the tables were built for
+#define ALT_MAGIC 0x4C414B44    // "DKAL"
+#define ALT_VERSION 1
+#define ALT_DATA 64
+
+typedef struct alt_header_
+{
+    uint32_t magic;
+    uint32_t version;
+    int32_t w;
+    int32_t h;
+    int32_t count;
+    uint32_t reserved;
+    uint64_t checksum;
+} alt_header;
+
+// ALT (A*, landmarks, triangle inequality) tables of one map: the cost
+// from and to each landmark is stored for every cell, and a query bounds
+// the cost of the rest of its path with the triangle inequality through
+// them. paths are exactly the shortest.
+//
+// like hpa, build one per map and keep it; it is built on the first query
+// or read back with alt_load. the tables describe the map as it was built:
+// a query on a map whose map_hash differs, including the same map after a
+// tile changed, builds them again first
+typedef struct alt_
+{
+    int size;               // landmarks asked for
+    int w;                  // map size the tables are built for
+    int h;
+    int count;              // landmarks placed, at most size
+    coord * marks;
+    uint32_t * from;        // w * h * count, a cell's landmarks side by side
+    uint32_t * to;
+    uint64_t checksum;
+} alt;
+
+void alt_ctor(alt * alt, int size);
+void alt_dtor(alt * alt);
+
+// places the landmarks and fills the tables; search is the workspace the
+// Dijkstra from every landmark runs in, NULL builds one
+void alt_build(alt * alt, search * search, const map * map);
+
+// returns 0 on success
+int alt_save(const alt * alt, const char * file_name);
+// fails if the file was built for another map. returns 0 on success
+int alt_load(alt * alt, const char * file_name, const map * map);
+
+void altpath_find(alt * alt, search * search, const map * map,
+                  const coord * start, const coord * end, path * path,
+                  prof * prof);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif//__ALT_H__
@@ -0,0 +1,520 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include "map.h"
+#include "path.h"
+#include "world.h"
+#include "prof.h"
+#include "hpa.h"
+#include "alt.h"
+#include "ch.h"
+#include "hw.h"
+#include "emu.h"
+#include "hwtile.h"
+#include "backend.h"
+
+// Solver backends
+//
+// Every engine is reached through the same operations, so the command line
+// names one and drives it without knowing what it is. The software engines
+// share one set: submit runs the search there and then, and wait has
+// nothing left to do. Engines that precompute per map (hpa, alt, ch) keep
+// what they built, or what attach read, for later queries and build it
+// again only when map_hash says the map is another one; their find, which
+// batches run on many threads at once, builds it per query. The
+// accelerator maps its BRAM and control registers once in init, and submit
+// only starts the fabric. The emulator runs the same driver over emulated
+// BRAM and registers, and does the fabric's work in wait. Their tiled
+// variants take maps of any size, running a whole query of fabric windows
+// in submit.
+
+int backend_ctor(backend * backend, const backend_ops * ops)
+{
+    backend->ops = ops;
+    search_ctor(&backend->search, 0, 0);
+    backend->cold = false;
+    backend->ready = false;
+    backend->data = NULL;
+    int err = ops->init(backend);
+    if (err)
+        search_dtor(&backend->search);
+    return err;
+}
+
+void backend_dtor(backend * backend)
+{
+    backend->ops->teardown(backend);
+    search_dtor(&backend->search);
+}
+
+int backend_route(backend * backend, const map * map, const coord * start,
+                  const coord * end, path * path, prof * prof)
+{
+    const backend_ops * ops = backend->ops;
+    int err = ops->submit(backend, map, start, end, prof);
+    err = err || ops->wait(backend, prof);
+    ops->fetch(backend, path, prof);
+    return err;
+}
+
+int sw_init(backend * backend)
+{
+    return 0;
+}
+
+int sw_submit(backend * backend, const map * map, const coord * start,
+              const coord * end, prof * prof)
+{
+    if (backend->ready)
+        path_dtor(&backend->path);
+    backend->ops->find(backend->cold ? NULL : &backend->search, map, start,
+                       end, &backend->path, prof);
+    backend->ready = true;
+    return 0;
+}
+
+int sw_wait(backend * backend, prof * prof)
+{
+    return 0;
+}
+
+void sw_fetch(backend * backend, path * path, prof * prof)
+{
+    if (!backend->ready) {
+        path_ctor(path);
+        return;
+    }
+    *path = backend->path;
+    backend->ready = false;
+}
+
+void sw_teardown(backend * backend)
+{
+    if (backend->ready)
+        path_dtor(&backend->path);
+    backend->ready = false;
+}
+
+// Bellman-Ford over one tile per CPU
+static
+void tpath_cpus(search * search, const map * map, const coord * start,
+                const coord * end, path * path, prof * prof)
+{
+    tpath_find(search, map, start, end, path, prof, 0);
+}
+
+// every query builds its own abstraction, as pre-processing
+static
+void hpath_fresh(search * search, const map * map, const coord * start,
+                 const coord * end, path * path, prof * prof)
+{
+    hpa hpa;
+    hpa_ctor(&hpa, HPA_CLUSTER);
+    hpath_find(&hpa, search, map, start, end, path, prof);
+    hpa_dtor(&hpa);
+}
+
+static
+void altpath_fresh(search * search, const map * map, const coord * start,
+                   const coord * end, path * path, prof * prof)
+{
+    alt alt;
+    alt_ctor(&alt, ALT_LANDMARKS);
+    altpath_find(&alt, search, map, start, end, path, prof);
+    alt_dtor(&alt);
+}
+
+static
+void chpath_fresh(search * search, const map * map, const coord * start,
+                  const coord * end, path * path, prof * prof)
+{
+    ch ch;
+    ch_ctor(&ch);
+    chpath_find(&ch, search, map, start, end, path, prof);
+    ch_dtor(&ch);
+}
+
+// the abstraction kept across queries, and the map it was laid out for.
+// hpath_find only tells maps apart by size, so another map of the same
+// size gets a fresh one here
+typedef struct hpa_kept_
+{
+    hpa hpa;
+    uint64_t hash;
+} hpa_kept;
+
+static
+int hpa_submit(backend * backend, const map * map, const coord * start,
+               const coord * end, prof * prof)
+{
+    hpa_kept * kept = (hpa_kept *) backend->data;
+    uint64_t hash = map_hash(map);
+    if (kept == NULL) {
+        kept = (struct hpa_kept_ *) malloc(sizeof(struct hpa_kept_));
+        hpa_ctor(&kept->hpa, HPA_CLUSTER);
+        kept->hash = hash;
+        backend->data = kept;
+    }
+    else if (kept->hash != hash) {
+        hpa_dtor(&kept->hpa);
+        hpa_ctor(&kept->hpa, HPA_CLUSTER);
+        kept->hash = hash;
+    }
+    if (backend->ready)
+        path_dtor(&backend->path);
+    hpath_find(&kept->hpa, backend->cold ? NULL : &backend->search, map,
+               start, end, &backend->path, prof);
+    backend->ready = true;
+    return 0;
+}
+
+static
+void hpa_teardown(backend * backend)
+{
+    if (backend->data != NULL) {
+        hpa_dtor(&((hpa_kept *) backend->data)->hpa);
+        free(backend->data);
+    }
+    sw_teardown(backend);
+}
+
+// landmark tables saved by alt_map
+static
+int alt_attach(backend * backend, const char * map_path, const map * map)
+{
+    char alt_path[4096];
+    alt * alt = (struct alt_ *) malloc(sizeof(struct alt_));
+    alt_ctor(alt, ALT_LANDMARKS);
+    snprintf(alt_path, sizeof(alt_path), "%s.alt", map_path);
+    if (alt_load(alt, alt_path, map)) {
+        alt_dtor(alt);
+        free(alt);
+        return 1;
+    }
+    printf("Landmarks read from %s\n", alt_path);
+    // replaces any tables built or read before
+    if (backend->data != NULL) {
+        alt_dtor((struct alt_ *) backend->data);
+        free(backend->data);
+    }
+    backend->data = alt;
+    return 0;
+}
+
+static
+int alt_submit(backend * backend, const map * map, const coord * start,
+               const coord * end, prof * prof)
+{
+    // built on the first query unless attached, rebuilt on another map
+    if (backend->data == NULL) {
+        alt * alt = (struct alt_ *) malloc(sizeof(struct alt_));
+        alt_ctor(alt, ALT_LANDMARKS);
+        backend->data = alt;
+    }
+    if (backend->ready)
+        path_dtor(&backend->path);
+    altpath_find((alt *) backend->data, backend->cold ? NULL : &backend->search,
+                 map, start, end, &backend->path, prof);
+    backend->ready = true;
+    return 0;
+}
+
+static
+void alt_teardown(backend * backend)
+{
+    if (backend->data != NULL) {
+        alt_dtor((alt *) backend->data);
+        free(backend->data);
+    }
+    sw_teardown(backend);
+}
+
+// a hierarchy saved by ch_map
+static
+int ch_attach(backend * backend, const char * map_path, const map * map)
+{
+    char ch_path[4096];
+    ch * ch = (struct ch_ *) malloc(sizeof(struct ch_));
+    ch_ctor(ch);
+    snprintf(ch_path, sizeof(ch_path), "%s.ch", map_path);
+    if (ch_load(ch, ch_path, map)) {
+        ch_dtor(ch);
+        free(ch);
+        return 1;
+    }
+    printf("Hierarchy read from %s\n", ch_path);
+    // replaces any hierarchy built or read before
+    if (backend->data != NULL) {
+        ch_dtor((struct ch_ *) backend->data);
+        free(backend->data);
+    }
+    backend->data = ch;
+    return 0;
+}
+
+static
+int ch_submit(backend * backend, const map * map, const coord * start,
+              const coord * end, prof * prof)
+{
+    if (backend->data == NULL) {
+        ch * ch = (struct ch_ *) malloc(sizeof(struct ch_));
+        ch_ctor(ch);
+        backend->data = ch;
+    }
+    if (backend->ready)
+        path_dtor(&backend->path);
+    chpath_find((ch *) backend->data, backend->cold ? NULL : &backend->search,
+                map, start, end, &backend->path, prof);
+    backend->ready = true;
+    return 0;
+}
+
+static
+void ch_teardown(backend * backend)
+{
+    if (backend->data != NULL) {
+        ch_dtor((ch *) backend->data);
+        free(backend->data);
+    }
+    sw_teardown(backend);
+}
+
+// the accelerator, or its fabric emulated behind the same driver, and the
+// windows larger maps are routed through
+typedef struct board_
+{
+    hw hw;
+    emu * emu;                  // NULL on the board itself
+    hwtile tile;
+} board;
+
+static
+int board_open(backend * backend, bool emulated)
+{
+    board * b = (struct board_ *) malloc(sizeof(struct board_));
+    b->emu = NULL;
+    if (emulated) {
+        b->emu = (struct emu_ *) malloc(sizeof(struct emu_));
+        emu_ctor(b->emu, EMU_DIM, EMU_COST_SIZE);
+        emu_driver(b->emu, &b->hw);
+    }
+    else if (hw_ctor(&b->hw)) {
+        free(b);
+        return 1;
+    }
+    hwtile_ctor(&b->tile, &b->hw);
+    backend->data = b;
+    return 0;
+}
+
+static
+int hw_init(backend * backend)
+{
+    return board_open(backend, false);
+}
+
+static
+int emu_init(backend * backend)
+{
+    return board_open(backend, true);
+}
+
+static
+int hw_start(backend * backend, const map * map, const coord * start,
+             const coord * end, prof * prof)
+{
+    return hw_submit(&((board *) backend->data)->hw, map, start, end, prof);
+}
+
+static
+int hw_done(backend * backend, prof * prof)
+{
+    hw_wait(&((board *) backend->data)->hw, prof);
+    return 0;
+}
+
+static
+void hw_path(backend * backend, path * path, prof * prof)
+{
+    hw_fetch(&((board *) backend->data)->hw, path, prof);
+}
+
+// any map, through windows of the fabric
+static
+int tile_submit(backend * backend, const map * map, const coord * start,
+                const coord * end, prof * prof)
+{
+    if (backend->ready)
+        path_dtor(&backend->path);
+    hwtile_find(&((board *) backend->data)->tile, map, start, end,
+                &backend->path, prof);
+    backend->ready = true;
+    return 0;
+}
+
+static
+void hw_teardown(backend * backend)
+{
+    board * b = (board *) backend->data;
+    hwtile_dtor(&b->tile);
+    hw_dtor(&b->hw);
+    if (b->emu != NULL) {
+        emu_dtor(b->emu);
+        free(b->emu);
+    }
+    free(b);
+    sw_teardown(backend);
+}
+
+#define SW_BACKEND(ident, id, text, fn)     \
+static const backend_ops ident = {          \
+    .name = id,                             \
+    .about = text,                          \
+    .side = 0,                              \
+    .find = fn,                             \
+    .init = sw_init,                        \
+    .submit = sw_submit,                    \
+    .wait = sw_wait,                        \
+    .fetch = sw_fetch,                      \
+    .teardown = sw_teardown,                \
+    .attach = NULL,                         \
+}
+
+SW_BACKEND(sw_ops, "sw", "software FIFO label-correcting search", path_find);
+SW_BACKEND(dj_ops, "dj", "software Dijkstra on an indexed heap", dpath_find);
+SW_BACKEND(astar_ops, "astar", "software A* with early termination", apath_find);
+SW_BACKEND(dial_ops, "dial", "software Dijkstra on a bucket queue", bpath_find);
+SW_BACKEND(jps_ops, "jps", "software Jump Point Search", jpath_find);
+SW_BACKEND(bf_ops, "bf", "software Bellman-Ford sweep, as the fabric does it", ppath_find);
+SW_BACKEND(bfmt_ops, "bfmt", "software Bellman-Ford, one tile per thread", tpath_cpus);
+SW_BACKEND(bidj_ops, "bidj", "software bidirectional Dijkstra", bidpath_find);
+SW_BACKEND(bias_ops, "biastar", "software bidirectional A*", biapath_find);
+
+static const backend_ops hpa_ops = {
+    .name = "hpa",
+    .about = "software hierarchical A* over map clusters",
+    .side = 0,
+    .find = hpath_fresh,
+    .init = sw_init,
+    .submit = hpa_submit,
+    .wait = sw_wait,
+    .fetch = sw_fetch,
+    .teardown = hpa_teardown,
+    .attach = NULL,
+};
+
+static const backend_ops alt_ops = {
+    .name = "alt",
+    .about = "software A* with landmark bounds",
+    .side = 0,
+    .find = altpath_fresh,
+    .init = sw_init,
+    .submit = alt_submit,
+    .wait = sw_wait,
+    .fetch = sw_fetch,
+    .teardown = alt_teardown,
+    .attach = alt_attach,
+};
+
+static const backend_ops ch_ops = {
+    .name = "ch",
+    .about = "software contraction hierarchy",
+    .side = 0,
+    .find = chpath_fresh,
+    .init = sw_init,
+    .submit = ch_submit,
+    .wait = sw_wait,
+    .fetch = sw_fetch,
+    .teardown = ch_teardown,
+    .attach = ch_attach,
+};
+
+static const backend_ops hw_ops = {
+    .name = "hw",
+    .about = "hardware accelerator",
+    .side = FABRIC_DIM,
+    .find = NULL,
+    .init = hw_init,
+    .submit = hw_start,
+    .wait = hw_done,
+    .fetch = hw_path,
+    .teardown = hw_teardown,
+    .attach = NULL,
+};
+
+static const backend_ops emu_ops = {
+    .name = "emu",
+    .about = "the accelerator's fabric emulated in software",
+    .side = EMU_DIM,
+    .find = NULL,
+    .init = emu_init,
+    .submit = hw_start,
+    .wait = hw_done,
+    .fetch = hw_path,
+    .teardown = hw_teardown,
+    .attach = NULL,
+};
+
+static const backend_ops hwtile_ops = {
+    .name = "hwtile",
+    .about = "hardware accelerator, through windows for larger maps",
+    .side = 0,
+    .find = NULL,
+    .init = hw_init,
+    .submit = tile_submit,
+    .wait = sw_wait,
+    .fetch = sw_fetch,
+    .teardown = hw_teardown,
+    .attach = NULL,
+};
+
+static const backend_ops emutile_ops = {
+    .name = "emutile",
+    .about = "emulated fabric, through windows for larger maps",
+    .side = 0,
+    .find = NULL,
+    .init = emu_init,
+    .submit = tile_submit,
+    .wait = sw_wait,
+    .fetch = sw_fetch,
+    .teardown = hw_teardown,
+    .attach = NULL,
+};
+
+static const backend_ops * const builtin[] = {
+    &sw_ops, &dj_ops, &astar_ops, &dial_ops, &jps_ops, &bf_ops, &bfmt_ops,
+    &bidj_ops, &bias_ops, &hpa_ops, &alt_ops, &ch_ops, &hw_ops, &emu_ops,
+    &hwtile_ops, &emutile_ops,
+};
+
+#define BUILTIN (int) (sizeof(builtin) / sizeof(builtin[0]))
+
+static const backend_ops * extra[BACKEND_MAX];
+static int extras = 0;
+
+const backend_ops * backend_at(int i)
+{
+    if (i < 0 || i >= BUILTIN + extras)
+        return NULL;
+    return i < BUILTIN ? builtin[i] : extra[i - BUILTIN];
+}
+
+const backend_ops * backend_find(const char * name)
+{
+    const backend_ops * ops;
+    for (int i = 0; (ops = backend_at(i)) != NULL; ++i) {
+        if (!strcmp(ops->name, name))
+            return ops;
+    }
+    return NULL;
+}
+
+int backend_register(const backend_ops * ops)
+{
+    if (BUILTIN + extras >= BACKEND_MAX || backend_find(ops->name) != NULL)
+        return 1;
+    extra[extras++] = ops;
+    return 0;
+}
@@ -0,0 +1,99 @@
+#ifndef __BACKEND_H__
+#define __BACKEND_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+
+#include "map.h"
+#include "path.h"
+#include "world.h"
+#include "prof.h"
+#include "batch.h"
+
+// most backends the registry holds, built in ones included
+#define BACKEND_MAX 32
+
+typedef struct backend_ backend;
+
+// what a solver backend does, in the order a query goes through it.
+// submit may return before the path is found; wait blocks until it is, and
+// fetch hands it to the caller, who destroys it. a backend routes one
+// query at a time
+typedef struct backend_ops_
+{
+    const char * name;          // as given on the command line
+    const char * about;
+    int side;                   // largest map side it routes; 0 for any
+    path_fn find;               // single query software engine, or NULL
+
+    // return 0 on success
+    int (*init)(backend * backend);
+    int (*submit)(backend * backend, const map * map, const coord * start,
+                  const coord * end, prof * prof);
+    int (*wait)(backend * backend, prof * prof);
+    void (*fetch)(backend * backend, path * path, prof * prof);
+    void (*teardown)(backend * backend);
+
+    // optional: pick up what was precomputed and saved next to the map at
+    // map_path, so later queries on it skip building it. 0 if it did
+    int (*attach)(backend * backend, const char * map_path, const map * map);
+} backend_ops;
+
+// one backend in use: it keeps its mappings and scratch from init to
+// teardown, so they are set up once rather than per query
+struct backend_
+{
+    const backend_ops * ops;
+    search search;              // workspace of the software engines
+    bool cold;                  // software engines build one per query
+    path path;                  // found by the last submit, not yet fetched
+    bool ready;
+    void * data;                // whatever else the backend keeps
+};
+
+// returns 0 on success
+int backend_ctor(backend * backend, const backend_ops * ops);
+void backend_dtor(backend * backend);
+
+static inline
+bool backend_fits(const backend_ops * ops, const map * map)
+{
+    return ops->side == 0 || (map->w <= ops->side && map->h <= ops->side);
+}
+
+// size the software workspace up front, so the first query does not grow it
+static inline
+void backend_reserve(backend * backend, int w, int h)
+{
+    search_dtor(&backend->search);
+    search_ctor(&backend->search, w, h);
+}
+
+// submit, wait and fetch in one go. returns 0 on success
+int backend_route(backend * backend, const map * map, const coord * start,
+                  const coord * end, path * path, prof * prof);
+
+// NULL if no backend goes by name
+const backend_ops * backend_find(const char * name);
+// registers a backend beside the built in ones. returns 0 on success
+int backend_register(const backend_ops * ops);
+// the i-th backend registered, NULL past the last one
+const backend_ops * backend_at(int i);
+
+// the software engines' shared operations, for backends that only bring a
+// find of their own
+int sw_init(backend * backend);
+int sw_submit(backend * backend, const map * map, const coord * start,
+              const coord * end, prof * prof);
+int sw_wait(backend * backend, prof * prof);
+void sw_fetch(backend * backend, path * path, prof * prof);
+void sw_teardown(backend * backend);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif//__BACKEND_H__
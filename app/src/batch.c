@@ -0,0 +1,160 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "map.h"
+#include "path.h"
+#include "world.h"
+#include "batch.h"
+
+typedef struct batch_worker_
+{
+    batch * batch;
+    int id;
+} worker;
+
+// take queries until none are left. the counter is the only thing the
+// threads share while solving; paths and workspaces are per query and
+// per thread
+static
+void drain(batch * b, int id)
+{
+    uint64_t expand = 0;
+    for (;;) {
+        int i = __atomic_fetch_add(&b->next, 1, __ATOMIC_RELAXED);
+        if (i >= b->count)
+            break;
+
+        const query * q = &b->queries[i];
+        prof prof;
+        b->find(&b->scratch[id], q->map, &q->start, &q->end, &b->paths[i], &prof);
+        expand += prof.expand;
+    }
+    b->expand[id] = expand;
+}
+
+static
+void * batch_worker(void * arg)
+{
+    worker * wk = (worker *) arg;
+    batch * b = wk->batch;
+    unsigned int seen = 0;
+
+    for (;;) {
+        pthread_mutex_lock(&b->lock);
+        while (b->round == seen && !b->stop)
+            pthread_cond_wait(&b->wake, &b->lock);
+        seen = b->round;
+        bool stop = b->stop;
+        pthread_mutex_unlock(&b->lock);
+        if (stop)
+            break;
+
+        drain(b, wk->id);
+
+        pthread_mutex_lock(&b->lock);
+        if (--b->running == 0)
+            pthread_cond_signal(&b->idle);
+        pthread_mutex_unlock(&b->lock);
+    }
+
+    free(wk);
+    return NULL;
+}
+
+void batch_ctor(batch * b, int threads, path_fn find)
+{
+    if (threads <= 0)
+        threads = sysconf(_SC_NPROCESSORS_ONLN);
+    if (threads <= 0)
+        threads = 1;
+
+    b->threads = threads;
+    b->find = find;
+    b->ids = (pthread_t *) malloc(sizeof(pthread_t) * threads);
+    b->scratch = (search *) malloc(sizeof(search) * threads);
+    b->expand = (uint64_t *) calloc(threads, sizeof(uint64_t));
+    pthread_mutex_init(&b->lock, NULL);
+    pthread_cond_init(&b->wake, NULL);
+    pthread_cond_init(&b->idle, NULL);
+    b->queries = NULL;
+    b->paths = NULL;
+    b->count = 0;
+    b->next = 0;
+    b->running = 0;
+    b->round = 0;
+    b->stop = false;
+
+    // workspaces grow to each map's size on first use
+    for (int i = 0; i < threads; ++i)
+        search_ctor(&b->scratch[i], 0, 0);
+
+    // thread 0 is the caller's
+    for (int i = 1; i < threads; ++i) {
+        worker * wk = (worker *) malloc(sizeof(worker));
+        wk->batch = b;
+        wk->id = i;
+        pthread_create(&b->ids[i], NULL, batch_worker, wk);
+    }
+}
+
+void batch_dtor(batch * b)
+{
+    pthread_mutex_lock(&b->lock);
+    b->stop = true;
+    pthread_cond_broadcast(&b->wake);
+    pthread_mutex_unlock(&b->lock);
+
+    for (int i = 1; i < b->threads; ++i)
+        pthread_join(b->ids[i], NULL);
+    for (int i = 0; i < b->threads; ++i)
+        search_dtor(&b->scratch[i]);
+
+    pthread_mutex_destroy(&b->lock);
+    pthread_cond_destroy(&b->wake);
+    pthread_cond_destroy(&b->idle);
+    free(b->ids);
+    free(b->scratch);
+    free(b->expand);
+}
+
+void batch_solve(batch * b, const query * queries, int count,
+                 path * paths, prof * prof)
+{
+    prof_ctor(prof);
+
+    // a tiled map's tile cache is updated by every read (tiles.h), so a
+    // batch with one is solved on this thread alone
+    bool shared = true;
+    for (int i = 0; i < count; ++i)
+        if (queries[i].map->tiles)
+            shared = false;
+
+    prof_start(prof);
+    pthread_mutex_lock(&b->lock);
+    for (int i = 0; i < b->threads; ++i)
+        b->expand[i] = 0;
+    b->queries = queries;
+    b->paths = paths;
+    b->count = count;
+    b->next = 0;
+    b->running = shared ? b->threads - 1 : 0;
+    if (shared) {
+        b->round += 1;
+        pthread_cond_broadcast(&b->wake);
+    }
+    pthread_mutex_unlock(&b->lock);
+
+    drain(b, 0);
+
+    pthread_mutex_lock(&b->lock);
+    while (b->running > 0)
+        pthread_cond_wait(&b->idle, &b->lock);
+    pthread_mutex_unlock(&b->lock);
+    prof_end(prof); prof->exec = prof_dt(prof);
+
+    for (int i = 0; i < b->threads; ++i)
+        prof->expand += b->expand[i];
+}
@@ -0,0 +1,66 @@
+#ifndef __BATCH_H__
+#define __BATCH_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+#include "map.h"
+#include "path.h"
+#include "world.h"
+#include "prof.h"
+
+// any of the single query engines in path.h
+typedef void (*path_fn)(search * search, const map * map, const coord * start,
+                        const coord * end, path * path, prof * prof);
+
+typedef struct query_
+{
+    const map * map;
+    coord start;
+    coord end;
+} query;
+
+// pool of worker threads solving independent queries. every thread keeps
+// its own search workspace across batches; the caller's thread works too,
+// so a pool of one thread starts none. queries are handed out one at a
+// time, so threads that draw short queries simply take more of them
+typedef struct batch_
+{
+    int threads;
+    path_fn find;
+    pthread_t * ids;
+    search * scratch;           // one workspace per thread
+    uint64_t * expand;          // nodes each thread expanded this batch
+    pthread_mutex_t lock;
+    pthread_cond_t wake;        // a batch was posted, or the pool is stopping
+    pthread_cond_t idle;        // the last worker finished its share
+    const query * queries;
+    path * paths;
+    int count;
+    int next;                   // next query to hand out
+    int running;                // workers still busy with this batch
+    unsigned int round;         // batches posted so far
+    bool stop;
+} batch;
+
+// threads <= 0 uses every CPU
+void batch_ctor(batch * batch, int threads, path_fn find);
+void batch_dtor(batch * batch);
+
+// solves queries[i] into paths[i]; the paths are constructed here and the
+// caller destroys them. prof->exec is the wall time of the whole batch and
+// prof->expand the nodes expanded by all of its queries. a batch with any
+// query on a tiled map is solved by the caller's thread alone
+void batch_solve(batch * batch, const query * queries, int count,
+                 path * paths, prof * prof);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif//__BATCH_H__
@@ -0,0 +1,711 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "map.h"
+#include "path.h"
+#include "world.h"
+#include "graph.h"
+
+// Bellman-Ford solver: sweep every row relaxing each cell against its 8
+// neighbors until nothing changes, like the NEU fabric does in hardware.
+// On x86 a whole row is relaxed a vector at a time: the 8 candidates come
+// from the row above, the row itself and the row below shifted by one cell,
+// and the winning direction is tracked with blend masks.
+// Costs are swept in 32-bit lanes whenever the costliest path the map can
+// hold fits in them, and in 64-bit lanes (half as many per vector) when not.
+// Uncomment to force the scalar kernel (e.g. to compare against SIMD)
+//#define BF_SCALAR
+
+#if !defined(BF_SCALAR) && (defined(__x86_64__) || defined(__i386__))
+#define BF_X86
+#include <immintrin.h>
+#endif
+
+//#define dprintf(...) fprintf(stderr, __VA_ARGS__)
+#define dprintf(str, ...)
+
+// unreached cost during the sweep: small enough that the sum of two of them
+// plus a move still fits in a signed lane, so vectors can compare signed.
+// impassable tiles cost this much to enter, so they are never updated
+#define BF_INF 0x1FFFFFFF
+#define BF_INF_WIDE 0x1FFFFFFFFFFFFFFFll
+
+// costliest step: a diagonal move onto the costliest nibble below a wall
+#define BF_EDGE_MAX (3 + ((MAP_WALL - 1) << 1))
+
+// relax row against the rows above and below it (an all-BF_INF row outside
+// the map); enter is the cost of entering each cell of the row.
+// returns true if any cell improved
+typedef bool (*relax_fn)(const uint32_t * up, uint32_t * row,
+                         const uint32_t * dn, const uint32_t * enter,
+                         uint8_t * dir, int w);
+typedef bool (*relax_wide_fn)(const cost_t * up, cost_t * row,
+                              const cost_t * dn, const cost_t * enter,
+                              uint8_t * dir, int w);
+
+static inline
+bool relax_cell(const uint32_t * up, uint32_t * row, const uint32_t * dn,
+                const uint32_t * enter, uint8_t * dir, int x, int w)
+{
+    const uint32_t * rows[3] = {up, row, dn};
+    bool changed = false;
+    for (int i = 0; i < 8; ++i) {
+        // moving from prev to this node
+        int prev = x + dirs[i][0];
+        if (prev < 0 || prev >= w)
+            continue;
+
+        uint32_t cost = rows[dirs[i][1] + 1][prev] + dirs[i][2] + enter[x];
+        if (cost < row[x]) {
+            row[x] = cost;
+            dir[x] = dir_codes[i];
+            changed = true;
+        }
+    }
+    return changed;
+}
+
+static
+bool relax_row_scalar(const uint32_t * up, uint32_t * row, const uint32_t * dn,
+                      const uint32_t * enter, uint8_t * dir, int w)
+{
+    bool changed = false;
+    for (int x = 0; x < w; ++x)
+        changed |= relax_cell(up, row, dn, enter, dir, x, w);
+    return changed;
+}
+
+static inline
+bool relax_cell_wide(const cost_t * up, cost_t * row, const cost_t * dn,
+                     const cost_t * enter, uint8_t * dir, int x, int w)
+{
+    const cost_t * rows[3] = {up, row, dn};
+    bool changed = false;
+    for (int i = 0; i < 8; ++i) {
+        int prev = x + dirs[i][0];
+        if (prev < 0 || prev >= w)
+            continue;
+
+        cost_t cost = rows[dirs[i][1] + 1][prev] + dirs[i][2] + enter[x];
+        if (cost < row[x]) {
+            row[x] = cost;
+            dir[x] = dir_codes[i];
+            changed = true;
+        }
+    }
+    return changed;
+}
+
+static
+bool relax_row_scalar_wide(const cost_t * up, cost_t * row, const cost_t * dn,
+                           const cost_t * enter, uint8_t * dir, int w)
+{
+    bool changed = false;
+    for (int x = 0; x < w; ++x)
+        changed |= relax_cell_wide(up, row, dn, enter, dir, x, w);
+    return changed;
+}
+
+#ifdef BF_X86
+// one candidate per lane: keep it where it beats the best so far
+__attribute__((target("sse4.1")))
+static inline
+void cand_sse41(__m128i * best, __m128i * code, const uint32_t * prev,
+                int i, __m128i enter)
+{
+    __m128i cost = _mm_add_epi32(_mm_loadu_si128((const __m128i *) prev),
+                                 _mm_set1_epi32(dirs[i][2]));
+    cost = _mm_add_epi32(cost, enter);
+    __m128i lt = _mm_cmpgt_epi32(*best, cost);
+    *best = _mm_blendv_epi8(*best, cost, lt);
+    *code = _mm_blendv_epi8(*code, _mm_set1_epi32(dir_codes[i]), lt);
+}
+
+__attribute__((target("sse4.1")))
+static
+bool relax_row_sse41(const uint32_t * up, uint32_t * row, const uint32_t * dn,
+                     const uint32_t * enter, uint8_t * dir, int w)
+{
+    const uint32_t * rows[3] = {up, row, dn};
+    bool changed = relax_cell(up, row, dn, enter, dir, 0, w);
+    int x = 1;
+    for (; x + 4 < w; x += 4) {
+        __m128i e = _mm_loadu_si128((const __m128i *) (enter + x));
+        __m128i best = _mm_loadu_si128((const __m128i *) (row + x));
+        __m128i code = _mm_setzero_si128();
+        for (int i = 0; i < 8; ++i)
+            cand_sse41(&best, &code, rows[dirs[i][1] + 1] + x + dirs[i][0], i, e);
+
+        // a lane changed if it picked up a direction code
+        __m128i hit = _mm_cmpgt_epi32(code, _mm_setzero_si128());
+        if (_mm_movemask_ps(_mm_castsi128_ps(hit))) {
+            uint32_t codes[4];
+            _mm_storeu_si128((__m128i *) codes, code);
+            for (int l = 0; l < 4; ++l) {
+                if (codes[l])
+                    dir[x + l] = codes[l];
+            }
+            _mm_storeu_si128((__m128i *) (row + x), best);
+            changed = true;
+        }
+    }
+    for (; x < w; ++x)
+        changed |= relax_cell(up, row, dn, enter, dir, x, w);
+    return changed;
+}
+
+__attribute__((target("avx2")))
+static inline
+void cand_avx2(__m256i * best, __m256i * code, const uint32_t * prev,
+               int i, __m256i enter)
+{
+    __m256i cost = _mm256_add_epi32(_mm256_loadu_si256((const __m256i *) prev),
+                                    _mm256_set1_epi32(dirs[i][2]));
+    cost = _mm256_add_epi32(cost, enter);
+    __m256i lt = _mm256_cmpgt_epi32(*best, cost);
+    *best = _mm256_blendv_epi8(*best, cost, lt);
+    *code = _mm256_blendv_epi8(*code, _mm256_set1_epi32(dir_codes[i]), lt);
+}
+
+__attribute__((target("avx2")))
+static
+bool relax_row_avx2(const uint32_t * up, uint32_t * row, const uint32_t * dn,
+                    const uint32_t * enter, uint8_t * dir, int w)
+{
+    const uint32_t * rows[3] = {up, row, dn};
+    bool changed = relax_cell(up, row, dn, enter, dir, 0, w);
+    int x = 1;
+    for (; x + 8 < w; x += 8) {
+        __m256i e = _mm256_loadu_si256((const __m256i *) (enter + x));
+        __m256i best = _mm256_loadu_si256((const __m256i *) (row + x));
+        __m256i code = _mm256_setzero_si256();
+        for (int i = 0; i < 8; ++i)
+            cand_avx2(&best, &code, rows[dirs[i][1] + 1] + x + dirs[i][0], i, e);
+
+        // a lane changed if it picked up a direction code
+        __m256i hit = _mm256_cmpgt_epi32(code, _mm256_setzero_si256());
+        if (_mm256_movemask_ps(_mm256_castsi256_ps(hit))) {
+            uint32_t codes[8];
+            _mm256_storeu_si256((__m256i *) codes, code);
+            for (int l = 0; l < 8; ++l) {
+                if (codes[l])
+                    dir[x + l] = codes[l];
+            }
+            _mm256_storeu_si256((__m256i *) (row + x), best);
+            changed = true;
+        }
+    }
+    for (; x < w; ++x)
+        changed |= relax_cell(up, row, dn, enter, dir, x, w);
+    return changed;
+}
+
+// the same with one candidate per 64-bit lane, for maps too big for 32
+__attribute__((target("sse4.2")))
+static inline
+void cand_sse42(__m128i * best, __m128i * code, const cost_t * prev,
+                int i, __m128i enter)
+{
+    __m128i cost = _mm_add_epi64(_mm_loadu_si128((const __m128i *) prev),
+                                 _mm_set1_epi64x(dirs[i][2]));
+    cost = _mm_add_epi64(cost, enter);
+    __m128i lt = _mm_cmpgt_epi64(*best, cost);
+    *best = _mm_blendv_epi8(*best, cost, lt);
+    *code = _mm_blendv_epi8(*code, _mm_set1_epi64x(dir_codes[i]), lt);
+}
+
+__attribute__((target("sse4.2")))
+static
+bool relax_row_sse42(const cost_t * up, cost_t * row, const cost_t * dn,
+                     const cost_t * enter, uint8_t * dir, int w)
+{
+    const cost_t * rows[3] = {up, row, dn};
+    bool changed = relax_cell_wide(up, row, dn, enter, dir, 0, w);
+    int x = 1;
+    for (; x + 2 < w; x += 2) {
+        __m128i e = _mm_loadu_si128((const __m128i *) (enter + x));
+        __m128i best = _mm_loadu_si128((const __m128i *) (row + x));
+        __m128i code = _mm_setzero_si128();
+        for (int i = 0; i < 8; ++i)
+            cand_sse42(&best, &code, rows[dirs[i][1] + 1] + x + dirs[i][0], i, e);
+
+        __m128i hit = _mm_cmpgt_epi64(code, _mm_setzero_si128());
+        if (_mm_movemask_pd(_mm_castsi128_pd(hit))) {
+            uint64_t codes[2];
+            _mm_storeu_si128((__m128i *) codes, code);
+            for (int l = 0; l < 2; ++l) {
+                if (codes[l])
+                    dir[x + l] = codes[l];
+            }
+            _mm_storeu_si128((__m128i *) (row + x), best);
+            changed = true;
+        }
+    }
+    for (; x < w; ++x)
+        changed |= relax_cell_wide(up, row, dn, enter, dir, x, w);
+    return changed;
+}
+
+__attribute__((target("avx2")))
+static inline
+void cand_avx2_wide(__m256i * best, __m256i * code, const cost_t * prev,
+                    int i, __m256i enter)
+{
+    __m256i cost = _mm256_add_epi64(_mm256_loadu_si256((const __m256i *) prev),
+                                    _mm256_set1_epi64x(dirs[i][2]));
+    cost = _mm256_add_epi64(cost, enter);
+    __m256i lt = _mm256_cmpgt_epi64(*best, cost);
+    *best = _mm256_blendv_epi8(*best, cost, lt);
+    *code = _mm256_blendv_epi8(*code, _mm256_set1_epi64x(dir_codes[i]), lt);
+}
+
+__attribute__((target("avx2")))
+static
+bool relax_row_avx2_wide(const cost_t * up, cost_t * row, const cost_t * dn,
+                         const cost_t * enter, uint8_t * dir, int w)
+{
+    const cost_t * rows[3] = {up, row, dn};
+    bool changed = relax_cell_wide(up, row, dn, enter, dir, 0, w);
+    int x = 1;
+    for (; x + 4 < w; x += 4) {
+        __m256i e = _mm256_loadu_si256((const __m256i *) (enter + x));
+        __m256i best = _mm256_loadu_si256((const __m256i *) (row + x));
+        __m256i code = _mm256_setzero_si256();
+        for (int i = 0; i < 8; ++i)
+            cand_avx2_wide(&best, &code, rows[dirs[i][1] + 1] + x + dirs[i][0], i, e);
+
+        __m256i hit = _mm256_cmpgt_epi64(code, _mm256_setzero_si256());
+        if (_mm256_movemask_pd(_mm256_castsi256_pd(hit))) {
+            uint64_t codes[4];
+            _mm256_storeu_si256((__m256i *) codes, code);
+            for (int l = 0; l < 4; ++l) {
+                if (codes[l])
+                    dir[x + l] = codes[l];
+            }
+            _mm256_storeu_si256((__m256i *) (row + x), best);
+            changed = true;
+        }
+    }
+    for (; x < w; ++x)
+        changed |= relax_cell_wide(up, row, dn, enter, dir, x, w);
+    return changed;
+}
+#endif
+
+// widest row kernels the CPU supports, picked once
+static
+relax_fn relax_kernel(void)
+{
+    static relax_fn kernel = NULL;
+    if (kernel == NULL) {
+        kernel = relax_row_scalar;
+        #ifdef BF_X86
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2"))
+            kernel = relax_row_avx2;
+        else if (__builtin_cpu_supports("sse4.1"))
+            kernel = relax_row_sse41;
+        #endif
+    }
+    return kernel;
+}
+
+static
+relax_wide_fn relax_wide_kernel(void)
+{
+    static relax_wide_fn kernel = NULL;
+    if (kernel == NULL) {
+        kernel = relax_row_scalar_wide;
+        #ifdef BF_X86
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2"))
+            kernel = relax_row_avx2_wide;
+        else if (__builtin_cpu_supports("sse4.2"))
+            kernel = relax_row_sse42;
+        #endif
+    }
+    return kernel;
+}
+
+// sweep state of one query: costs and entering costs are either 32-bit or
+// 64-bit, so they are kept untyped and indexed through the lane size
+typedef struct sweep_
+{
+    relax_fn relax;             // NULL when sweeping 64-bit lanes
+    relax_wide_fn relax_wide;
+    size_t size;                // bytes per cost
+    cost_t inf;
+    void * cost;
+    void * enter;
+} sweep;
+
+static inline
+void * lane_at(const sweep * s, void * a, idx_t i)
+{
+    return (char *) a + i * (idx_t) s->size;
+}
+
+static inline
+cost_t lane_get(const sweep * s, const void * a, idx_t i)
+{
+    if (s->relax)
+        return ((const uint32_t *) a)[i];
+    return ((const cost_t *) a)[i];
+}
+
+static inline
+void lane_set(const sweep * s, void * a, idx_t i, cost_t c)
+{
+    if (s->relax)
+        ((uint32_t *) a)[i] = c;
+    else
+        ((cost_t *) a)[i] = c;
+}
+
+static inline
+bool sweep_row(const sweep * s, const void * up, void * row, const void * dn,
+               const void * enter, uint8_t * dir, int w)
+{
+    if (s->relax)
+        return s->relax(up, row, dn, enter, dir, w);
+    return s->relax_wide(up, row, dn, enter, dir, w);
+}
+
+// pick the lane width and fill in the entering costs, every cell
+// unreached but the start. a path enters a cell at most once, so when every
+// cell entered at BF_EDGE_MAX still adds up to less than BF_INF the 32-bit
+// lanes cannot overflow. the heap keys are free during a sweep and hold
+// both 32-bit arrays; 64-bit sweeps use them for the entering costs alone
+static
+void sweep_ctor(sweep * s, graph * graph, search * search, const map * map,
+                const coord * start)
+{
+    idx_t n = (idx_t) graph->w * graph->h;
+    if (n < BF_INF / BF_EDGE_MAX) {
+        s->relax = relax_kernel();
+        s->relax_wide = NULL;
+        s->size = sizeof(uint32_t);
+        s->inf = BF_INF;
+        s->cost = search->key;
+        s->enter = (uint32_t *) search->key + n;
+    } else {
+        s->relax = NULL;
+        s->relax_wide = relax_wide_kernel();
+        s->size = sizeof(cost_t);
+        s->inf = BF_INF_WIDE;
+        s->cost = graph->cost;
+        s->enter = search->key;
+    }
+
+    for (idx_t i = 0; i < n; ++i) {
+        int32_t c = tile_cost_idx(map, i);
+        lane_set(s, s->enter, i,
+                 (c == (int32_t) 0xDEADBEEF) ? s->inf : (cost_t) c << 1);
+        lane_set(s, s->cost, i, s->inf);
+    }
+    lane_set(s, s->cost, graph_idx(graph, start->x, start->y), 0);
+}
+
+// hand the swept costs to the graph, COST_INF where unreached
+static
+void sweep_dtor(sweep * s, graph * graph)
+{
+    idx_t n = (idx_t) graph->w * graph->h;
+    for (idx_t i = 0; i < n; ++i) {
+        cost_t c = lane_get(s, s->cost, i);
+        graph->cost[i] = c >= s->inf ? COST_INF : c;
+    }
+}
+
+void ppath_find(search * search, const map * map, const coord * start,
+                const coord * end, path * path, prof * prof)
+{
+    struct search_ scratch;
+    graph graph;
+    sweep s;
+
+    prof_ctor(prof);
+
+    prof_start(prof);
+    path_ctor(path);
+    search = search_acquire(search, &scratch, map);
+    gen_graph(&graph, search);
+    graph_clear(&graph);
+    sweep_ctor(&s, &graph, search, map, start);
+
+    idx_t n = (idx_t) graph.w * graph.h;
+    void * none = malloc(s.size * graph.w);
+    for (int x = 0; x < graph.w; ++x)
+        lane_set(&s, none, x, s.inf);
+    prof_end(prof); prof->prproc = prof_dt(prof);
+
+    prof_start(prof);
+    // anytime a node has to change, set run to 1
+    int run;
+    int count = 0;
+    do {
+        ++count;
+        run = 0;
+        for (int y = 0; y < graph.h; ++y) {
+            idx_t r = (idx_t) y * graph.w;
+            void * row = lane_at(&s, s.cost, r);
+            const void * up = y > 0 ? lane_at(&s, row, -graph.w) : none;
+            const void * dn = y < graph.h - 1 ? lane_at(&s, row, graph.w) : none;
+            run |= sweep_row(&s, up, row, dn, lane_at(&s, s.enter, r),
+                             graph.dir + r, graph.w);
+        }
+        prof->expand += n;
+    } while (run && count < n);
+    dprintf("cycles: %d\n", count);
+
+    sweep_dtor(&s, &graph);
+    prof_end(prof); prof->exec = prof_dt(prof);
+
+    // generate the path
+    prof_start(prof);
+    gen_path(&graph, start, end, path);
+    free(none);
+    search_release(search, &scratch);
+    prof_end(prof); prof->poproc = prof_dt(prof);
+}
+
+// Tiled multi-threaded Bellman-Ford
+//
+// Each worker owns one tile of the grid and sweeps a private copy of it,
+// padded by a ring of halo cells holding its neighbors' edges, until the
+// tile stops changing. Halo cells cost BF_INF to enter, so the row kernel
+// never writes them. Rounds are separated by barriers:
+//   1. load the halo ring from the shared graph, then sweep locally
+//   2. barrier: nobody reads the shared graph any more this round
+//   3. publish the tile's cells if any of them changed, flag the change
+//   4. barrier: every tile is published; if no tile changed, the halos
+//      every tile converged against are final and so is the graph
+// Change flags alternate by round so a fast worker cannot clear a flag
+// that a slow one is still reading.
+
+typedef struct tile_
+{
+    int x0, y0;         // first cell of the tile in the graph
+    int w, h;           // tile size without the halo
+    void * cost;        // (w + 2) * (h + 2) private copies
+    void * enter;
+    uint8_t * dir;
+    uint64_t sweeps;    // cells relaxed
+} tile;
+
+typedef struct tiling_
+{
+    graph * graph;
+    sweep * sweep;      // the shared costs are the sweep's
+    tile * tiles;
+    int count;
+    int * changed[2];       // per tile change flags, by round parity
+    pthread_barrier_t barrier;
+} tiling;
+
+typedef struct worker_
+{
+    tiling * tiling;
+    int id;
+} worker;
+
+// copy the halo ring in from the shared costs; with whole set, copy the
+// whole tile and its entering costs instead. cells outside the map stay
+// unreachable
+static
+void tile_load(tile * t, const graph * g, const sweep * s, bool whole)
+{
+    int pw = t->w + 2;
+    for (int y = -1; y <= t->h; ++y) {
+        for (int x = -1; x <= t->w; ++x) {
+            bool edge = x < 0 || y < 0 || x == t->w || y == t->h;
+            if (!edge && !whole)
+                continue;
+
+            int gx = t->x0 + x;
+            int gy = t->y0 + y;
+            idx_t p = (x + 1) + (idx_t) pw * (y + 1);
+            if (gx < 0 || gx >= g->w || gy < 0 || gy >= g->h) {
+                lane_set(s, t->cost, p, s->inf);
+                lane_set(s, t->enter, p, s->inf);
+                continue;
+            }
+            idx_t i = graph_idx(g, gx, gy);
+            lane_set(s, t->cost, p, lane_get(s, s->cost, i));
+            if (whole) {
+                t->dir[p] = g->dir[i];
+                lane_set(s, t->enter, p,
+                         edge ? s->inf : lane_get(s, s->enter, i));
+            }
+        }
+    }
+}
+
+static
+void tile_store(const tile * t, graph * g, const sweep * s)
+{
+    int pw = t->w + 2;
+    for (int y = 0; y < t->h; ++y) {
+        idx_t p = 1 + (idx_t) pw * (y + 1);
+        idx_t i = graph_idx(g, t->x0, t->y0 + y);
+        memcpy(lane_at(s, s->cost, i), lane_at(s, t->cost, p), s->size * t->w);
+        memcpy(g->dir + i, t->dir + p, sizeof(uint8_t) * t->w);
+    }
+}
+
+// sweep the tile until it stops changing; returns true if anything did
+static
+bool tile_sweep(tile * t, const sweep * s)
+{
+    int pw = t->w + 2;
+    bool changed = false;
+    bool run;
+    do {
+        run = false;
+        for (int y = 1; y <= t->h; ++y) {
+            idx_t r = (idx_t) pw * y;
+            void * row = lane_at(s, t->cost, r);
+            run |= sweep_row(s, lane_at(s, row, -pw), row, lane_at(s, row, pw),
+                             lane_at(s, t->enter, r), t->dir + r, pw);
+        }
+        t->sweeps += (idx_t) t->w * t->h;
+        changed |= run;
+    } while (run);
+    return changed;
+}
+
+static
+void * tile_worker(void * arg)
+{
+    worker * wk = (worker *) arg;
+    tiling * tl = wk->tiling;
+    tile * t = &tl->tiles[wk->id];
+
+    for (int round = 0; ; ++round) {
+        tile_load(t, tl->graph, tl->sweep, false);
+        bool changed = tile_sweep(t, tl->sweep);
+        pthread_barrier_wait(&tl->barrier);
+
+        if (changed)
+            tile_store(t, tl->graph, tl->sweep);
+        tl->changed[round & 1][wk->id] = changed;
+        pthread_barrier_wait(&tl->barrier);
+
+        bool done = true;
+        for (int i = 0; i < tl->count; ++i)
+            done &= !tl->changed[round & 1][i];
+        if (done)
+            break;
+    }
+    return NULL;
+}
+
+// split n cells into parts nearly equal spans; returns the start of span i
+static inline
+int span(int n, int parts, int i)
+{
+    return (int) ((int64_t) n * i / parts);
+}
+
+void tpath_find(search * search, const map * map, const coord * start,
+                const coord * end, path * path, prof * prof, int threads)
+{
+    struct search_ scratch;
+    graph graph;
+    sweep s;
+
+    prof_ctor(prof);
+
+    prof_start(prof);
+    path_ctor(path);
+    search = search_acquire(search, &scratch, map);
+    gen_graph(&graph, search);
+    graph_clear(&graph);
+    sweep_ctor(&s, &graph, search, map, start);
+
+    idx_t n = (idx_t) graph.w * graph.h;
+
+    // lay the tiles out as close to square as the thread count allows
+    if (threads <= 0)
+        threads = sysconf(_SC_NPROCESSORS_ONLN);
+    if (threads > n)
+        threads = n;
+    int ty = 1;
+    for (int d = 1; d * d <= threads; ++d) {
+        if (threads % d == 0)
+            ty = d;
+    }
+    int tx = threads / ty;
+    if (graph.w < graph.h) {
+        int tmp = tx;
+        tx = ty;
+        ty = tmp;
+    }
+    if (tx > graph.w)
+        tx = graph.w;
+    if (ty > graph.h)
+        ty = graph.h;
+    threads = tx * ty;
+
+    tiling tiling;
+    tiling.graph = &graph;
+    tiling.sweep = &s;
+    tiling.count = threads;
+    tiling.tiles = (tile *) malloc(sizeof(tile) * threads);
+    tiling.changed[0] = (int *) calloc(threads, sizeof(int));
+    tiling.changed[1] = (int *) calloc(threads, sizeof(int));
+    pthread_barrier_init(&tiling.barrier, NULL, threads);
+
+    worker * workers = (worker *) malloc(sizeof(worker) * threads);
+    pthread_t * ids = (pthread_t *) malloc(sizeof(pthread_t) * threads);
+    for (int j = 0; j < ty; ++j) {
+        for (int i = 0; i < tx; ++i) {
+            tile * t = &tiling.tiles[i + tx * j];
+            t->x0 = span(graph.w, tx, i);
+            t->y0 = span(graph.h, ty, j);
+            t->w = span(graph.w, tx, i + 1) - t->x0;
+            t->h = span(graph.h, ty, j + 1) - t->y0;
+            t->sweeps = 0;
+            idx_t pn = (idx_t) (t->w + 2) * (t->h + 2);
+            t->cost = malloc(s.size * pn);
+            t->enter = malloc(s.size * pn);
+            t->dir = (uint8_t *) malloc(sizeof(uint8_t) * pn);
+            tile_load(t, &graph, &s, true);
+        }
+    }
+    prof_end(prof); prof->prproc = prof_dt(prof);
+
+    prof_start(prof);
+    for (int i = 0; i < threads; ++i) {
+        workers[i].tiling = &tiling;
+        workers[i].id = i;
+        pthread_create(&ids[i], NULL, tile_worker, &workers[i]);
+    }
+    for (int i = 0; i < threads; ++i)
+        pthread_join(ids[i], NULL);
+
+    sweep_dtor(&s, &graph);
+    prof_end(prof); prof->exec = prof_dt(prof);
+
+    prof_start(prof);
+    gen_path(&graph, start, end, path);
+    for (int i = 0; i < threads; ++i) {
+        tile * t = &tiling.tiles[i];
+        prof->expand += t->sweeps;
+        free(t->cost);
+        free(t->enter);
+        free(t->dir);
+    }
+    pthread_barrier_destroy(&tiling.barrier);
+    free(tiling.tiles);
+    free(tiling.changed[0]);
+    free(tiling.changed[1]);
+    free(workers);
+    free(ids);
+    search_release(search, &scratch);
+    prof_end(prof); prof->poproc = prof_dt(prof);
+}
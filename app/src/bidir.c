@@ -0,0 +1,234 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include "map.h"
+#include "path.h"
+#include "world.h"
+#include "graph.h"
+#include "heap.h"
+
+//#define dprintf(...) fprintf(stderr, __VA_ARGS__)
+#define dprintf(str, ...)
+
+// Bidirectional search
+//
+// One frontier grows from start over the usual graph, the other from end
+// over a second graph where each node's cost is the cost of getting from it
+// to end. A move into a tile pays that tile's cost, so the backward
+// frontier, expanding v and reaching its neighbor u, charges u -> v with
+// v's tile: the tile of the node being expanded, not of the one reached.
+//
+// Whenever a node is reached from one side and the other side already has a
+// cost for it, the two costs make a candidate path; mu is the best one. The
+// side with the smaller top key expands next, and the search stops once the
+// two top keys together can no longer beat mu.
+//
+// For A* both sides use the average of the two octile heuristics, which
+// keeps them consistent with each other: forward keys are biased by
+// (h_end(v) - h_start(v)) / 2, backward ones by its negation. Keys are kept
+// doubled so the halves stay integral, and shifted by the heuristic at the
+// frontier's own root so they start at 0.
+//
+// Once done, the backward half of the path is copied into the forward
+// graph from the meeting node on, so gen_path can walk it like any other.
+
+typedef struct side_
+{
+    graph graph;
+    heap heap;
+    const coord * root;     // start or end
+    int64_t shift;          // doubled heuristic bias at root
+} side;
+
+// doubled key of node n reached at cost from this side; other is the root
+// of the opposite side
+static inline
+cost_t side_key(const side * side, const coord * other, idx_t n, cost_t cost,
+                bool astar)
+{
+    if (!astar)
+        return cost << 1;
+
+    coord c = {.x = n % side->graph.w, .y = n / side->graph.w};
+    int64_t bias = (int64_t) octile(&c, other) - octile(&c, side->root);
+    return (cost_t) (((int64_t) cost << 1) + bias - side->shift);
+}
+
+// the backward frontier lives in its own workspace hung off the caller's
+search * rev_acquire(search * search, const map * map)
+{
+    if (search->rev == NULL) {
+        search->rev = (struct search_ *) malloc(sizeof(struct search_));
+        search_ctor(search->rev, map->w, map->h);
+    }
+    return search_acquire(search->rev, NULL, map);
+}
+
+// expand the top node of one side. the forward side relaxes moves out of
+// the node into its neighbors, the backward side moves into the node from
+// its neighbors. meet and mu track the best path through both sides
+static
+void side_expand(const map * map, side * self, side * other, bool forward,
+                 bool astar, cost_t * mu, idx_t * meet, prof * prof)
+{
+    graph * graph = &self->graph;
+    // the callers only expand a side whose heap is not empty
+    idx_t idx = 0;
+    heap_pop(&self->heap, &idx);
+    prof->expand += 1;
+    bit_set(graph->visit, idx);
+
+    coord curr = {.x = idx % graph->w, .y = idx / graph->w};
+    dprintf("%s: (%d, %d)\n", forward ? "fwd" : "rev", curr.x, curr.y);
+
+    int32_t here = tile_cost(map, curr.x, curr.y);
+    if (!forward && here == (int32_t) 0xDEADBEEF)
+        return;
+
+    for (int i = 0; i < 8; i += 1) {
+        coord next = {.x = curr.x + dirs[i][0], .y = curr.y + dirs[i][1]};
+
+        if (next.x < 0 || next.x >= graph->w ||
+            next.y < 0 || next.y >= graph->h)
+            continue;
+
+        // a wall may only start a path, and only the forward side's
+        int32_t tile = tile_cost(map, next.x, next.y);
+        if (tile == (int32_t) 0xDEADBEEF && (forward ||
+            next.x != other->root->x || next.y != other->root->y))
+            continue;
+
+        idx_t n = graph_idx(graph, next.x, next.y);
+        graph_touch(graph, n);
+        if (bit_get(graph->visit, n))
+            continue;
+
+        cost_t cost = graph->cost[idx] + dirs[i][2] +
+                      ((forward ? tile : here) << 1);
+        if (cost < graph->cost[n]) {
+            graph->cost[n] = cost;
+            graph->dir[n] = dir_codes[(i + 4) & 7];
+            heap_push(&self->heap, n,
+                      side_key(self, other->root, n, cost, astar));
+
+            graph_touch(&other->graph, n);
+            cost_t back = other->graph.cost[n];
+            if (back != COST_INF && cost + back < *mu) {
+                *mu = cost + back;
+                *meet = n;
+            }
+        }
+    }
+}
+
+static
+idx_t bidir_search(const map * map, side * fwd, side * rev, bool astar,
+                 prof * prof)
+{
+    cost_t mu = COST_INF;
+    idx_t meet = -1;
+
+    // the root of each side costs 0; when they coincide the path is empty
+    side * sides[2] = {fwd, rev};
+    for (int k = 0; k < 2; ++k) {
+        graph * graph = &sides[k]->graph;
+        idx_t idx = graph_idx(graph, sides[k]->root->x, sides[k]->root->y);
+        graph_touch(graph, idx);
+        graph->cost[idx] = 0;
+        heap_push(&sides[k]->heap, idx, 0);
+    }
+    idx_t s = graph_idx(&fwd->graph, fwd->root->x, fwd->root->y);
+    if (s == graph_idx(&rev->graph, rev->root->x, rev->root->y)) {
+        mu = 0;
+        meet = s;
+    }
+
+    // both shifts are the octile distance between the roots, so stop once
+    // top(fwd) + top(rev) >= 2 * mu - 2 * shift
+    while (fwd->heap.size > 0 && rev->heap.size > 0) {
+        int64_t top = (int64_t) fwd->heap.key[0] + rev->heap.key[0];
+        if (mu != COST_INF && top >= ((int64_t) mu << 1) - 2 * fwd->shift)
+            break;
+
+        if (fwd->heap.key[0] <= rev->heap.key[0])
+            side_expand(map, fwd, rev, true, astar, &mu, &meet, prof);
+        else
+            side_expand(map, rev, fwd, false, astar, &mu, &meet, prof);
+    }
+    return meet;
+}
+
+// copy the backward tree's path from meet to end into the forward graph:
+// each node on it points back at the node before it
+static
+void stitch(side * fwd, side * rev, idx_t meet)
+{
+    graph * f = &fwd->graph;
+    graph * r = &rev->graph;
+    idx_t end = graph_idx(r, rev->root->x, rev->root->y);
+    cost_t total = f->cost[meet] + r->cost[meet];
+
+    for (idx_t n = meet; n != end; ) {
+        uint8_t d = r->dir[n] & 0x7;
+        idx_t next = graph_idx(r, n % r->w + acceldirs[d][0],
+                             n / r->w + acceldirs[d][1]);
+        graph_touch(f, next);
+        f->dir[next] = DIR_VALID | ((d + 4) & 7);
+        f->cost[next] = total - r->cost[next];
+        n = next;
+    }
+}
+
+static
+void bidir_path_find(search * search, const map * map, const coord * start,
+                     const coord * end, path * path, prof * prof, bool astar)
+{
+    struct search_ scratch;
+    side fwd, rev;
+
+    prof_ctor(prof);
+
+    prof_start(prof);
+    path_ctor(path);
+    search = search_acquire(search, &scratch, map);
+    struct search_ * back = rev_acquire(search, map);
+    gen_graph(&fwd.graph, search);
+    gen_graph(&rev.graph, back);
+    heap_ctor(&fwd.heap, search);
+    heap_ctor(&rev.heap, back);
+    fwd.root = start;
+    rev.root = end;
+    fwd.shift = astar ? octile(start, end) : 0;
+    rev.shift = fwd.shift;
+    prof_end(prof); prof->prproc = prof_dt(prof);
+
+    prof_start(prof);
+    idx_t meet = bidir_search(map, &fwd, &rev, astar, prof);
+    prof_end(prof); prof->exec = prof_dt(prof);
+
+    prof_start(prof);
+    if (meet >= 0) {
+        stitch(&fwd, &rev, meet);
+        gen_path(&fwd.graph, start, end, path);
+    }
+    heap_dtor(&fwd.heap);
+    heap_dtor(&rev.heap);
+    search_release(search, &scratch);
+    prof_end(prof); prof->poproc = prof_dt(prof);
+}
+
+// bidirectional Dijkstra: meets in the middle, so each frontier only grows
+// to about half the distance
+void bidpath_find(search * search, const map * map, const coord * start,
+                  const coord * end, path * path, prof * prof)
+{
+    bidir_path_find(search, map, start, end, path, prof, false);
+}
+
+// bidirectional A*: both frontiers are also pulled toward each other
+void biapath_find(search * search, const map * map, const coord * start,
+                  const coord * end, path * path, prof * prof)
+{
+    bidir_path_find(search, map, start, end, path, prof, true);
+}
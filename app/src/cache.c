@@ -0,0 +1,188 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include "map.h"
+#include "path.h"
+#include "world.h"
+#include "cache.h"
+
+// entries are chained off a hash table for lookup and linked in a list
+// from most to least recently used for eviction. a 64-bit hash of the map
+// stands in for its contents: two maps of the same size sharing a hash
+// would share trees
+typedef struct tcache_entry_
+{
+    uint64_t hash;                  // map hash
+    int w;
+    int h;
+    coord start;
+    size_t bytes;                   // entry and tree
+    struct tcache_entry_ * chain;   // next in the same table slot
+    struct tcache_entry_ * prev;    // more recently used
+    struct tcache_entry_ * next;    // less recently used
+    uint32_t dir[];                 // packed directions
+} entry;
+
+static inline
+size_t key_slot(const tcache * cache, uint64_t hash, const coord * start)
+{
+    uint64_t k = hash ^ ((uint64_t) start->x << 32 | (uint32_t) start->y);
+    k *= 0x9E3779B97F4A7C15ull;
+    return (size_t) (k >> 32) & (cache->slots - 1);
+}
+
+static
+void lru_unlink(tcache * cache, entry * e)
+{
+    if (e->prev)
+        e->prev->next = e->next;
+    else
+        cache->head = e->next;
+    if (e->next)
+        e->next->prev = e->prev;
+    else
+        cache->tail = e->prev;
+}
+
+static
+void lru_push(tcache * cache, entry * e)
+{
+    e->prev = NULL;
+    e->next = cache->head;
+    if (cache->head)
+        cache->head->prev = e;
+    cache->head = e;
+    if (cache->tail == NULL)
+        cache->tail = e;
+}
+
+static
+entry * cache_find(tcache * cache, uint64_t hash, const map * map,
+                   const coord * start)
+{
+    entry * e = cache->table[key_slot(cache, hash, start)];
+    for (; e; e = e->chain) {
+        if (e->hash == hash && e->w == map->w && e->h == map->h &&
+            e->start.x == start->x && e->start.y == start->y)
+            return e;
+    }
+    return NULL;
+}
+
+static
+void cache_remove(tcache * cache, entry * e)
+{
+    entry ** p = &cache->table[key_slot(cache, e->hash, &e->start)];
+    while (*p != e)
+        p = &(*p)->chain;
+    *p = e->chain;
+
+    lru_unlink(cache, e);
+    cache->used -= e->bytes;
+    cache->count -= 1;
+    free(e);
+}
+
+// double the table once it holds more trees than slots
+static
+void cache_grow(tcache * cache)
+{
+    size_t slots = cache->slots;
+    entry ** table = cache->table;
+
+    cache->slots = slots * 2;
+    cache->table = (entry **) calloc(cache->slots, sizeof(entry *));
+    for (size_t i = 0; i < slots; ++i) {
+        entry * e = table[i];
+        while (e) {
+            entry * chain = e->chain;
+            size_t s = key_slot(cache, e->hash, &e->start);
+            e->chain = cache->table[s];
+            cache->table[s] = e;
+            e = chain;
+        }
+    }
+    free(table);
+}
+
+void tcache_ctor(tcache * cache, size_t budget)
+{
+    cache->budget = budget;
+    cache->used = 0;
+    cache->count = 0;
+    cache->slots = 64;
+    cache->table = (entry **) calloc(cache->slots, sizeof(entry *));
+    cache->head = NULL;
+    cache->tail = NULL;
+    tree_ctor(&cache->tree, 0, 0);
+}
+
+void tcache_dtor(tcache * cache)
+{
+    while (cache->head)
+        cache_remove(cache, cache->head);
+    free(cache->table);
+    tree_dtor(&cache->tree);
+}
+
+void cpath_find(tcache * cache, const map * map, const coord * start,
+                const coord * end, path * path, prof * prof)
+{
+    prof_ctor(prof);
+
+    prof_start(prof);
+    uint64_t hash = map_hash(map);
+    entry * e = cache_find(cache, hash, map, start);
+    prof_end(prof); prof->prproc = prof_dt(prof);
+
+    if (e) {
+        prof->hit = 1;
+        lru_unlink(cache, e);
+        lru_push(cache, e);
+
+        prof_start(prof);
+        path_walk(e->w, e->h, start, end, e->dir, path);
+        prof_end(prof); prof->poproc = prof_dt(prof);
+        return;
+    }
+
+    prof->miss = 1;
+    struct prof_ tree_prof;
+    tree_find(&cache->tree, map, start, &tree_prof);
+    prof->prproc += tree_prof.prproc;
+    prof->exec = tree_prof.exec;
+    prof->expand = tree_prof.expand;
+
+    prof_start(prof);
+    tree_path(&cache->tree, end, path);
+
+    // trees bigger than the whole budget are not kept
+    size_t words = ((size_t) map->w * map->h + 7) / 8;
+    size_t bytes = sizeof(entry) + sizeof(uint32_t) * words;
+    if (bytes <= cache->budget) {
+        while (cache->used + bytes > cache->budget) {
+            cache_remove(cache, cache->tail);
+            prof->evict += 1;
+        }
+
+        e = (entry *) malloc(bytes);
+        e->hash = hash;
+        e->w = map->w;
+        e->h = map->h;
+        e->start = *start;
+        e->bytes = bytes;
+        tree_pack(&cache->tree, e->dir);
+
+        size_t s = key_slot(cache, hash, start);
+        e->chain = cache->table[s];
+        cache->table[s] = e;
+        lru_push(cache, e);
+        cache->used += bytes;
+        cache->count += 1;
+        if (cache->count > cache->slots)
+            cache_grow(cache);
+    }
+    prof_end(prof); prof->poproc = prof_dt(prof);
+}
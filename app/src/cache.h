@@ -0,0 +1,46 @@
+#ifndef __CACHE_H__
+#define __CACHE_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "map.h"
+#include "path.h"
+#include "world.h"
+#include "prof.h"
+
+// LRU cache of shortest path trees, keyed by a hash of the map and the
+// start cell. trees are kept in the accelerator's packed bram_dir layout,
+// 4 bits per cell, and the least recently used ones are dropped to stay
+// within the memory budget
+typedef struct tcache_
+{
+    size_t budget;                  // bytes
+    size_t used;
+    size_t count;                   // trees held
+    size_t slots;                   // hash table size, a power of two
+    struct tcache_entry_ ** table;  // chains by key
+    struct tcache_entry_ * head;    // most recently used
+    struct tcache_entry_ * tail;    // least recently used
+    tree tree;                      // workspace for misses
+} tcache;
+
+void tcache_ctor(tcache * cache, size_t budget);
+void tcache_dtor(tcache * cache);
+
+// answers from the cache if it holds the tree for (map, start), otherwise
+// searches and caches the tree. prof counts the hit or miss and evictions.
+// the map is only hashed on its first query, and again once it changes
+// (map_hash)
+void cpath_find(tcache * cache, const map * map, const coord * start,
+                const coord * end, path * path, prof * prof);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif//__CACHE_H__
@@ -0,0 +1,653 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include "map.h"
+#include "path.h"
+#include "world.h"
+#include "graph.h"
+#include "heap.h"
+#include "ch.h"
+
+//#define dprintf(...) fprintf(stderr, __VA_ARGS__)
+#define dprintf(str, ...)
+
+// Contraction hierarchies
+//
+// Every cell is a node with an arc to each of its 8 neighbors it can move
+// into; the arc pays the move and the tile it enters, so the arcs in and
+// out of a node differ in cost and walls have arcs out but none in. Nodes
+// are contracted one at a time: for every pair of arcs u -> v -> w through
+// the contracted node v, a witness search from u that avoids v looks for a
+// path to w costing no more. If there is none, a shortcut u -> w is added
+// in place of the pair. The arcs a node still has when it is contracted
+// all lead to higher nodes, and are what the queries use.
+//
+// The next node contracted is the one with the lowest edge difference, the
+// shortcuts it would add less the arcs it removes, plus the number of its
+// neighbors already contracted so the contraction spreads evenly over the
+// map. Priorities only grow as the graph shrinks, so they are updated
+// lazily: the top node is weighed again when popped and contracted only if
+// it still beats the next one.
+//
+// A query runs Dijkstra upward from the start over the arcs out of each
+// node, and upward from the end over the arcs into each node, until the
+// smaller of the two frontiers costs at least the best meeting found. A
+// witness search that gives up early only adds a shortcut that is not
+// needed, so the paths are exactly the shortest.
+
+// a node's arcs while the hierarchy is built. arcs to a node are dropped
+// when it is contracted, so the lists only hold the nodes still left
+typedef struct ch_list_
+{
+    ch_arc * arc;
+    int size;
+    int cap;
+} ch_list;
+
+typedef struct builder_
+{
+    idx_t n;
+    ch_list * out;
+    ch_list * in;
+    int * deleted;          // neighbors contracted
+    idx_t * target;         // last node contracted or weighed next to each
+    search * search;        // witness searches
+} builder;
+
+// priorities are edge differences, which can be negative
+#define CH_BIAS ((cost_t) 1 << 32)
+
+void ch_ctor(ch * ch)
+{
+    ch->w = 0;
+    ch->h = 0;
+    ch->up_first = NULL;
+    ch->up = NULL;
+    ch->down_first = NULL;
+    ch->down = NULL;
+    ch->shortcuts = 0;
+    ch->checksum = 0;
+    ch->parent[0] = NULL;
+    ch->parent[1] = NULL;
+    ch->pend = NULL;
+    ch->pend_cap = 0;
+}
+
+void ch_dtor(ch * ch)
+{
+    free(ch->up_first);
+    free(ch->up);
+    free(ch->down_first);
+    free(ch->down);
+    free(ch->parent[0]);
+    free(ch->parent[1]);
+    free(ch->pend);
+}
+
+// offsets and query scratch for a w x h map; the arcs come after
+static
+void ch_alloc(ch * ch, int w, int h)
+{
+    idx_t n = (idx_t) w * h;
+    ch->w = w;
+    ch->h = h;
+    ch->up_first = (idx_t *) realloc(ch->up_first, sizeof(idx_t) * (n + 1));
+    ch->down_first = (idx_t *) realloc(ch->down_first, sizeof(idx_t) * (n + 1));
+    ch->parent[0] = (idx_t *) realloc(ch->parent[0], sizeof(idx_t) * n);
+    ch->parent[1] = (idx_t *) realloc(ch->parent[1], sizeof(idx_t) * n);
+}
+
+static
+void list_push(ch_list * list, const ch_arc * arc)
+{
+    if (list->size == list->cap) {
+        list->cap = list->cap ? list->cap * 2 : 8;
+        list->arc = (ch_arc *) realloc(list->arc, sizeof(ch_arc) * list->cap);
+    }
+    list->arc[list->size++] = *arc;
+}
+
+static
+ch_arc * list_find(ch_list * list, idx_t node)
+{
+    for (int i = 0; i < list->size; ++i) {
+        if (list->arc[i].node == node)
+            return &list->arc[i];
+    }
+    return NULL;
+}
+
+static
+void list_drop(ch_list * list, idx_t node)
+{
+    ch_arc * arc = list_find(list, node);
+    if (arc != NULL)
+        *arc = list->arc[--list->size];
+}
+
+// add arc u -> w, or lower the cost of the one already there
+static
+void arc_add(builder * b, idx_t u, idx_t w, cost_t cost, idx_t mid)
+{
+    ch_arc * out = list_find(&b->out[u], w);
+    if (out != NULL) {
+        if (cost >= out->cost)
+            return;
+        ch_arc * in = list_find(&b->in[w], u);
+        out->cost = in->cost = cost;
+        out->mid = in->mid = mid;
+        return;
+    }
+    ch_arc arc = {.node = w, .mid = mid, .cost = cost};
+    list_push(&b->out[u], &arc);
+    arc.node = u;
+    list_push(&b->in[w], &arc);
+}
+
+// Dijkstra from u over the nodes not yet contracted, never through v, to
+// at most CH_WITNESS nodes and no farther than limit, or until it settles
+// the targets arcs out of v lead to. a node's cost is then that of some
+// path to it, even if the search stopped before settling it
+static
+void witness(builder * b, graph * graph, heap * heap, idx_t u, idx_t v,
+             cost_t limit, int targets)
+{
+    gen_graph(graph, b->search);
+    graph_touch(graph, v);
+    bit_set(graph->visit, v);
+    graph_touch(graph, u);
+    graph->cost[u] = 0;
+    heap_push(heap, u, 0);
+
+    int settled = 0;
+    idx_t x;
+    while (heap_pop(heap, &x)) {
+        if (graph->cost[x] > limit || ++settled > CH_WITNESS)
+            break;
+        bit_set(graph->visit, x);
+        if (b->target[x] == v && --targets == 0)
+            break;
+
+        const ch_list * out = &b->out[x];
+        for (int i = 0; i < out->size; ++i) {
+            idx_t y = out->arc[i].node;
+            graph_touch(graph, y);
+            if (bit_get(graph->visit, y))
+                continue;
+            cost_t cost = graph->cost[x] + out->arc[i].cost;
+            if (cost <= limit && cost < graph->cost[y]) {
+                graph->cost[y] = cost;
+                heap_push(heap, y, cost);
+            }
+        }
+    }
+    heap_dtor(heap);
+}
+
+// the shortcuts contracting v needs; add them too unless simulate
+static
+int contract(builder * b, idx_t v, bool simulate)
+{
+    graph graph;
+    heap heap;
+    int count = 0;
+
+    heap_ctor(&heap, b->search);
+    const ch_list * in = &b->in[v];
+    const ch_list * out = &b->out[v];
+    for (int j = 0; j < out->size; ++j)
+        b->target[out->arc[j].node] = v;
+    for (int i = 0; i < in->size; ++i) {
+        const ch_arc * a = &in->arc[i];
+        cost_t limit = 0;
+        for (int j = 0; j < out->size; ++j) {
+            const ch_arc * o = &out->arc[j];
+            if (o->node != a->node && a->cost + o->cost > limit)
+                limit = a->cost + o->cost;
+        }
+        if (limit == 0)
+            continue;
+
+        witness(b, &graph, &heap, a->node, v, limit, out->size);
+        for (int j = 0; j < out->size; ++j) {
+            const ch_arc * o = &out->arc[j];
+            if (o->node == a->node)
+                continue;
+            graph_touch(&graph, o->node);
+            if (graph.cost[o->node] <= a->cost + o->cost)
+                continue;
+            count += 1;
+            if (!simulate)
+                arc_add(b, a->node, o->node, a->cost + o->cost, v);
+        }
+    }
+    return count;
+}
+
+static
+cost_t priority(builder * b, idx_t v)
+{
+    int64_t arcs = b->in[v].size + b->out[v].size;
+    return CH_BIAS + contract(b, v, true) - arcs + b->deleted[v];
+}
+
+// the arcs each node was left with, packed one node after another
+static
+ch_arc * pack(const ch_list * lists, idx_t n, idx_t * first)
+{
+    idx_t size = 0;
+    for (idx_t v = 0; v < n; ++v)
+        size += lists[v].size;
+    ch_arc * arcs = (ch_arc *) malloc(sizeof(ch_arc) * (size > 0 ? size : 1));
+    size = 0;
+    for (idx_t v = 0; v < n; ++v) {
+        first[v] = size;
+        // a node without arcs has no array to copy from
+        if (lists[v].size)
+            memcpy(arcs + size, lists[v].arc, sizeof(ch_arc) * lists[v].size);
+        size += lists[v].size;
+    }
+    first[n] = size;
+    return arcs;
+}
+
+void ch_build(ch * ch, search * search, const map * map)
+{
+    struct search_ scratch;
+    builder b;
+    idx_t n = (idx_t) map->w * map->h;
+
+    b.n = n;
+    b.search = search_acquire(search, &scratch, map);
+    b.out = (ch_list *) calloc(n, sizeof(ch_list));
+    b.in = (ch_list *) calloc(n, sizeof(ch_list));
+    b.deleted = (int *) calloc(n, sizeof(int));
+    b.target = (idx_t *) malloc(sizeof(idx_t) * n);
+    for (idx_t i = 0; i < n; ++i)
+        b.target[i] = -1;
+
+    for (int y = 0; y < map->h; ++y) {
+        for (int x = 0; x < map->w; ++x) {
+            idx_t u = x + (idx_t) map->w * y;
+            for (int i = 0; i < 8; i += 1) {
+                coord next = {.x = x + dirs[i][0], .y = y + dirs[i][1]};
+                if (next.x < 0 || next.x >= map->w ||
+                    next.y < 0 || next.y >= map->h)
+                    continue;
+                int32_t tile = tile_cost(map, next.x, next.y);
+                if (tile == (int32_t) 0xDEADBEEF)
+                    continue;
+                arc_add(&b, u, next.x + (idx_t) map->w * next.y,
+                        dirs[i][2] + ((cost_t) tile << 1), -1);
+            }
+        }
+    }
+
+    // the order queue has its own slots: the witness searches use the
+    // workspace's heap
+    heap order = {
+        .buffer = (idx_t *) malloc(sizeof(idx_t) * n),
+        .key = (cost_t *) malloc(sizeof(cost_t) * n),
+        .pos = (idx_t *) malloc(sizeof(idx_t) * n),
+        .size = 0,
+        .cap = n,
+    };
+    for (idx_t v = 0; v < n; ++v)
+        order.pos[v] = -1;
+    for (idx_t v = 0; v < n; ++v)
+        heap_push(&order, v, priority(&b, v));
+
+    idx_t v;
+    while (heap_pop(&order, &v)) {
+        cost_t key = priority(&b, v);
+        if (order.size > 0 && key > order.key[0]) {
+            heap_push(&order, v, key);
+            continue;
+        }
+        contract(&b, v, false);
+        dprintf("contract %lld\n", (long long) v);
+
+        // v's arcs are all to higher nodes now and stay as they are; the
+        // neighbors drop theirs to v. a neighbor both ways counts twice, as
+        // it loses two arcs
+        for (int i = 0; i < b.in[v].size; ++i) {
+            list_drop(&b.out[b.in[v].arc[i].node], v);
+            b.deleted[b.in[v].arc[i].node] += 1;
+        }
+        for (int i = 0; i < b.out[v].size; ++i) {
+            list_drop(&b.in[b.out[v].arc[i].node], v);
+            b.deleted[b.out[v].arc[i].node] += 1;
+        }
+    }
+
+    ch_alloc(ch, map->w, map->h);
+    free(ch->up);
+    free(ch->down);
+    ch->up = pack(b.out, n, ch->up_first);
+    ch->down = pack(b.in, n, ch->down_first);
+    ch->shortcuts = 0;
+    for (idx_t i = 0; i < ch->up_first[n]; ++i)
+        ch->shortcuts += ch->up[i].mid >= 0;
+    for (idx_t i = 0; i < ch->down_first[n]; ++i)
+        ch->shortcuts += ch->down[i].mid >= 0;
+    ch->checksum = map_hash(map);
+
+    for (idx_t i = 0; i < n; ++i) {
+        free(b.out[i].arc);
+        free(b.in[i].arc);
+    }
+    free(b.out);
+    free(b.in);
+    free(b.deleted);
+    free(b.target);
+    free(order.buffer);
+    free(order.key);
+    free(order.pos);
+    search_release(b.search, &scratch);
+}
+
+int ch_save(const ch * ch, const char * file_name)
+{
+    FILE * file = fopen(file_name, "wb");
+    if (file == NULL)
+        return 1;
+
+    idx_t n = (idx_t) ch->w * ch->h;
+    char head[CH_DATA] = {0};
+    ch_header * header = (ch_header *) head;
+    header->magic = CH_MAGIC;
+    header->version = CH_VERSION;
+    header->w = ch->w;
+    header->h = ch->h;
+    header->checksum = ch->checksum;
+    header->up = ch->up_first[n];
+    header->down = ch->down_first[n];
+    header->shortcuts = ch->shortcuts;
+
+    size_t first = n + 1;
+    int err = fwrite(head, 1, CH_DATA, file) != CH_DATA ||
+              fwrite(ch->up_first, sizeof(idx_t), first, file) != first ||
+              fwrite(ch->up, sizeof(ch_arc), header->up, file) != header->up ||
+              fwrite(ch->down_first, sizeof(idx_t), first, file) != first ||
+              fwrite(ch->down, sizeof(ch_arc), header->down, file) != header->down;
+    err |= fclose(file) != 0;
+    return err;
+}
+
+// offsets read back must index arcs in order: from 0, never back, ending
+// at the count of them, and every arc must land on a cell of the map
+static
+bool arcs_valid(const idx_t * first, const ch_arc * arcs, uint64_t count,
+                idx_t cells)
+{
+    if (first[0] != 0 || (uint64_t) first[cells] != count)
+        return false;
+    for (idx_t i = 0; i < cells; ++i)
+        if (first[i] > first[i + 1])
+            return false;
+    for (uint64_t i = 0; i < count; ++i)
+        if (arcs[i].node < 0 || arcs[i].node >= cells ||
+            arcs[i].mid < -1 || arcs[i].mid >= cells)
+            return false;
+    return true;
+}
+
+int ch_load(ch * ch, const char * file_name, const map * map)
+{
+    FILE * file = fopen(file_name, "rb");
+    if (file == NULL)
+        return 1;
+
+    char head[CH_DATA];
+    ch_header * header = (ch_header *) head;
+    if (fread(head, 1, CH_DATA, file) != CH_DATA ||
+        header->magic != CH_MAGIC || header->version != CH_VERSION ||
+        header->w != map->w || header->h != map->h ||
+        header->checksum != map_hash(map)) {
+        fclose(file);
+        return 1;
+    }
+
+    ch_alloc(ch, header->w, header->h);
+    ch->up = (ch_arc *) realloc(ch->up, sizeof(ch_arc) * (header->up + 1));
+    ch->down = (ch_arc *) realloc(ch->down, sizeof(ch_arc) * (header->down + 1));
+    ch->shortcuts = header->shortcuts;
+    ch->checksum = header->checksum;
+
+    size_t first = (size_t) ch->w * ch->h + 1;
+    int err = fread(ch->up_first, sizeof(idx_t), first, file) != first ||
+              fread(ch->up, sizeof(ch_arc), header->up, file) != header->up ||
+              fread(ch->down_first, sizeof(idx_t), first, file) != first ||
+              fread(ch->down, sizeof(ch_arc), header->down, file) != header->down ||
+              !arcs_valid(ch->up_first, ch->up, header->up, first - 1) ||
+              !arcs_valid(ch->down_first, ch->down, header->down, first - 1);
+    fclose(file);
+    if (err) {
+        // never leave a hierarchy that only looks built
+        ch->w = 0;
+        ch->h = 0;
+    }
+    return err;
+}
+
+// one side of a query: its workspace, the arcs it climbs, and the arcs
+// the other way that can stall it
+typedef struct side_
+{
+    graph graph;
+    heap heap;
+    const idx_t * first;
+    const ch_arc * arcs;
+    const idx_t * stall_first;
+    const ch_arc * stall;
+    idx_t * parent;
+    bool done;
+} side;
+
+// settle the top node of one side and climb its arcs. mu and meet track
+// the cheapest node both sides reached
+static
+void side_expand(side * self, side * other, cost_t * mu, idx_t * meet,
+                 prof * prof)
+{
+    graph * graph = &self->graph;
+    idx_t idx = 0;
+    heap_pop(&self->heap, &idx);
+    prof->expand += 1;
+    bit_set(graph->visit, idx);
+
+    graph_touch(&other->graph, idx);
+    if (other->graph.cost[idx] != COST_INF &&
+        graph->cost[idx] + other->graph.cost[idx] < *mu) {
+        *mu = graph->cost[idx] + other->graph.cost[idx];
+        *meet = idx;
+    }
+
+    // a higher node this side already reached gets here for less down an
+    // arc the search cannot take: idx is not on a shortest path, and
+    // climbing on from it would only widen the search
+    for (idx_t i = self->stall_first[idx]; i < self->stall_first[idx + 1]; ++i) {
+        const ch_arc * arc = &self->stall[i];
+        graph_touch(graph, arc->node);
+        if (graph->cost[arc->node] != COST_INF &&
+            graph->cost[arc->node] + arc->cost < graph->cost[idx])
+            return;
+    }
+
+    for (idx_t i = self->first[idx]; i < self->first[idx + 1]; ++i) {
+        const ch_arc * arc = &self->arcs[i];
+        graph_touch(graph, arc->node);
+        if (bit_get(graph->visit, arc->node))
+            continue;
+        cost_t cost = graph->cost[idx] + arc->cost;
+        if (cost < graph->cost[arc->node]) {
+            graph->cost[arc->node] = cost;
+            self->parent[arc->node] = idx;
+            heap_push(&self->heap, arc->node, cost);
+        }
+    }
+}
+
+static
+idx_t ch_search(side * fwd, side * rev, prof * prof)
+{
+    cost_t mu = COST_INF;
+    idx_t meet = -1;
+    for (;;) {
+        // a side is done once nothing it has queued can beat mu
+        fwd->done |= fwd->heap.size == 0 || fwd->heap.key[0] >= mu;
+        rev->done |= rev->heap.size == 0 || rev->heap.key[0] >= mu;
+        if (fwd->done && rev->done)
+            break;
+        if (rev->done || (!fwd->done && fwd->heap.key[0] <= rev->heap.key[0]))
+            side_expand(fwd, rev, &mu, &meet, prof);
+        else
+            side_expand(rev, fwd, &mu, &meet, prof);
+    }
+    return meet;
+}
+
+// the arc u -> w lives with whichever end is lower
+static
+const ch_arc * arc_find(const ch * ch, idx_t u, idx_t w)
+{
+    for (idx_t i = ch->up_first[u]; i < ch->up_first[u + 1]; ++i) {
+        if (ch->up[i].node == w)
+            return &ch->up[i];
+    }
+    for (idx_t i = ch->down_first[w]; i < ch->down_first[w + 1]; ++i) {
+        if (ch->down[i].node == u)
+            return &ch->down[i];
+    }
+    return NULL;
+}
+
+// push a move onto the path stack, merging it into the top one if it goes
+// the same way
+static
+void path_push(path * path, const movement * move)
+{
+    if (vector_size(&path->moves) > 0) {
+        movement * top = (movement *) vector_backp(&path->moves);
+        if (top->x_dir == move->x_dir && top->y_dir == move->y_dir) {
+            top->count += move->count;
+            return;
+        }
+    }
+    vector_push_back(&path->moves, move);
+}
+
+// unpack arc u -> w into moves. the path is a stack whose top is the first
+// move, so the half of a shortcut nearer the end is unpacked first
+static
+void unpack(ch * ch, path * path, idx_t u, idx_t w)
+{
+    idx_t top = 0;
+    ch->pend[top++] = u;
+    ch->pend[top++] = w;
+    while (top > 0) {
+        w = ch->pend[--top];
+        u = ch->pend[--top];
+        const ch_arc * arc = arc_find(ch, u, w);
+        if (arc->mid < 0) {
+            movement move = {
+                .count = 1,
+                .x_dir = (int) (w % ch->w - u % ch->w),
+                .y_dir = (int) (w / ch->w - u / ch->w),
+            };
+            path_push(path, &move);
+            continue;
+        }
+        if (top + 4 > ch->pend_cap) {
+            ch->pend_cap = ch->pend_cap ? ch->pend_cap * 2 : 64;
+            ch->pend = (idx_t *) realloc(ch->pend, sizeof(idx_t) * ch->pend_cap);
+        }
+        ch->pend[top++] = u;
+        ch->pend[top++] = arc->mid;
+        ch->pend[top++] = arc->mid;
+        ch->pend[top++] = w;
+    }
+}
+
+// the moves from start up to meet and down to end, pushed from the end
+static
+void ch_path(ch * ch, idx_t s, idx_t t, idx_t meet, path * path)
+{
+    if (ch->pend_cap < 4) {
+        ch->pend_cap = 64;
+        ch->pend = (idx_t *) realloc(ch->pend, sizeof(idx_t) * ch->pend_cap);
+    }
+
+    // the backward tree points from meet toward the end; turn it around
+    // so the hops nearest the end come first
+    idx_t * down = ch->parent[1];
+    idx_t prev = -1;
+    for (idx_t x = meet; x != t;) {
+        idx_t next = down[x];
+        down[x] = prev;
+        prev = x;
+        x = next;
+    }
+    for (idx_t w = t, u = prev; u >= 0; w = u, u = down[u])
+        unpack(ch, path, u, w);
+
+    for (idx_t w = meet; w != s; w = ch->parent[0][w])
+        unpack(ch, path, ch->parent[0][w], w);
+}
+
+void chpath_find(ch * ch, search * search, const map * map,
+                 const coord * start, const coord * end, path * path,
+                 prof * prof)
+{
+    struct search_ scratch;
+    side fwd, rev;
+
+    prof_ctor(prof);
+
+    prof_start(prof);
+    path_ctor(path);
+    search = search_acquire(search, &scratch, map);
+    if (ch->up_first == NULL || ch->checksum != map_hash(map))
+        ch_build(ch, search, map);
+    struct search_ * back = rev_acquire(search, map);
+    gen_graph(&fwd.graph, search);
+    heap_ctor(&fwd.heap, search);
+    gen_graph(&rev.graph, back);
+    heap_ctor(&rev.heap, back);
+    fwd.first = ch->up_first;
+    fwd.arcs = ch->up;
+    fwd.stall_first = ch->down_first;
+    fwd.stall = ch->down;
+    fwd.parent = ch->parent[0];
+    fwd.done = false;
+    rev.first = ch->down_first;
+    rev.arcs = ch->down;
+    rev.stall_first = ch->up_first;
+    rev.stall = ch->up;
+    rev.parent = ch->parent[1];
+    rev.done = false;
+
+    idx_t s = graph_idx(&fwd.graph, start->x, start->y);
+    idx_t t = graph_idx(&rev.graph, end->x, end->y);
+    graph_touch(&fwd.graph, s);
+    fwd.graph.cost[s] = 0;
+    heap_push(&fwd.heap, s, 0);
+    graph_touch(&rev.graph, t);
+    rev.graph.cost[t] = 0;
+    heap_push(&rev.heap, t, 0);
+    prof_end(prof); prof->prproc = prof_dt(prof);
+
+    prof_start(prof);
+    idx_t meet = ch_search(&fwd, &rev, prof);
+    prof_end(prof); prof->exec = prof_dt(prof);
+
+    prof_start(prof);
+    if (meet >= 0)
+        ch_path(ch, s, t, meet, path);
+    heap_dtor(&fwd.heap);
+    heap_dtor(&rev.heap);
+    search_release(search, &scratch);
+    prof_end(prof); prof->poproc = prof_dt(prof);
+}
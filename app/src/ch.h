@@ -0,0 +1,95 @@
+#ifndef __CH_H__
+#define __CH_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+#include "map.h"
+#include "path.h"
+#include "world.h"
+#include "prof.h"
+
+// most nodes a witness search settles before it gives up and lets the
+// shortcut in. more keeps the hierarchy leaner but preprocesses slower
+#define CH_WITNESS 64
+
+// hierarchy files: a header, then at CH_DATA the upward arcs and the
+// downward arcs, each as n + 1 offsets followed by the arcs, in the byte
+// order of the machine that wrote them. checksum is map_hash of the map
+// the hierarchy was built for
+#define CH_MAGIC 0x48434B44     // "DKCH"
+#define CH_VERSION 1
+#define CH_DATA 64
+
+typedef struct ch_header_
+{
+    uint32_t magic;
+    uint32_t version;
+    int32_t w;
+    int32_t h;
+    uint64_t checksum;
+    uint64_t up;                // arcs in each direction
+    uint64_t down;
+    uint64_t shortcuts;
+} ch_header;
+
+// an arc to or from a higher node. mid is the node a shortcut was added
+// to skip, -1 for a single move
+typedef struct ch_arc_
+{
+    idx_t node;
+    idx_t mid;
+    cost_t cost;
+} ch_arc;
+
+// contraction hierarchy of one map: every cell is ranked, and contracting
+// the cells in rank order adds shortcut arcs that keep the costs between
+// the remaining ones. a query searches only upward from both of its ends,
+// meets at the highest node of the path, and unpacks the shortcuts back
+// into moves. paths are exactly the shortest.
+//
+// like alt, build one per map and keep it; it is built on the first query
+// or read back with ch_load. it describes the map as it was built: a query
+// on a map whose map_hash differs, including the same map after a tile
+// changed, builds it again first
+typedef struct ch_
+{
+    int w;                      // map size the hierarchy is built for
+    int h;
+    idx_t * up_first;           // w * h + 1 offsets into up
+    ch_arc * up;                // arcs out of each node to higher ones
+    idx_t * down_first;
+    ch_arc * down;              // arcs into each node from higher ones
+    idx_t shortcuts;
+    uint64_t checksum;
+    // query scratch
+    idx_t * parent[2];          // forward and backward search trees
+    idx_t * pend;               // arcs waiting to be unpacked
+    idx_t pend_cap;
+} ch;
+
+void ch_ctor(ch * ch);
+void ch_dtor(ch * ch);
+
+// orders and contracts every cell; search is the workspace the witness
+// searches run in, NULL builds one
+void ch_build(ch * ch, search * search, const map * map);
+
+// returns 0 on success
+int ch_save(const ch * ch, const char * file_name);
+// fails if the file was built for another map or its arcs do not index
+// the map. returns 0 on success
+int ch_load(ch * ch, const char * file_name, const map * map);
+
+void chpath_find(ch * ch, search * search, const map * map,
+                 const coord * start, const coord * end, path * path,
+                 prof * prof);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif//__CH_H__
@@ -12,91 +12,23 @@
 #include <sys/types.h>
 
 #include <ncurses.h>
-#include <mem/mem.h>
 
 #include "map.h"
 #include "world.h"
 #include "path.h"
 
 #include "prof.h"
-
-// signal stuff
-//#define INTERRUPT
-#ifdef INTERRUPT
-int sigio_handled = 0;
-void sig_handler(int signo)
-{
-    if (signo == SIGIO) {
-        sigio_handled = 1;
-    }
-}
-
-#define INT_DEVICE "/dev/dkstr_int"
-int fd;
-int sig_init(void)
-{
-    int status = 0;
-    struct sigaction action;
-    sigemptyset(&action.sa_mask);
-    sigaddset(&action.sa_mask, SIGIO);
-    action.sa_handler = sig_handler;
-    action.sa_flags = 0;
-    sigaction(SIGIO, &action, NULL);
-
-    // acquire the device
-    fd = open(INT_DEVICE, O_RDONLY);
-    if (fd == -1) {
-        fprintf(stderr, "Unable to open " INT_DEVICE "\n");
-        return 1;
-    }
-
-    // setup flags for the device
-    int fc;
-    fc = fcntl(fd, F_SETOWN, getpid());
-    if (fc == -1) {
-        fprintf(stderr, "Unable to SETOWN\n");
-        status = 2;
-        goto cleanup;
-    }
-
-    fc = fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_ASYNC);
-    if (fc == -1) {
-        fprintf(stderr, "Unable to SETFL OASYNC\n");
-        status = 3;
-        goto cleanup;
-    }
-
-    return 0;
-cleanup:
-    close(fd);
-    return status;
-}
-
-void sig_done(void)
-{
-    close(fd);
-}
-
-sigset_t wait_mask, wait_mask_old, wait_mask_most;
-void sig_wait_setup(void)
-{
-    sigio_handled = 0;
-    // need to run this block every time to preven sigsuspend race cond.
-    // this is literally magic
-    sigfillset(&wait_mask);
-    sigfillset(&wait_mask_most);
-    sigdelset(&wait_mask_most, SIGIO);
-    sigdelset(&wait_mask_most, SIGINT);
-    sigprocmask(SIG_SETMASK, &wait_mask, &wait_mask_old);
-}
-
-void sig_wait(void)
-{
-    while (sigio_handled == 0)
-        sigsuspend(&wait_mask_most);
-    sigprocmask(SIG_SETMASK, &wait_mask_old, NULL);
-}
-#endif
+#include "hpa.h"
+#include "alt.h"
+#include "ch.h"
+#include "cache.h"
+#include "replan.h"
+#include "batch.h"
+#include "tiles.h"
+#include "hw.h"
+#include "backend.h"
+#include "emu.h"
+#include "hwpipe.h"
 
 extern const int32_t cost_table[128];
 void draw_map(const map * map)
@@ -123,7 +55,7 @@ void ncurses_play(const map * map, const path * path,
     draw_entity(&e);
     refresh();
 
-    int cost = 0;
+    cost_t cost = 0;
     for (int i = vector_size(&(path->moves)) - 1; i >= 0; --i) {
         movement move;
         vector_get(&(path->moves), i, &move);
@@ -148,65 +80,45 @@ void ncurses_play(const map * map, const path * path,
     getch();
     endwin();
 
-    printf("Total cost: %d.%d\n", cost >> 1, (cost & 1) ? 5 : 0);
-}
-
-void convert_map(const map * map, uint32_t * buffer)
-{
-    uint32_t value = 0;
-    int count = 0;
-    for (int r = 0; r < map->w; ++r) {
-        for (int c = 0; c < map->h; ++c) {
-            uint8_t cost;
-            if (cost_table[map_get(map,c,r)] == 0xDEADBEEF)
-                cost = 0xF;
-            else
-                cost = cost_table[map_get(map,c,r)] & 0xF;
-
-            value |= cost << (count * 4);
-
-            if (count == 7) {
-                count = 0;
-                *buffer = value;
-                ++buffer;
-                value = 0;
-            } else {
-                ++count;
-            }
-        }
-    }
+    printf("Total cost: %llu.%d\n", (unsigned long long) (cost >> 1),
+           (cost & 1) ? 5 : 0);
 }
 
 int put_map(const char * map_path)
 {
-    mem_context mem_bram;
-    mem_ctor(&mem_bram, MEM_MMAP, 1, (void*)(uintptr_t) 0x40000000, (void*)(uintptr_t) 0x40000fff);
-    uint32_t * bram = mem_addr(&mem_bram, (void*)(uintptr_t) 0x40000000);
+    hw hw;
+    if (hw_ctor(&hw)) {
+        fprintf(stderr, "ERROR: unable to map the accelerator\n");
+        return 1;
+    }
 
     map map;
-    map_load(&map, map_path);
+    if (map_load(&map, map_path)) {
+        fprintf(stderr, "ERROR: unable to open map %s\n", map_path);
+        hw_dtor(&hw);
+        return 1;
+    }
 
-    convert_map(&map, bram);
+    convert_map(&map, hw.bram_map);
 
     map_dtor(&map);
-    mem_dtor(&mem_bram);
+    hw_dtor(&hw);
     return 0;
 }
 
 int dump_map(const char * map_path)
 {
     map map;
-    map_load(&map, map_path);
-
-    int buff_n = 0;
-    buff_n = (map.w * map.h) / 8;
-    if ((map.w * map.h) % 8 != 0)
-        buff_n += 1; // compensate if not aligned
+    if (map_load(&map, map_path)) {
+        fprintf(stderr, "ERROR: unable to open map %s\n", map_path);
+        return 1;
+    }
 
+    size_t buff_n = map_words(map.w, map.h);
     uint32_t * map_buffer = (uint32_t *) malloc(sizeof(uint32_t) * buff_n);
 
     convert_map(&map, map_buffer);
-    for (int i = 0; i < buff_n; ++i) {
+    for (size_t i = 0; i < buff_n; ++i) {
         printf("%08x\n", map_buffer[i]);
     }
 
@@ -215,11 +127,89 @@ int dump_map(const char * map_path)
     return 0;
 }
 
+// text map to a binary map file; packed stores 4-bit costs instead of the
+// tile characters
+int bin_map(const char * map_path, const char * bin_path, int packed)
+{
+    map map;
+    if (map_load(&map, map_path)) {
+        fprintf(stderr, "ERROR: unable to open map %s\n", map_path);
+        return 1;
+    }
+    if (packed && map.buffer) {
+        struct map_ tiles = map;
+        map_pack(&map, &tiles);
+        map_dtor(&tiles);
+    }
+
+    int err = map_save(&map, bin_path);
+    if (err)
+        fprintf(stderr, "ERROR: cannot write %s\n", bin_path);
+    map_dtor(&map);
+    return err;
+}
+
+// text map to a tiled map file, a band of rows at a time
+int tile_map(const char * map_path, const char * tiled_path, int side)
+{
+    int err = map_convert_tiled(map_path, tiled_path, side);
+    if (err)
+        fprintf(stderr, "ERROR: unable to convert map %s\n", map_path);
+    return err;
+}
+
+// landmark tables for a map, saved next to it as <map path>.alt
+int alt_map(const char * map_path, int landmarks)
+{
+    map map;
+    if (map_load(&map, map_path)) {
+        fprintf(stderr, "ERROR: unable to open map %s\n", map_path);
+        return 1;
+    }
+
+    char alt_path[4096];
+    alt alt;
+    alt_ctor(&alt, landmarks);
+    alt_build(&alt, NULL, &map);
+    snprintf(alt_path, sizeof(alt_path), "%s.alt", map_path);
+    int err = alt_save(&alt, alt_path);
+    if (err)
+        fprintf(stderr, "ERROR: cannot write %s\n", alt_path);
+    alt_dtor(&alt);
+    map_dtor(&map);
+    return err;
+}
+
+// contraction hierarchy for a map, saved next to it as <map path>.ch
+int ch_map(const char * map_path)
+{
+    map map;
+    if (map_load(&map, map_path)) {
+        fprintf(stderr, "ERROR: unable to open map %s\n", map_path);
+        return 1;
+    }
+
+    char ch_path[4096];
+    ch ch;
+    ch_ctor(&ch);
+    ch_build(&ch, NULL, &map);
+    snprintf(ch_path, sizeof(ch_path), "%s.ch", map_path);
+    int err = ch_save(&ch, ch_path);
+    if (err)
+        fprintf(stderr, "ERROR: cannot write %s\n", ch_path);
+    ch_dtor(&ch);
+    map_dtor(&map);
+    return err;
+}
+
 int put_path(const char * path_path)
 {
-    mem_context mem_bram;
-    mem_ctor(&mem_bram, MEM_MMAP, 1, (void*)(uintptr_t) 0x40001000, (void*)(uintptr_t) 0x40001fff);
-    uint32_t * bram = mem_addr(&mem_bram, (void*)(uintptr_t) 0x40001000);
+    hw hw;
+    if (hw_ctor(&hw)) {
+        fprintf(stderr, "ERROR: unable to map the accelerator\n");
+        return 1;
+    }
+    uint32_t * bram = hw.bram_dir;
 
     FILE * file = fopen(path_path, "r");
     uint32_t val = 0;
@@ -229,7 +219,7 @@ int put_path(const char * path_path)
     }
     fclose(file);
 
-    mem_dtor(&mem_bram);
+    hw_dtor(&hw);
     return 0;
 }
 
@@ -277,9 +267,12 @@ int print_path_file(const char * path, int w, int h)
 
 int print_path(int w, int h)
 {
-    mem_context mem_bram;
-    mem_ctor(&mem_bram, MEM_MMAP, 1, (void*)(uintptr_t) 0x40001000, (void*)(uintptr_t) 0x40001fff);
-    uint32_t * bram = mem_addr(&mem_bram, (void*)(uintptr_t) 0x40001000);
+    hw hw;
+    if (hw_ctor(&hw)) {
+        fprintf(stderr, "ERROR: unable to map the accelerator\n");
+        return 1;
+    }
+    const uint32_t * bram = hw.bram_dir;
 
     uint32_t val = 0;
     uint8_t count = 0;
@@ -304,7 +297,7 @@ int print_path(int w, int h)
         printf("\n");
     }
 
-    mem_dtor(&mem_bram);
+    hw_dtor(&hw);
     return 0;
 }
 
@@ -314,7 +307,10 @@ void playback_map(const char * map_path, const char * path_path, const coord * e
     map map;
     path path;
 
-    map_load(&map, map_path);
+    if (map_load(&map, map_path) || map.buffer == NULL) {
+        fprintf(stderr, "ERROR: unable to draw map %s\n", map_path);
+        return;
+    }
     coord start = path_play(&path, &map, path_path, end);
     ncurses_play(&map, &path, &start);
 
@@ -322,200 +318,63 @@ void playback_map(const char * map_path, const char * path_path, const coord * e
     map_dtor(&map);
 }
 
-// gets the 4-bit dir code from a buffer
-//#define hw_get(buffer,x,y) ( ((x)*(y)))
-static inline
-uint8_t hw_get(const uint32_t * buffer, int w, int h, int x, int y)
-{
-    // convert into a linear index into w*h*8 4-bit buffer
-    int lindex = x + y *h;
-    int index = lindex / 8;
-    return (buffer[index] >> ((lindex % 8) * 4)) & 0xF;
-}
+// side of the random maps rand and the profiles route on by default; with
+// its border a 28x28 map fits the fabric
+#define RAND_SIDE 28
 
-const int dirs[8][2] =
+// the names of the registered engines joined by sep, for the usage lines
+static
+const char * engine_names(const char * sep)
 {
-    { 0,-1},// north
-    { 1,-1},// northeast
-    { 1, 0},// east
-    { 1, 1},// southeast
-    { 0, 1},// south
-    {-1, 1},// southwest
-    {-1, 0},// west
-    {-1,-1},// northwest
-};
-
-void hw_gen_path(int w, int h, const coord * start, const coord * end,
-                const uint32_t * buffer, path * path)
-{
-    path_ctor(path);
-
-    uint8_t dir = 0;
-    uint8_t prev_dir = 0xFF;
-    coord curr = *end;
-    int count = 0;
-    int max = w * h;
-    while (!(curr.x == start->x && curr.y == start->y)) {
-        if (count++ >= max) {
-            //printf("Max hit\n");
-            return;
-        }
-
-        dir = hw_get(buffer, w, h, curr.x, curr.y);
-        if (dir & 0x8)
-            dir &= 0x7;
-        else {
-            //printf("No path from (%d,%d) to (%d,%d)\n", start->x, start->y, end->x, end->y);
-            return;
-        }
-
-        /*
-        printf("Going from (%d,%d) -> (%d,%d)\n",
-               curr.x, curr.y,
-               curr.x + dirs[dir][0], curr.y + dirs[dir][1]);
-        */
-
-        if (dir == prev_dir) {
-            movement * move_p = (movement *) vector_backp(&path->moves);
-            move_p->count += 1;
-        }
-        else {
-            movement move;
-            move.count = 1;
-            // reverse since we're moving backwards
-            move.x_dir = -dirs[dir][0];
-            move.y_dir = -dirs[dir][1];
-            vector_push_back(&path->moves, &move);
-        }
-        curr.x = curr.x + dirs[dir][0];
-        curr.y = curr.y + dirs[dir][1];
-
-        prev_dir = dir;
-    }
-}
-
-#define CTRL_RUN (1 << 31)
-#define CTRL_LD  (1 << 30)
-#define CTRL_X_MASK (0x1F)
-#define CTRL_Y_MASK (0x1F)
-#define CTRL_Y_SHF (5)
-#define CTRL_X_SHF (0)
-int hw_pathfind(const map * map, const coord * start, const coord * end, path * path,
-                uint32_t * bram_map, uint32_t * bram_dir, volatile uint32_t * dkstr,
-                prof * prof)
-{
-    prof_start(prof);
-    // since 8 node weights fit into a single word, figure out how
-    // many words we need
-    int buff_n = 0;
-    buff_n = (map->w * map->h) / 8;
-    if ((map->w * map->h) % 8 != 0)
-        buff_n += 1; // compensate if not aligned
-
-    uint32_t * map_buffer = (uint32_t *) malloc(sizeof(uint32_t) * buff_n);
-
-    convert_map(map, map_buffer);
-    prof_end(prof); prof->prproc += prof_dt(prof);
-
-    // transfer node weights to bram
-    prof_start(prof);
-    memcpy(bram_map, map_buffer, sizeof(uint32_t) * buff_n);
-    prof_end(prof); prof->tx += prof_dt(prof);
-
-    // setup the ctrl reg value and program
-    prof_start(prof);
-    uint32_t ctrl = CTRL_RUN | CTRL_LD |
-                    (start->y & CTRL_Y_MASK) << CTRL_Y_SHF |
-                    (start->x & CTRL_X_MASK) << CTRL_X_SHF;
-
-    #if defined(INTERRUPT)
-    // interrupt
-    sig_wait_setup();
-    *dkstr = ctrl;
-    sig_wait();
-    #else
-    // poll
-    *dkstr = ctrl;
-    int loops = 0;
-    while ((*dkstr) & CTRL_RUN)
-        ++loops;
-    //printf("poll loops: %d\n", loops);
-    #endif
-    prof_end(prof); prof->exec += prof_dt(prof);
-
-    ///*
-    // transfer back
-    prof_start(prof);
-    uint32_t * dir_buffer = (uint32_t *) malloc(sizeof(uint32_t) * buff_n);
-    memcpy(dir_buffer, bram_dir, sizeof(uint32_t) * buff_n);
-    prof_end(prof); prof->rx += prof_dt(prof);
-    prof_start(prof);
-    hw_gen_path(map->w, map->h, start, end, dir_buffer, path);
-    prof_end(prof); prof->poproc += prof_dt(prof);
-    free(dir_buffer);
-    //*/
-    /*
-    // work with BRAM directly
-    prof_start(prof);
-    hw_gen_path(map->w, map->h, start, end, bram_dir, path);
-    // could also load path: slower
-    // path_load(map, start, end, bram_dir, path);
-    prof_end(prof); prof->poproc += prof_dt(prof);
-    */
-
-    uint32_t ld_cycles = dkstr[1];
-    uint32_t run_cycles = dkstr[2];
-    uint32_t st_cycles = dkstr[3];
-    uint32_t total_cycles = ld_cycles + run_cycles + st_cycles;
-
-    /*
-    printf("Cycles spent loading the nodes: %d (%.2f%%)\n", ld_cycles,
-            (float) ld_cycles / (float) total_cycles * 100.0f);
-    printf("Cycles spent executing the nodes: %d (%.2f%%)\n", run_cycles,
-            (float) run_cycles / (float) total_cycles * 100.0f);
-    printf("Cycles spent storing the nodes: %d (%.2f%%)\n", st_cycles,
-            (float) st_cycles / (float) total_cycles * 100.0f);
-    */
-    /*
-    printf("Time spent loading the nodes: %d ns\n", (uint64_t)ld_cycles);
-    printf("Time  spent executing the nodes: %d ns\n", (uint64_t)run_cycles);
-    printf("Time spent storing the nodes: %d ns\n", (uint64_t)st_cycles);
-    */
-
-    free(map_buffer);
-    return 0;
+    static char names[1024];
+    const backend_ops * ops;
+    names[0] = '\0';
+    for (int i = 0; (ops = backend_at(i)) != NULL; ++i) {
+        size_t len = strlen(names);
+        snprintf(names + len, sizeof(names) - len, "%s%s", i > 0 ? sep : "", ops->name);
+    }
+    return names;
 }
 
-int play_map(const char * map_path, int hw, const coord * start, const coord * end)
+int play_map(const char * map_path, const backend_ops * ops, const coord * start, const coord * end)
 {
     map map;
     path path;
 
     if (map_path == NULL) {
-        map_rand(&map, 28, 28);
+        map_rand(&map, RAND_SIDE, RAND_SIDE);
     }
     else if (map_load(&map, map_path)) {
         fprintf(stderr, "ERROR: unable to open map %s\n", map_path);
         return 1;
     }
+    if (map.buffer == NULL) {
+        // the tiles themselves are drawn
+        fprintf(stderr, "ERROR: cannot play a packed map\n");
+        map_dtor(&map);
+        return 1;
+    }
 
-    prof prof;
-    prof_ctor(&prof);
-    if (hw) {
-        /// TODO
-        mem_context mem_bram, mem_dkstr;
-        mem_ctor(&mem_bram, MEM_MMAP, 1, (void*)(uintptr_t) 0x40000000, (void*)(uintptr_t) 0x40001fff);
-        mem_ctor(&mem_dkstr, MEM_MMAP, 1, (void*)(uintptr_t) 0x40004000, (void*)(uintptr_t) 0x40004fff);
-        uint32_t * bram_map = mem_addr(&mem_bram, (void*)(uintptr_t) 0x40000000);
-        uint32_t * bram_dir = mem_addr(&mem_bram, (void*)(uintptr_t) 0x40001000);
-        uint32_t * dkstr = mem_addr(&mem_dkstr, (void*)(uintptr_t) 0x40004000);
-        hw_pathfind(&map, start, end, &path, bram_map, bram_dir, dkstr, &prof);
-        mem_dtor(&mem_bram);
-        mem_dtor(&mem_dkstr);
+    if (!backend_fits(ops, &map)) {
+        fprintf(stderr, "map is %dx%d, larger than %s takes (%dx%d): routing in software\n",
+                map.w, map.h, ops->name, ops->side, ops->side);
+        ops = backend_find("sw");
     }
-    else {
-        path_find(&map, start, end, &path, &prof);
+
+    backend backend;
+    if (backend_ctor(&backend, ops)) {
+        fprintf(stderr, "ERROR: unable to start engine %s\n", ops->name);
+        map_dtor(&map);
+        return 1;
     }
+    // tables alt_map or ch_map saved next to the map skip building them
+    if (map_path != NULL && ops->attach != NULL)
+        ops->attach(&backend, map_path, &map);
+
+    prof prof;
+    prof_ctor(&prof);
+    backend_route(&backend, &map, start, end, &path, &prof);
+    backend_dtor(&backend);
     ncurses_play(&map, &path, start);
 
     prof_print(&prof);
@@ -576,7 +435,11 @@ void print_stats(data_point * p)
     printf("    SD  (ns): %0.2f\n", p->sd);
 }
 
-int profile(unsigned int seed, int hw, int samples)
+// maps are size x size. the backend is set up once, outside the samples;
+// cold has software engines allocate a fresh search workspace for every
+// sample instead of reusing one across them. packed packs every map first,
+// so the engines read 4-bit costs instead of tile characters
+int profile(unsigned int seed, const backend_ops * ops, int samples, int size, int cold, int packed)
 {
     // seed the things
     map_seed(seed);
@@ -588,18 +451,17 @@ int profile(unsigned int seed, int hw, int samples)
     uint64_t * rx_samples = (uint64_t *) malloc(sizeof(uint64_t) * samples);
     uint64_t * poproc_samples = (uint64_t *) malloc(sizeof(uint64_t) * samples);
     uint64_t * total_samples = (uint64_t *) malloc(sizeof(uint64_t) * samples);
+    uint64_t * expand_samples = (uint64_t *) malloc(sizeof(uint64_t) * samples);
+    uint64_t ld_cycles = 0, run_cycles = 0, st_cycles = 0;
 
-    mem_context mem_bram, mem_dkstr;
-    uint32_t * bram_map, * bram_dir, * dkstr;
-    if (hw) {
-        if (mem_ctor(&mem_bram, MEM_MMAP, 1, (void*)(uintptr_t) 0x40000000, (void*)(uintptr_t) 0x40001fff) != MEM_OKAY)
-            return 1;
-        if (mem_ctor(&mem_dkstr, MEM_MMAP, 1, (void*)(uintptr_t) 0x40004000, (void*)(uintptr_t) 0x40004fff) != MEM_OKAY)
-            return 1;
-        bram_map = mem_addr(&mem_bram, (void*)(uintptr_t) 0x40000000);
-        bram_dir = mem_addr(&mem_bram, (void*)(uintptr_t) 0x40001000);
-        dkstr = mem_addr(&mem_dkstr, (void*)(uintptr_t) 0x40004000);
+    backend backend;
+    if (backend_ctor(&backend, ops)) {
+        fprintf(stderr, "ERROR: unable to start engine %s\n", ops->name);
+        return 1;
     }
+    backend.cold = cold;
+    if (!cold)
+        backend_reserve(&backend, size, size);
 
     for (int i = 0; i < samples; ++i) {
         map map;
@@ -608,30 +470,34 @@ int profile(unsigned int seed, int hw, int samples)
         prof prof;
         prof_ctor(&prof);
 
-        map_rand(&map, 28, 28);
-        start.x = rand_r(&coord_seed) % 28;
-        start.y = rand_r(&coord_seed) % 28;
-        end.x = rand_r(&coord_seed) % 28;
-        end.y = rand_r(&coord_seed) % 28;
-
-        if (hw) {
-            hw_pathfind(&map, &start, &end, &path, bram_map, bram_dir, dkstr, &prof);
-            #ifdef INTERRUPT
-            // sleep so it doesn't choke on interrupts: from lab 2
-            if (i % 10000 == 0)
-                usleep(200000);
-            #endif
-        }
-        else {
-            path_find(&map, &start, &end, &path, &prof);
+        map_rand(&map, size, size);
+        start.x = rand_r(&coord_seed) % size;
+        start.y = rand_r(&coord_seed) % size;
+        end.x = rand_r(&coord_seed) % size;
+        end.y = rand_r(&coord_seed) % size;
+        if (packed) {
+            struct map_ tiles = map;
+            map_pack(&map, &tiles);
+            map_dtor(&tiles);
         }
 
+        backend_route(&backend, &map, &start, &end, &path, &prof);
+        #ifdef INTERRUPT
+        // sleep so it doesn't choke on interrupts: from lab 2
+        if (ops->find == NULL && i % 10000 == 0)
+            usleep(200000);
+        #endif
+
         prproc_samples[i] = prof.prproc;
         tx_samples[i] = prof.tx;
         exec_samples[i] = prof.exec;
         rx_samples[i] = prof.rx;
         poproc_samples[i] = prof.poproc;
         total_samples[i] = prof.prproc + prof.tx + prof.exec + prof.rx + prof.poproc;
+        expand_samples[i] = prof.expand;
+        ld_cycles += prof.ld_cycles;
+        run_cycles += prof.run_cycles;
+        st_cycles += prof.st_cycles;
 
         map_dtor(&map);
         path_dtor(&path);
@@ -643,6 +509,7 @@ int profile(unsigned int seed, int hw, int samples)
     data_point rx;
     data_point poproc;
     data_point total;
+    data_point expand;
 
     calc_stats(&prproc, prproc_samples, samples);
     calc_stats(&tx, tx_samples, samples);
@@ -650,6 +517,7 @@ int profile(unsigned int seed, int hw, int samples)
     calc_stats(&rx, rx_samples, samples);
     calc_stats(&poproc, poproc_samples, samples);
     calc_stats(&total, total_samples, samples);
+    calc_stats(&expand, expand_samples, samples);
 
     printf("Samples taken: %d\n", samples);
     printf("Pre-processing:\n");
@@ -664,145 +532,1706 @@ int profile(unsigned int seed, int hw, int samples)
     print_stats(&poproc);
     printf("Total:\n");
     print_stats(&total);
+    // same seed across engines gives the same maps, so these compare directly
+    printf("Nodes expanded:\n");
+    printf("    Min: %llu\n", (unsigned long long) expand.min);
+    printf("    Max: %llu\n", (unsigned long long) expand.max);
+    printf("    Avg: %0.2f\n", expand.avg);
 
     prof prof;
+    prof_ctor(&prof);
     prof.prproc = (uint64_t) prproc.avg;
     prof.tx = (uint64_t) tx.avg;
     prof.exec = (uint64_t) exec.avg;
     prof.rx = (uint64_t) rx.avg;
     prof.poproc = (uint64_t) poproc.avg;
+    prof.expand = (uint64_t) expand.avg;
+    prof.ld_cycles = ld_cycles / samples;
+    prof.run_cycles = run_cycles / samples;
+    prof.st_cycles = st_cycles / samples;
     printf("\nAverage:\n");
     prof_print(&prof);
 
 
-    if (hw) {
-        mem_dtor(&mem_bram);
-        mem_dtor(&mem_dkstr);
-    }
+    backend_dtor(&backend);
     free(prproc_samples);
     free(tx_samples);
     free(exec_samples);
     free(rx_samples);
     free(poproc_samples);
     free(total_samples);
+    free(expand_samples);
     return 0;
 }
 
-int main(int argc, char * argv[])
+// thread scaling of the tiled Bellman-Ford: the same size x size maps are
+// solved with 1, 2, 4, ... threads up to the number of CPUs
+int profile_threads(unsigned int seed, int samples, int size)
 {
-    #ifdef INTERRUPT
-    if (sig_init())
-        return 1;
-    #endif
+    int cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    uint64_t * exec_samples = (uint64_t *) malloc(sizeof(uint64_t) * samples);
+    uint64_t * expand_samples = (uint64_t *) malloc(sizeof(uint64_t) * samples);
+    double base = 0.0;
 
-    if (argc < 2) {
-        fprintf(stderr, "ERROR: please provide command\n");
-        return 1;
-    }
+    search search;
+    search_ctor(&search, size, size);
 
-    if (!strcmp("put_map", argv[1])) {
-        if (argc <= 2) {
-            fprintf(stderr, "ERROR: dkstr put_map <map path>\n");
-            return 1;
+    printf("Samples taken: %d\n", samples);
+    printf("Map size: %dx%d\n", size, size);
+    printf("CPUs: %d\n", cpus);
+    for (int threads = 1; ; threads <<= 1) {
+        if (threads > cpus)
+            threads = cpus;
+
+        map_seed(seed);
+        unsigned int coord_seed = ~seed;
+        for (int i = 0; i < samples; ++i) {
+            map map;
+            path path;
+            coord start, end;
+            prof prof;
+
+            map_rand(&map, size, size);
+            start.x = rand_r(&coord_seed) % size;
+            start.y = rand_r(&coord_seed) % size;
+            end.x = rand_r(&coord_seed) % size;
+            end.y = rand_r(&coord_seed) % size;
+
+            tpath_find(&search, &map, &start, &end, &path, &prof, threads);
+            exec_samples[i] = prof.exec;
+            expand_samples[i] = prof.expand;
+
+            map_dtor(&map);
+            path_dtor(&path);
         }
-        return put_map(argv[2]);
+
+        data_point exec;
+        data_point expand;
+        calc_stats(&exec, exec_samples, samples);
+        calc_stats(&expand, expand_samples, samples);
+        if (threads == 1)
+            base = exec.avg;
+
+        printf("Threads: %d\n", threads);
+        printf("Execution:\n");
+        print_stats(&exec);
+        printf("    Speedup: %0.2fx\n", base / exec.avg);
+        printf("    Cells relaxed (avg): %0.2f\n", expand.avg);
+
+        if (threads == cpus)
+            break;
     }
-    else if (!strcmp("dump_map", argv[1])) {
-        if (argc <= 2) {
-            fprintf(stderr, "ERROR: dkstr dump_map <map path>\n");
-            return 1;
-        }
-        return dump_map(argv[2]);
+
+    search_dtor(&search);
+    free(exec_samples);
+    free(expand_samples);
+    return 0;
+}
+
+// map size scaling of one engine: random maps of RAND_SIDE, then 64, 128,
+// ... up to max cells a side, or the largest the engine takes. the
+// workspace is sized up front at every step, so its allocation is not part
+// of any sample
+int profile_sweep(unsigned int seed, int samples, const backend_ops * ops, int max)
+{
+    backend backend;
+    if (backend_ctor(&backend, ops)) {
+        fprintf(stderr, "ERROR: unable to start engine %s\n", ops->name);
+        return 1;
     }
-    else if (!strcmp("put_path", argv[1])) {
-        if (argc <= 2) {
-            fprintf(stderr, "ERROR: dkstr put_path <path hexdump path>\n");
-            return 1;
+    if (ops->side > 0 && max > ops->side)
+        max = ops->side;
+
+    uint64_t * total_samples = (uint64_t *) malloc(sizeof(uint64_t) * samples);
+    uint64_t * exec_samples = (uint64_t *) malloc(sizeof(uint64_t) * samples);
+    uint64_t * expand_samples = (uint64_t *) malloc(sizeof(uint64_t) * samples);
+
+    printf("Samples taken: %d\n", samples);
+    for (int size = RAND_SIDE; size <= max; size = size < 64 ? 64 : size << 1) {
+        backend_reserve(&backend, size, size);
+        map_seed(seed);
+        unsigned int coord_seed = ~seed;
+        for (int i = 0; i < samples; ++i) {
+            map map;
+            path path;
+            coord start, end;
+            prof prof;
+
+            map_rand(&map, size, size);
+            start.x = rand_r(&coord_seed) % size;
+            start.y = rand_r(&coord_seed) % size;
+            end.x = rand_r(&coord_seed) % size;
+            end.y = rand_r(&coord_seed) % size;
+
+            backend_route(&backend, &map, &start, &end, &path, &prof);
+            total_samples[i] = prof.prproc + prof.tx + prof.exec + prof.rx + prof.poproc;
+            exec_samples[i] = prof.exec;
+            expand_samples[i] = prof.expand;
+
+            map_dtor(&map);
+            path_dtor(&path);
         }
-        return put_path(argv[2]);
+
+        data_point total;
+        data_point exec;
+        data_point expand;
+        calc_stats(&total, total_samples, samples);
+        calc_stats(&exec, exec_samples, samples);
+        calc_stats(&expand, expand_samples, samples);
+
+        printf("Map size: %dx%d\n", size, size);
+        printf("    Total (avg ns): %0.2f\n", total.avg);
+        printf("    Execution (avg ns): %0.2f\n", exec.avg);
+        printf("    Nodes expanded (avg): %0.2f\n", expand.avg);
+        if (expand.avg > 0.0)
+            printf("    Per node (ns): %0.2f\n", exec.avg / expand.avg);
     }
-    else if (!strcmp("print_path", argv[1])) {
-        if (argc <= 3) {
-            fprintf(stderr, "ERROR: dkstr print_path <bram for BRAM; path of hexdump> <width> <height>\n");
-            return 1;
+
+    backend_dtor(&backend);
+    free(total_samples);
+    free(exec_samples);
+    free(expand_samples);
+    return 0;
+}
+
+// cost of a path walked from start, over tile characters or the nibbles of
+// a packed map
+static
+cost_t path_cost(const map * map, const coord * start, const path * path)
+{
+    coord at = *start;
+    cost_t cost = 0;
+    for (int i = vector_size(&path->moves) - 1; i >= 0; --i) {
+        movement move;
+        vector_get(&path->moves, i, &move);
+        for (int j = 0; j < move.count; ++j) {
+            at.x += move.x_dir;
+            at.y += move.y_dir;
+            cost += (move.x_dir != 0 && move.y_dir != 0) ? 0x3 : 0x2;
+            if (map->packed)
+                cost += (cost_t) map_nibble(map, at.x + (idx_t) map->w * at.y) << 1;
+            else
+                cost += (cost_t) cost_table[(int) map_get(map, at.x, at.y)] << 1;
         }
-        int w, h;
-        sscanf(argv[3], "%d", &w);
-        sscanf(argv[4], "%d", &h);
-        if (!strcmp("bram", argv[2]))
-            return print_path(w,h);
-        else
-            return print_path_file(argv[2],w,h);
     }
-    else if (!strcmp("play", argv[1])) {
-        if (argc <= 6) {
-            fprintf(stderr, "ERROR: dkstr play <map_path> <start_x> <start_y> <end_x> <end_y> [sw,hw; default sw]\n");
-            return 1;
-        }
+    return cost;
+}
 
-        coord start, end;
-        sscanf(argv[3], "%d", &start.x);
-        sscanf(argv[4], "%d", &start.y);
-        sscanf(argv[5], "%d", &end.x);
-        sscanf(argv[6], "%d", &end.y);
+// one start, many ends: ends separate path_find calls against one
+// tree_find and ends extractions from the tree, on the same maps. every
+// other map is packed with costs over the whole 4-bit range, which the cost
+// table does not reach, and the tree's paths and Dial's are checked against
+// Dijkstra's on it
+int profile_tree(unsigned int seed, int samples, int ends)
+{
+    map_seed(seed);
+    unsigned int coord_seed = ~seed;
 
-        int hw = 0;
-        if (argc > 7 && !strcmp("hw",argv[7]))
-            hw = 1;
+    uint64_t * single_samples = (uint64_t *) malloc(sizeof(uint64_t) * samples);
+    uint64_t * tree_samples = (uint64_t *) malloc(sizeof(uint64_t) * samples);
+    uint64_t * extract_samples = (uint64_t *) malloc(sizeof(uint64_t) * samples);
+    coord * end = (coord *) malloc(sizeof(coord) * ends);
 
-        return play_map(argv[2], hw, &start, &end);
-    }
-    else if (!strcmp("playback", argv[1])) {
-        if (argc <= 5) {
-            fprintf(stderr, "ERROR: dkstr playback <map_path> <paths_path> <end_x> <end_y>\n");
-            return 1;
+    search search;
+    tree tree;
+    search_ctor(&search, RAND_SIDE, RAND_SIDE);
+    tree_ctor(&tree, RAND_SIDE, RAND_SIDE);
+    int mismatch = 0;
+
+    for (int i = 0; i < samples; ++i) {
+        map map;
+        path path;
+        coord start;
+        prof prof;
+        prof_ctor(&prof);
+
+        map_rand(&map, RAND_SIDE, RAND_SIDE);
+        if (i & 1) {
+            struct map_ tiles = map;
+            map_pack(&map, &tiles);
+            map_dtor(&tiles);
+            for (int y = 0; y < RAND_SIDE; ++y) {
+                for (int x = 0; x < RAND_SIDE; ++x) {
+                    if (map_nibble(&map, x + RAND_SIDE * y) != MAP_WALL)
+                        map_put_nibble(&map, x, y, rand_r(&coord_seed) % MAP_WALL);
+                }
+            }
+        }
+        start.x = rand_r(&coord_seed) % RAND_SIDE;
+        start.y = rand_r(&coord_seed) % RAND_SIDE;
+        for (int j = 0; j < ends; ++j) {
+            end[j].x = rand_r(&coord_seed) % RAND_SIDE;
+            end[j].y = rand_r(&coord_seed) % RAND_SIDE;
         }
 
-        coord end;
-        sscanf(argv[4], "%d", &end.x);
-        sscanf(argv[5], "%d", &end.y);
+        single_samples[i] = 0;
+        for (int j = 0; j < ends; ++j) {
+            path_find(&search, &map, &start, &end[j], &path, &prof);
+            single_samples[i] += prof.prproc + prof.exec + prof.poproc;
+            path_dtor(&path);
+        }
 
-        playback_map(argv[2], argv[3], &end);
+        tree_find(&tree, &map, &start, &prof);
+        tree_samples[i] = prof.prproc + prof.exec;
+
+        prof_start(&prof);
+        for (int j = 0; j < ends; ++j) {
+            tree_path(&tree, &end[j], &path);
+            path_dtor(&path);
+        }
+        prof_end(&prof);
+        extract_samples[i] = prof_dt(&prof);
+        tree_samples[i] += extract_samples[i];
+
+        if (i & 1) {
+            for (int j = 0; j < ends; ++j) {
+                struct path_ best, dial;
+                tree_path(&tree, &end[j], &path);
+                dpath_find(&search, &map, &start, &end[j], &best, &prof);
+                bpath_find(&search, &map, &start, &end[j], &dial, &prof);
+                cost_t cost = path_cost(&map, &start, &best);
+                mismatch += path_cost(&map, &start, &path) != cost;
+                mismatch += path_cost(&map, &start, &dial) != cost;
+                path_dtor(&path);
+                path_dtor(&best);
+                path_dtor(&dial);
+            }
+        }
+        map_dtor(&map);
     }
-    else if (!strcmp("rand", argv[1])) {
-        if (argc <= 6) {
-            fprintf(stderr, "ERROR: dkstr rand <seed> <start_x> <start_y> <end_x> <end_y> [sw,hw; default sw]\n");
-            return 1;
+
+    data_point single;
+    data_point batch;
+    data_point extract;
+    calc_stats(&single, single_samples, samples);
+    calc_stats(&batch, tree_samples, samples);
+    calc_stats(&extract, extract_samples, samples);
+
+    printf("Samples taken: %d\n", samples);
+    printf("Ends per start: %d\n", ends);
+    printf("Separate path_find calls:\n");
+    print_stats(&single);
+    printf("One tree_find plus extractions:\n");
+    print_stats(&batch);
+    printf("Extractions alone:\n");
+    print_stats(&extract);
+    printf("Speedup: %0.2fx\n", single.avg / batch.avg);
+    printf("Cost mismatches on packed maps: %d\n", mismatch);
+
+    search_dtor(&search);
+    tree_dtor(&tree);
+    free(single_samples);
+    free(tree_samples);
+    free(extract_samples);
+    free(end);
+    return mismatch != 0;
+}
+
+// repeated (map, start) pairs: queries pick one of a few maps and one of a
+// few starts on it, like units leaving spawn points, and go through the
+// path tree cache. the same queries are also run through path_find
+#define CACHE_MAPS 4
+#define CACHE_STARTS 16
+int profile_cache(unsigned int seed, int samples, size_t budget)
+{
+    map_seed(seed);
+    unsigned int coord_seed = ~seed;
+
+    map maps[CACHE_MAPS];
+    coord starts[CACHE_MAPS][CACHE_STARTS];
+    for (int i = 0; i < CACHE_MAPS; ++i) {
+        map_rand(&maps[i], RAND_SIDE, RAND_SIDE);
+        for (int j = 0; j < CACHE_STARTS; ++j) {
+            starts[i][j].x = rand_r(&coord_seed) % RAND_SIDE;
+            starts[i][j].y = rand_r(&coord_seed) % RAND_SIDE;
         }
+    }
 
-        coord start, end;
-        unsigned int seed;
+    uint64_t * cached_samples = (uint64_t *) malloc(sizeof(uint64_t) * samples);
+    uint64_t * single_samples = (uint64_t *) malloc(sizeof(uint64_t) * samples);
+    uint64_t hit = 0, miss = 0, evict = 0;
 
-        sscanf(argv[2], "%u", &seed);
-        sscanf(argv[3], "%d", &start.x);
-        sscanf(argv[4], "%d", &start.y);
-        sscanf(argv[5], "%d", &end.x);
-        sscanf(argv[6], "%d", &end.y);
+    tcache cache;
+    search search;
+    tcache_ctor(&cache, budget);
+    search_ctor(&search, RAND_SIDE, RAND_SIDE);
 
-        int hw = 0;
-        if (argc > 7 && !strcmp("hw",argv[7]))
-            hw = 1;
+    for (int i = 0; i < samples; ++i) {
+        path path;
+        prof prof;
+        int m = rand_r(&coord_seed) % CACHE_MAPS;
+        const coord * start = &starts[m][rand_r(&coord_seed) % CACHE_STARTS];
+        coord end;
+        end.x = rand_r(&coord_seed) % RAND_SIDE;
+        end.y = rand_r(&coord_seed) % RAND_SIDE;
+
+        cpath_find(&cache, &maps[m], start, &end, &path, &prof);
+        cached_samples[i] = prof.prproc + prof.exec + prof.poproc;
+        hit += prof.hit;
+        miss += prof.miss;
+        evict += prof.evict;
+        path_dtor(&path);
 
-        map_seed(seed);
-        return play_map(NULL, hw, &start, &end);
+        path_find(&search, &maps[m], start, &end, &path, &prof);
+        single_samples[i] = prof.prproc + prof.exec + prof.poproc;
+        path_dtor(&path);
     }
-    else if (!strcmp("profile", argv[1])) {
-        if (argc < 4) {
-            fprintf(stderr, "ERROR: dkstr profile <sw, hw> <samples> [seed]\n");
-            return 1;
-        }
 
-        unsigned int seed = time(NULL);
-        int hw = 0;
-        int samples;
+    data_point cached;
+    data_point single;
+    calc_stats(&cached, cached_samples, samples);
+    calc_stats(&single, single_samples, samples);
 
-        if (!strcmp(argv[2], "hw"))
-            hw = 1;
-        sscanf(argv[3], "%d", &samples);
-        if (argc >= 5)
-            sscanf(argv[4], "%u", &seed);
+    printf("Samples taken: %d\n", samples);
+    printf("Budget: %zu bytes, %zu trees held\n", budget, cache.count);
+    printf("Through the cache:\n");
+    print_stats(&cached);
+    printf("path_find alone:\n");
+    print_stats(&single);
+    printf("Cache hits      : %llu\n", (unsigned long long) hit);
+    printf("Cache misses    : %llu\n", (unsigned long long) miss);
+    printf("Cache evictions : %llu\n", (unsigned long long) evict);
+
+    tcache_dtor(&cache);
+    search_dtor(&search);
+    for (int i = 0; i < CACHE_MAPS; ++i)
+        map_dtor(&maps[i]);
+    free(cached_samples);
+    free(single_samples);
+    return 0;
+}
+
+// a map that keeps changing under one (start, end): every tick changes a
+// few random tiles and the path is repaired with replan_update, against a
+// tree_find from scratch on the same map. the costs must agree
+#define REPLAN_TICKS 16
+int profile_replan(unsigned int seed, int samples, int changes)
+{
+    static const char tiles[] = " .-#@|";
+
+    map_seed(seed);
+    unsigned int coord_seed = ~seed;
+
+    int ticks = samples * REPLAN_TICKS;
+    uint64_t * update_samples = (uint64_t *) malloc(sizeof(uint64_t) * ticks);
+    uint64_t * full_samples = (uint64_t *) malloc(sizeof(uint64_t) * ticks);
+    coord * changed = (coord *) malloc(sizeof(coord) * changes);
+    uint64_t update_expand = 0, full_expand = 0;
+    int mismatch = 0;
+
+    replan replan;
+    tree tree;
+    replan_ctor(&replan, RAND_SIDE, RAND_SIDE);
+    tree_ctor(&tree, RAND_SIDE, RAND_SIDE);
+
+    for (int i = 0; i < samples; ++i) {
+        map map;
+        path path;
+        coord start, end;
+        prof prof;
+
+        map_rand(&map, RAND_SIDE, RAND_SIDE);
+        start.x = rand_r(&coord_seed) % RAND_SIDE;
+        start.y = rand_r(&coord_seed) % RAND_SIDE;
+        end.x = rand_r(&coord_seed) % RAND_SIDE;
+        end.y = rand_r(&coord_seed) % RAND_SIDE;
+
+        replan_find(&replan, &map, &start, &end, &path, &prof);
+        path_dtor(&path);
+
+        for (int j = 0; j < REPLAN_TICKS; ++j) {
+            int t = i * REPLAN_TICKS + j;
+            for (int k = 0; k < changes; ++k) {
+                changed[k].x = rand_r(&coord_seed) % RAND_SIDE;
+                changed[k].y = rand_r(&coord_seed) % RAND_SIDE;
+                map_put(&map, changed[k].x, changed[k].y,
+                        tiles[rand_r(&coord_seed) % (sizeof(tiles) - 1)]);
+            }
+
+            replan_update(&replan, changed, changes, &path, &prof);
+            update_samples[t] = prof.prproc + prof.exec + prof.poproc;
+            update_expand += prof.expand;
+            path_dtor(&path);
+
+            tree_find(&tree, &map, &start, &prof);
+            tree_path(&tree, &end, &path);
+            full_samples[t] = prof.prproc + prof.exec;
+            full_expand += prof.expand;
+            path_dtor(&path);
+
+            if (replan_cost(&replan) != tree_cost(&tree, &end))
+                mismatch += 1;
+        }
+
+        map_dtor(&map);
+    }
+
+    data_point update;
+    data_point full;
+    calc_stats(&update, update_samples, ticks);
+    calc_stats(&full, full_samples, ticks);
+
+    printf("Samples taken: %d maps, %d ticks each\n", samples, REPLAN_TICKS);
+    printf("Tiles changed per tick: %d\n", changes);
+    printf("replan_update:\n");
+    print_stats(&update);
+    printf("Nodes expanded: %0.1f per tick\n", (double) update_expand / ticks);
+    printf("Search from scratch:\n");
+    print_stats(&full);
+    printf("Nodes expanded: %0.1f per tick\n", (double) full_expand / ticks);
+    printf("Speedup: %0.2fx\n", full.avg / update.avg);
+    printf("Cost mismatches: %d\n", mismatch);
+
+    replan_dtor(&replan);
+    tree_dtor(&tree);
+    free(update_samples);
+    free(full_samples);
+    free(changed);
+    return mismatch != 0;
+}
+
+// samples independent queries over a few shared maps, solved as one batch
+// by pools of 1, 2, 4, ... threads up to the number of CPUs
+#define BATCH_MAPS 64
+#define BATCH_ROUNDS 5
+int profile_batch(unsigned int seed, int samples, const backend_ops * ops)
+{
+    int cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    path_fn find = ops->find;
+    double base = 0.0;
+
+    map_seed(seed);
+    unsigned int coord_seed = ~seed;
+    map maps[BATCH_MAPS];
+    for (int i = 0; i < BATCH_MAPS; ++i)
+        map_rand(&maps[i], RAND_SIDE, RAND_SIDE);
+
+    query * queries = (query *) malloc(sizeof(query) * samples);
+    path * paths = (path *) malloc(sizeof(path) * samples);
+    uint64_t * exec_samples = (uint64_t *) malloc(sizeof(uint64_t) * BATCH_ROUNDS);
+    for (int i = 0; i < samples; ++i) {
+        queries[i].map = &maps[rand_r(&coord_seed) % BATCH_MAPS];
+        queries[i].start.x = rand_r(&coord_seed) % RAND_SIDE;
+        queries[i].start.y = rand_r(&coord_seed) % RAND_SIDE;
+        queries[i].end.x = rand_r(&coord_seed) % RAND_SIDE;
+        queries[i].end.y = rand_r(&coord_seed) % RAND_SIDE;
+    }
+
+    printf("Queries per batch: %d\n", samples);
+    printf("Batches per pool: %d\n", BATCH_ROUNDS);
+    printf("CPUs: %d\n", cpus);
+    for (int threads = 1; ; threads <<= 1) {
+        if (threads > cpus)
+            threads = cpus;
+
+        batch batch;
+        prof prof;
+        batch_ctor(&batch, threads, find);
+        for (int i = 0; i < BATCH_ROUNDS; ++i) {
+            batch_solve(&batch, queries, samples, paths, &prof);
+            exec_samples[i] = prof.exec;
+            for (int j = 0; j < samples; ++j)
+                path_dtor(&paths[j]);
+        }
+        batch_dtor(&batch);
+
+        data_point exec;
+        calc_stats(&exec, exec_samples, BATCH_ROUNDS);
+        double qps = samples / (exec.avg / 1e9);
+        if (threads == 1)
+            base = qps;
+
+        printf("Threads: %d\n", threads);
+        printf("Batch time:\n");
+        print_stats(&exec);
+        printf("    Queries/s: %0.0f\n", qps);
+        printf("    Speedup: %0.2fx\n", qps / base);
+
+        if (threads == cpus)
+            break;
+    }
+
+    for (int i = 0; i < BATCH_MAPS; ++i)
+        map_dtor(&maps[i]);
+    free(queries);
+    free(paths);
+    free(exec_samples);
+    return 0;
+}
+
+// writes the text format map_load reads
+static
+int save_text_map(const map * map, const char * file_name)
+{
+    FILE * file = fopen(file_name, "w");
+    if (file == NULL)
+        return 1;
+    fprintf(file, "%d %d\n", map->h, map->w);
+    for (int r = 0; r < map->h; ++r) {
+        fwrite(map->buffer + (size_t) map->w * r, 1, map->w, file);
+        fputc('\n', file);
+    }
+    return fclose(file) != 0;
+}
+
+// reads every tile once, so a lazily mapped map pays for its page faults
+static
+uint64_t touch_map(const map * map)
+{
+    const uint8_t * bytes = map->packed ? (const uint8_t *) map->packed
+                                        : (const uint8_t *) map->buffer;
+    size_t n = map->packed ? sizeof(uint32_t) * map_words(map->w, map->h)
+                           : (size_t) map->w * map->h;
+    uint64_t sum = 0;
+    for (size_t i = 0; i < n; ++i)
+        sum += bytes[i];
+    return sum;
+}
+
+// a size x size map loaded from the text format, against the same map
+// opened as a binary file without and with its checksum checked. each is
+// timed to the loaded map and again after reading every tile once
+int profile_load(unsigned int seed, int samples, int size)
+{
+    enum { TEXT, BINARY, VERIFIED, LOADERS };
+    static const char * names[LOADERS] = {
+        "map_load, text",
+        "map_open",
+        "map_open, checksum verified",
+    };
+
+    char text_path[] = "/tmp/dkstr-map-XXXXXX";
+    char bin_path[] = "/tmp/dkstr-bmap-XXXXXX";
+    int text_fd = mkstemp(text_path);
+    int bin_fd = mkstemp(bin_path);
+    if (text_fd < 0 || bin_fd < 0) {
+        fprintf(stderr, "ERROR: cannot create temporary map files\n");
+        return 1;
+    }
+    close(text_fd);
+    close(bin_fd);
+
+    map map;
+    map_seed(seed);
+    map_rand(&map, size, size);
+    int err = save_text_map(&map, text_path) || map_save(&map, bin_path);
+    map_dtor(&map);
+    if (err) {
+        fprintf(stderr, "ERROR: cannot write temporary map files\n");
+        unlink(text_path);
+        unlink(bin_path);
+        return 1;
+    }
+
+    uint64_t * open_samples[LOADERS];
+    uint64_t * touch_samples[LOADERS];
+    for (int k = 0; k < LOADERS; ++k) {
+        open_samples[k] = (uint64_t *) malloc(sizeof(uint64_t) * samples);
+        touch_samples[k] = (uint64_t *) malloc(sizeof(uint64_t) * samples);
+    }
+
+    uint64_t sum = 0;
+    for (int i = 0; i < samples; ++i) {
+        for (int k = 0; k < LOADERS; ++k) {
+            prof prof;
+            prof_start(&prof);
+            if (k == TEXT)
+                err = map_load(&map, text_path);
+            else
+                err = map_open(&map, bin_path, k == VERIFIED);
+            prof_end(&prof);
+            if (err) {
+                fprintf(stderr, "ERROR: cannot load temporary map files\n");
+                break;
+            }
+            open_samples[k][i] = prof_dt(&prof);
+
+            sum += touch_map(&map);
+            prof_end(&prof);
+            touch_samples[k][i] = prof_dt(&prof);
+            map_dtor(&map);
+        }
+        if (err)
+            break;
+    }
+
+    if (!err) {
+        printf("Samples taken: %d\n", samples);
+        printf("Map size: %dx%d\n", size, size);
+        for (int k = 0; k < LOADERS; ++k) {
+            data_point open;
+            data_point touch;
+            calc_stats(&open, open_samples[k], samples);
+            calc_stats(&touch, touch_samples[k], samples);
+            printf("%s:\n", names[k]);
+            print_stats(&open);
+            printf("%s, then every tile read:\n", names[k]);
+            print_stats(&touch);
+        }
+        // keeps the reads from being optimized out
+        printf("Tile checksum: %llu\n", (unsigned long long) sum);
+    }
+
+    unlink(text_path);
+    unlink(bin_path);
+    for (int k = 0; k < LOADERS; ++k) {
+        free(open_samples[k]);
+        free(touch_samples[k]);
+    }
+    return err;
+}
+
+static
+bool path_equal(const path * a, const path * b)
+{
+    if (vector_size(&a->moves) != vector_size(&b->moves))
+        return false;
+    for (size_t i = 0; i < vector_size(&a->moves); ++i) {
+        movement ma, mb;
+        vector_get(&a->moves, i, &ma);
+        vector_get(&b->moves, i, &mb);
+        if (ma.count != mb.count || ma.x_dir != mb.x_dir || ma.y_dir != mb.y_dir)
+            return false;
+    }
+    return true;
+}
+
+// A* over a size x size map held packed in memory, against the same map
+// read from a tiled map file through a cache of budget bytes
+int profile_tiled(unsigned int seed, int samples, int size, size_t budget)
+{
+    char tiled_path[] = "/tmp/dkstr-tiles-XXXXXX";
+    int fd = mkstemp(tiled_path);
+    if (fd < 0) {
+        fprintf(stderr, "ERROR: cannot create a temporary map file\n");
+        return 1;
+    }
+    close(fd);
+
+    map_seed(seed);
+    unsigned int coord_seed = ~seed;
+    map tiles, packed, tiled;
+    map_rand(&tiles, size, size);
+    map_pack(&packed, &tiles);
+    int err = map_save_tiled(&tiles, tiled_path, TILE_SIDE) ||
+              map_open_tiled(&tiled, tiled_path, budget);
+    map_dtor(&tiles);
+    if (err) {
+        fprintf(stderr, "ERROR: cannot write a temporary map file\n");
+        map_dtor(&packed);
+        unlink(tiled_path);
+        return 1;
+    }
+
+    uint64_t * memory_samples = (uint64_t *) malloc(sizeof(uint64_t) * samples);
+    uint64_t * tiled_samples = (uint64_t *) malloc(sizeof(uint64_t) * samples);
+    uint64_t * fault_samples = (uint64_t *) malloc(sizeof(uint64_t) * samples);
+    int mismatch = 0;
+
+    search search;
+    search_ctor(&search, size, size);
+
+    for (int i = 0; i < samples; ++i) {
+        path a, b;
+        coord start, end;
+        prof prof;
+
+        start.x = rand_r(&coord_seed) % size;
+        start.y = rand_r(&coord_seed) % size;
+        end.x = rand_r(&coord_seed) % size;
+        end.y = rand_r(&coord_seed) % size;
+
+        apath_find(&search, &packed, &start, &end, &a, &prof);
+        memory_samples[i] = prof.prproc + prof.exec + prof.poproc;
+
+        uint64_t faults = tiled.tiles->faults;
+        apath_find(&search, &tiled, &start, &end, &b, &prof);
+        tiled_samples[i] = prof.prproc + prof.exec + prof.poproc;
+        fault_samples[i] = tiled.tiles->faults - faults;
+
+        mismatch += !path_equal(&a, &b);
+        path_dtor(&a);
+        path_dtor(&b);
+    }
+
+    data_point memory;
+    data_point paged;
+    data_point faults;
+    calc_stats(&memory, memory_samples, samples);
+    calc_stats(&paged, tiled_samples, samples);
+    calc_stats(&faults, fault_samples, samples);
+
+    size_t tile_bytes = sizeof(uint32_t) * tiled.tiles->words;
+    printf("Samples taken: %d\n", samples);
+    printf("Map size: %dx%d, %zu bytes packed\n", size, size,
+           sizeof(uint32_t) * map_words(size, size));
+    printf("Tile cache: %d tiles of %zu bytes\n", tiled.tiles->slots, tile_bytes);
+    printf("A* on the packed map in memory:\n");
+    print_stats(&memory);
+    printf("A* on the tiled map:\n");
+    print_stats(&paged);
+    printf("Tiles read per query:\n");
+    printf("    Min: %llu\n", (unsigned long long) faults.min);
+    printf("    Max: %llu\n", (unsigned long long) faults.max);
+    printf("    Avg: %0.2f\n", faults.avg);
+    printf("Path mismatches: %d\n", mismatch);
+    if (tiled.tiles->error)
+        printf("Tile reads failed\n");
+
+    search_dtor(&search);
+    map_dtor(&packed);
+    map_dtor(&tiled);
+    unlink(tiled_path);
+    free(memory_samples);
+    free(tiled_samples);
+    free(fault_samples);
+    return mismatch != 0;
+}
+
+// maps the ALT profile spreads its queries over
+#define ALT_MAPS 4
+
+// A* against ALT on the same queries over a few size x size maps, with
+// landmarks landmarks per map. the tables are built once per map, and one
+// set is saved and read back to time what alt_map saves
+int profile_alt(unsigned int seed, int samples, int landmarks, int size)
+{
+    char alt_path[] = "/tmp/dkstr-alt-XXXXXX";
+    int fd = mkstemp(alt_path);
+    if (fd < 0) {
+        fprintf(stderr, "ERROR: cannot create a temporary landmark file\n");
+        return 1;
+    }
+    close(fd);
+
+    map_seed(seed);
+    unsigned int coord_seed = ~seed;
+
+    search search;
+    search_ctor(&search, size, size);
+
+    map maps[ALT_MAPS];
+    alt alts[ALT_MAPS];
+    uint64_t build_samples[ALT_MAPS];
+    for (int i = 0; i < ALT_MAPS; ++i) {
+        prof prof;
+        map_rand(&maps[i], size, size);
+        alt_ctor(&alts[i], landmarks);
+        prof_start(&prof);
+        alt_build(&alts[i], &search, &maps[i]);
+        prof_end(&prof);
+        build_samples[i] = prof_dt(&prof);
+    }
+
+    prof load;
+    alt loaded;
+    alt_ctor(&loaded, landmarks);
+    int err = alt_save(&alts[0], alt_path);
+    prof_start(&load);
+    err = err || alt_load(&loaded, alt_path, &maps[0]);
+    prof_end(&load);
+    alt_dtor(&loaded);
+    unlink(alt_path);
+    if (err) {
+        fprintf(stderr, "ERROR: cannot save and load the landmark tables\n");
+        return 1;
+    }
+
+    uint64_t * astar_samples = (uint64_t *) malloc(sizeof(uint64_t) * samples);
+    uint64_t * alt_samples = (uint64_t *) malloc(sizeof(uint64_t) * samples);
+    uint64_t * astar_expand = (uint64_t *) malloc(sizeof(uint64_t) * samples);
+    uint64_t * alt_expand = (uint64_t *) malloc(sizeof(uint64_t) * samples);
+    int mismatch = 0;
+
+    for (int i = 0; i < samples; ++i) {
+        const map * map = &maps[i % ALT_MAPS];
+        path a, b;
+        coord start, end;
+        prof prof;
+
+        start.x = rand_r(&coord_seed) % size;
+        start.y = rand_r(&coord_seed) % size;
+        end.x = rand_r(&coord_seed) % size;
+        end.y = rand_r(&coord_seed) % size;
+
+        apath_find(&search, map, &start, &end, &a, &prof);
+        astar_samples[i] = prof.prproc + prof.exec + prof.poproc;
+        astar_expand[i] = prof.expand;
+
+        altpath_find(&alts[i % ALT_MAPS], &search, map, &start, &end, &b, &prof);
+        alt_samples[i] = prof.prproc + prof.exec + prof.poproc;
+        alt_expand[i] = prof.expand;
+
+        mismatch += path_cost(map, &start, &a) != path_cost(map, &start, &b);
+        path_dtor(&a);
+        path_dtor(&b);
+    }
+
+    data_point build;
+    data_point astar;
+    data_point with_alt;
+    data_point astar_nodes;
+    data_point alt_nodes;
+    calc_stats(&build, build_samples, ALT_MAPS);
+    calc_stats(&astar, astar_samples, samples);
+    calc_stats(&with_alt, alt_samples, samples);
+    calc_stats(&astar_nodes, astar_expand, samples);
+    calc_stats(&alt_nodes, alt_expand, samples);
+
+    size_t table_bytes = 2 * sizeof(uint32_t) * size * size * (size_t) alts[0].count;
+    printf("Samples taken: %d\n", samples);
+    printf("Map size: %dx%d, %d maps\n", size, size, ALT_MAPS);
+    printf("Landmarks: %d, %zu bytes of tables per map\n", alts[0].count, table_bytes);
+    printf("Building the tables:\n");
+    print_stats(&build);
+    printf("Reading saved tables (ns): %llu\n", (unsigned long long) prof_dt(&load));
+    printf("A*:\n");
+    print_stats(&astar);
+    printf("    Nodes expanded (avg): %0.2f\n", astar_nodes.avg);
+    printf("ALT:\n");
+    print_stats(&with_alt);
+    printf("    Nodes expanded (avg): %0.2f\n", alt_nodes.avg);
+    printf("Expansions: %0.2f%% of A*\n", 100.0 * alt_nodes.avg / astar_nodes.avg);
+    printf("Speedup: %0.2fx\n", astar.avg / with_alt.avg);
+    printf("Cost mismatches: %d\n", mismatch);
+
+    for (int i = 0; i < ALT_MAPS; ++i) {
+        map_dtor(&maps[i]);
+        alt_dtor(&alts[i]);
+    }
+    search_dtor(&search);
+    free(astar_samples);
+    free(alt_samples);
+    free(astar_expand);
+    free(alt_expand);
+    return mismatch != 0;
+}
+
+// maps the CH profile spreads its queries over; fewer than ALT_MAPS, as
+// contracting one takes far longer than placing landmarks
+#define CH_MAPS 2
+
+// Dijkstra, A* and the contraction hierarchy on the same queries over a few
+// size x size maps. the hierarchy is built once per map, and one is saved
+// and read back to time what ch_map saves
+int profile_ch(unsigned int seed, int samples, int size)
+{
+    char ch_path[] = "/tmp/dkstr-ch-XXXXXX";
+    int fd = mkstemp(ch_path);
+    if (fd < 0) {
+        fprintf(stderr, "ERROR: cannot create a temporary hierarchy file\n");
+        return 1;
+    }
+    close(fd);
+
+    map_seed(seed);
+    unsigned int coord_seed = ~seed;
+
+    search search;
+    search_ctor(&search, size, size);
+
+    map maps[CH_MAPS];
+    ch chs[CH_MAPS];
+    uint64_t build_samples[CH_MAPS];
+    for (int i = 0; i < CH_MAPS; ++i) {
+        prof prof;
+        map_rand(&maps[i], size, size);
+        ch_ctor(&chs[i]);
+        prof_start(&prof);
+        ch_build(&chs[i], &search, &maps[i]);
+        prof_end(&prof);
+        build_samples[i] = prof_dt(&prof);
+    }
+
+    prof load;
+    ch loaded;
+    ch_ctor(&loaded);
+    int err = ch_save(&chs[0], ch_path);
+    prof_start(&load);
+    err = err || ch_load(&loaded, ch_path, &maps[0]);
+    prof_end(&load);
+    ch_dtor(&loaded);
+    unlink(ch_path);
+    if (err) {
+        fprintf(stderr, "ERROR: cannot save and load the hierarchy\n");
+        return 1;
+    }
+
+    uint64_t * dj_samples = (uint64_t *) malloc(sizeof(uint64_t) * samples);
+    uint64_t * astar_samples = (uint64_t *) malloc(sizeof(uint64_t) * samples);
+    uint64_t * ch_samples = (uint64_t *) malloc(sizeof(uint64_t) * samples);
+    uint64_t * astar_expand = (uint64_t *) malloc(sizeof(uint64_t) * samples);
+    uint64_t * ch_expand = (uint64_t *) malloc(sizeof(uint64_t) * samples);
+    int mismatch = 0;
+
+    for (int i = 0; i < samples; ++i) {
+        const map * map = &maps[i % CH_MAPS];
+        path a, b, c;
+        coord start, end;
+        prof prof;
+
+        start.x = rand_r(&coord_seed) % size;
+        start.y = rand_r(&coord_seed) % size;
+        end.x = rand_r(&coord_seed) % size;
+        end.y = rand_r(&coord_seed) % size;
+
+        dpath_find(&search, map, &start, &end, &a, &prof);
+        dj_samples[i] = prof.prproc + prof.exec + prof.poproc;
+
+        apath_find(&search, map, &start, &end, &b, &prof);
+        astar_samples[i] = prof.prproc + prof.exec + prof.poproc;
+        astar_expand[i] = prof.expand;
+
+        chpath_find(&chs[i % CH_MAPS], &search, map, &start, &end, &c, &prof);
+        ch_samples[i] = prof.prproc + prof.exec + prof.poproc;
+        ch_expand[i] = prof.expand;
+
+        mismatch += path_cost(map, &start, &a) != path_cost(map, &start, &c);
+        path_dtor(&a);
+        path_dtor(&b);
+        path_dtor(&c);
+    }
+
+    data_point build;
+    data_point dj;
+    data_point astar;
+    data_point with_ch;
+    data_point astar_nodes;
+    data_point ch_nodes;
+    calc_stats(&build, build_samples, CH_MAPS);
+    calc_stats(&dj, dj_samples, samples);
+    calc_stats(&astar, astar_samples, samples);
+    calc_stats(&with_ch, ch_samples, samples);
+    calc_stats(&astar_nodes, astar_expand, samples);
+    calc_stats(&ch_nodes, ch_expand, samples);
+
+    idx_t cells = (idx_t) size * size;
+    idx_t arcs = chs[0].up_first[cells] + chs[0].down_first[cells];
+    printf("Samples taken: %d\n", samples);
+    printf("Map size: %dx%d, %d maps\n", size, size, CH_MAPS);
+    printf("Arcs: %lld, %lld of them shortcuts, %zu bytes per map\n",
+           (long long) arcs, (long long) chs[0].shortcuts,
+           sizeof(ch_arc) * arcs + 2 * sizeof(idx_t) * (cells + 1));
+    printf("Contracting the map:\n");
+    print_stats(&build);
+    printf("Reading a saved hierarchy (ns): %llu\n",
+           (unsigned long long) prof_dt(&load));
+    printf("Dijkstra:\n");
+    print_stats(&dj);
+    printf("A*:\n");
+    print_stats(&astar);
+    printf("    Nodes expanded (avg): %0.2f\n", astar_nodes.avg);
+    printf("CH:\n");
+    print_stats(&with_ch);
+    printf("    Nodes expanded (avg): %0.2f\n", ch_nodes.avg);
+    printf("Speedup: %0.2fx over Dijkstra, %0.2fx over A*\n",
+           dj.avg / with_ch.avg, astar.avg / with_ch.avg);
+    printf("Cost mismatches: %d\n", mismatch);
+
+    for (int i = 0; i < CH_MAPS; ++i) {
+        map_dtor(&maps[i]);
+        ch_dtor(&chs[i]);
+    }
+    search_dtor(&search);
+    free(dj_samples);
+    free(astar_samples);
+    free(ch_samples);
+    free(astar_expand);
+    free(ch_expand);
+    return mismatch != 0;
+}
+
+// the emulated fabric against Dijkstra on the same queries over random maps
+// the size of the fabric, every other one smaller and walled off in it.
+// paths must cost the same, except where the cheapest one costs more than
+// the fabric's costs hold and it finds none
+int profile_fabric(unsigned int seed, int samples)
+{
+    map_seed(seed);
+    unsigned int coord_seed = ~seed;
+    int size = EMU_DIM;
+    cost_t limit = (1 << EMU_COST_SIZE) - 1;
+
+    backend backend;
+    if (backend_ctor(&backend, backend_find("emu"))) {
+        fprintf(stderr, "ERROR: unable to start engine emu\n");
+        return 1;
+    }
+    search search;
+    search_ctor(&search, size, size);
+
+    uint64_t * ld_samples = (uint64_t *) malloc(sizeof(uint64_t) * samples);
+    uint64_t * run_samples = (uint64_t *) malloc(sizeof(uint64_t) * samples);
+    uint64_t * st_samples = (uint64_t *) malloc(sizeof(uint64_t) * samples);
+    int mismatch = 0;
+    int overflow = 0;
+
+    for (int i = 0; i < samples; ++i) {
+        map map;
+        path a, b;
+        coord start, end;
+        prof prof;
+        prof_ctor(&prof);
+
+        int w = size;
+        int h = size;
+        if (i & 1) {
+            w = 2 + rand_r(&coord_seed) % (size - 2);
+            h = 2 + rand_r(&coord_seed) % (size - 2);
+        }
+        map_rand(&map, w, h);
+        start.x = rand_r(&coord_seed) % w;
+        start.y = rand_r(&coord_seed) % h;
+        end.x = rand_r(&coord_seed) % w;
+        end.y = rand_r(&coord_seed) % h;
+
+        backend_route(&backend, &map, &start, &end, &a, &prof);
+        ld_samples[i] = prof.ld_cycles;
+        run_samples[i] = prof.run_cycles;
+        st_samples[i] = prof.st_cycles;
+        dpath_find(&search, &map, &start, &end, &b, &prof);
+
+        cost_t fabric = path_cost(&map, &start, &a);
+        cost_t best = path_cost(&map, &start, &b);
+        if (fabric == 0 && best >= limit)
+            ++overflow;
+        else
+            mismatch += fabric != best;
+
+        map_dtor(&map);
+        path_dtor(&a);
+        path_dtor(&b);
+    }
+
+    data_point ld;
+    data_point run;
+    data_point st;
+    calc_stats(&ld, ld_samples, samples);
+    calc_stats(&run, run_samples, samples);
+    calc_stats(&st, st_samples, samples);
+
+    printf("Samples taken: %d\n", samples);
+    printf("Map size: %dx%d, every other map smaller, costs of %d bits\n",
+           size, size, EMU_COST_SIZE);
+    printf("Cycles loading (avg): %0.2f\n", ld.avg);
+    printf("Cycles running:\n");
+    printf("    Min: %llu\n", (unsigned long long) run.min);
+    printf("    Max: %llu\n", (unsigned long long) run.max);
+    printf("    Avg: %0.2f\n", run.avg);
+    printf("Cycles storing (avg): %0.2f\n", st.avg);
+    printf("Paths too costly for the fabric: %d\n", overflow);
+    printf("Cost mismatches: %d\n", mismatch);
+
+    backend_dtor(&backend);
+    search_dtor(&search);
+    free(ld_samples);
+    free(run_samples);
+    free(st_samples);
+    return mismatch != 0;
+}
+
+// the fabric clock the board times below are estimated at
+#define FABRIC_MHZ 100
+
+// a tiled accelerator engine against A* on the same queries over random
+// size x size maps. the host's part of a tiled route is timed as it runs;
+// on top of it the board would spend the fabric's cycles at FABRIC_MHZ,
+// where an emulated fabric spends the time emulating
+int profile_windows(unsigned int seed, int samples, int size, const backend_ops * ops)
+{
+    map_seed(seed);
+    unsigned int coord_seed = ~seed;
+
+    backend backend;
+    if (backend_ctor(&backend, ops)) {
+        fprintf(stderr, "ERROR: unable to start engine %s\n", ops->name);
+        return 1;
+    }
+    search search;
+    search_ctor(&search, size, size);
+
+    uint64_t * astar_samples = (uint64_t *) malloc(sizeof(uint64_t) * samples);
+    uint64_t * host_samples = (uint64_t *) malloc(sizeof(uint64_t) * samples);
+    uint64_t * board_samples = (uint64_t *) malloc(sizeof(uint64_t) * samples);
+    uint64_t * window_samples = (uint64_t *) malloc(sizeof(uint64_t) * samples);
+    uint64_t fallbacks = 0;
+    double ratio = 0.0;
+    int routed = 0;
+    int lost = 0;
+
+    for (int i = 0; i < samples; ++i) {
+        map map;
+        path a, b;
+        coord start, end;
+        prof prof;
+        prof_ctor(&prof);
+
+        map_rand(&map, size, size);
+        start.x = rand_r(&coord_seed) % size;
+        start.y = rand_r(&coord_seed) % size;
+        end.x = rand_r(&coord_seed) % size;
+        end.y = rand_r(&coord_seed) % size;
+
+        backend_route(&backend, &map, &start, &end, &a, &prof);
+        uint64_t cycles = prof.ld_cycles + prof.run_cycles + prof.st_cycles;
+        host_samples[i] = prof.prproc + prof.tx + prof.rx + prof.poproc;
+        board_samples[i] = host_samples[i] + cycles * 1000 / FABRIC_MHZ;
+        window_samples[i] = prof.windows;
+        fallbacks += prof.fallbacks;
+
+        apath_find(&search, &map, &start, &end, &b, &prof);
+        astar_samples[i] = prof.prproc + prof.exec + prof.poproc;
+
+        cost_t best = path_cost(&map, &start, &b);
+        if (best > 0) {
+            cost_t tiled = path_cost(&map, &start, &a);
+            if (tiled == 0)
+                ++lost;
+            else {
+                ratio += (double) tiled / best;
+                ++routed;
+            }
+        }
+
+        map_dtor(&map);
+        path_dtor(&a);
+        path_dtor(&b);
+    }
+
+    data_point astar;
+    data_point host;
+    data_point board;
+    data_point windows;
+    calc_stats(&astar, astar_samples, samples);
+    calc_stats(&host, host_samples, samples);
+    calc_stats(&board, board_samples, samples);
+    calc_stats(&windows, window_samples, samples);
+
+    printf("Samples taken: %d\n", samples);
+    printf("Map size: %dx%d\n", size, size);
+    printf("A*:\n");
+    print_stats(&astar);
+    printf("%s, host only:\n", ops->name);
+    print_stats(&host);
+    printf("%s, with the fabric at %d MHz:\n", ops->name, FABRIC_MHZ);
+    print_stats(&board);
+    printf("Fabric windows per route (avg): %0.2f\n", windows.avg);
+    printf("Software fallbacks: %llu\n", (unsigned long long) fallbacks);
+    printf("Cost over the shortest (avg): %0.4fx\n", routed ? ratio / routed : 0.0);
+    printf("Routes lost: %d\n", lost);
+
+    backend_dtor(&backend);
+    search_dtor(&search);
+    free(astar_samples);
+    free(host_samples);
+    free(board_samples);
+    free(window_samples);
+    return lost != 0;
+}
+
+// the same batch of queries through the accelerator one at a time, with
+// hw_submit, hw_wait and hw_fetch, and pipelined through hwpipe_solve. the
+// emulated fabric runs on a thread of its own, so that the host's work can
+// overlap it as it would overlap the board's. every other map is smaller
+// than the fabric, and the paths found one at a time are checked against
+// Dijkstra's as profile_fabric does
+int profile_pipe(unsigned int seed, int samples, bool emulated)
+{
+    hw hw;
+    emu * emu = NULL;
+    if (emulated) {
+        emu = (struct emu_ *) malloc(sizeof(struct emu_));
+        emu_ctor(emu, EMU_DIM, EMU_COST_SIZE);
+        emu_spawn(emu);
+        emu_driver(emu, &hw);
+    }
+    else if (hw_ctor(&hw)) {
+        fprintf(stderr, "ERROR: unable to start engine hw\n");
+        return 1;
+    }
+
+    map_seed(seed);
+    unsigned int coord_seed = ~seed;
+    map maps[BATCH_MAPS];
+    for (int i = 0; i < BATCH_MAPS; ++i) {
+        int w = hw.side;
+        int h = hw.side;
+        if (i & 1) {
+            w = 2 + rand_r(&coord_seed) % (hw.side - 2);
+            h = 2 + rand_r(&coord_seed) % (hw.side - 2);
+        }
+        map_rand(&maps[i], w, h);
+    }
+
+    query * queries = (query *) malloc(sizeof(query) * samples);
+    path * serial = (path *) malloc(sizeof(path) * samples);
+    path * piped = (path *) malloc(sizeof(path) * samples);
+    uint64_t * serial_samples = (uint64_t *) malloc(sizeof(uint64_t) * BATCH_ROUNDS);
+    uint64_t * pipe_samples = (uint64_t *) malloc(sizeof(uint64_t) * BATCH_ROUNDS);
+    for (int i = 0; i < samples; ++i) {
+        const map * m = &maps[rand_r(&coord_seed) % BATCH_MAPS];
+        queries[i].map = m;
+        queries[i].start.x = rand_r(&coord_seed) % m->w;
+        queries[i].start.y = rand_r(&coord_seed) % m->h;
+        queries[i].end.x = rand_r(&coord_seed) % m->w;
+        queries[i].end.y = rand_r(&coord_seed) % m->h;
+    }
+    search search;
+    search_ctor(&search, hw.side, hw.side);
+    cost_t limit = (1 << EMU_COST_SIZE) - 1;
+    int wrong = 0;
+
+    hwpipe pipe;
+    hwpipe_ctor(&pipe, &hw);
+    uint64_t host = 0;
+    uint64_t overlap = 0;
+    int mismatch = 0;
+    for (int r = 0; r < BATCH_ROUNDS; ++r) {
+        prof wall;
+        prof prof;
+        prof_ctor(&prof);
+        prof_start(&wall);
+        for (int i = 0; i < samples; ++i) {
+            const query * q = &queries[i];
+            hw_submit(&hw, q->map, &q->start, &q->end, &prof);
+            hw_wait(&hw, &prof);
+            hw_fetch(&hw, &serial[i], &prof);
+        }
+        prof_end(&wall);
+        serial_samples[r] = prof_dt(&wall);
+
+        prof_start(&wall);
+        hwpipe_solve(&pipe, queries, samples, piped, &prof);
+        prof_end(&wall);
+        pipe_samples[r] = prof_dt(&wall);
+        host += prof.prproc + prof.poproc;
+        overlap += prof.overlap;
+
+        for (int i = 0; i < samples; ++i) {
+            const query * q = &queries[i];
+            mismatch += !path_equal(&serial[i], &piped[i]);
+            if (r == 0) {
+                path best;
+                struct prof_ check;
+                dpath_find(&search, q->map, &q->start, &q->end, &best, &check);
+                cost_t fabric = path_cost(q->map, &q->start, &serial[i]);
+                cost_t cheapest = path_cost(q->map, &q->start, &best);
+                wrong += fabric != cheapest && !(fabric == 0 && cheapest >= limit);
+                path_dtor(&best);
+            }
+            path_dtor(&serial[i]);
+            path_dtor(&piped[i]);
+        }
+    }
+
+    data_point one;
+    data_point piped_time;
+    calc_stats(&one, serial_samples, BATCH_ROUNDS);
+    calc_stats(&piped_time, pipe_samples, BATCH_ROUNDS);
+    double base = samples / (one.avg / 1e9);
+    double qps = samples / (piped_time.avg / 1e9);
+
+    printf("Queries per batch: %d\n", samples);
+    printf("Batches: %d\n", BATCH_ROUNDS);
+    printf("Fabric: %s\n", emulated ? "emulated, on its own thread" : "board");
+    printf("One at a time:\n");
+    print_stats(&one);
+    printf("    Queries/s: %0.0f\n", base);
+    printf("Pipelined:\n");
+    print_stats(&piped_time);
+    printf("    Queries/s: %0.0f\n", qps);
+    printf("    Speedup: %0.2fx\n", qps / base);
+    printf("    Packing and decoding overlapped: %0.2f%%\n",
+           host ? 100.0 * overlap / host : 0.0);
+    printf("Path mismatches: %d\n", mismatch);
+    printf("Cost mismatches against Dijkstra: %d\n", wrong);
+
+    search_dtor(&search);
+    hwpipe_dtor(&pipe);
+    hw_dtor(&hw);
+    if (emu != NULL) {
+        emu_dtor(emu);
+        free(emu);
+    }
+    for (int i = 0; i < BATCH_MAPS; ++i)
+        map_dtor(&maps[i]);
+    free(queries);
+    free(serial);
+    free(piped);
+    free(serial_samples);
+    free(pipe_samples);
+    return mismatch != 0 || wrong != 0;
+}
+
+// the same queries through the accelerator with maps and directions going
+// through the host buffer, and packed and followed in BRAM, next to what
+// the driver measured before its first query and the ways it took from that
+int profile_io(unsigned int seed, int samples, bool emulated)
+{
+    hw hw;
+    emu * emu = NULL;
+    if (emulated) {
+        emu = (struct emu_ *) malloc(sizeof(struct emu_));
+        emu_ctor(emu, EMU_DIM, EMU_COST_SIZE);
+        emu_driver(emu, &hw);
+    }
+    else if (hw_ctor(&hw)) {
+        fprintf(stderr, "ERROR: unable to start engine hw\n");
+        return 1;
+    }
+    hw_prepare(&hw);
+    bool direct_tx = hw.direct_tx;
+    bool direct_rx = hw.direct_rx;
+
+    map_seed(seed);
+    unsigned int coord_seed = ~seed;
+    uint64_t * samples_of[2][2];
+    for (int d = 0; d < 2; ++d)
+        for (int way = 0; way < 2; ++way)
+            samples_of[d][way] = (uint64_t *) malloc(sizeof(uint64_t) * samples);
+    int mismatch = 0;
+
+    for (int i = 0; i < samples; ++i) {
+        map map;
+        path paths[2];
+        coord start, end;
+
+        map_rand(&map, RAND_SIDE, RAND_SIDE);
+        start.x = rand_r(&coord_seed) % RAND_SIDE;
+        start.y = rand_r(&coord_seed) % RAND_SIDE;
+        end.x = rand_r(&coord_seed) % RAND_SIDE;
+        end.y = rand_r(&coord_seed) % RAND_SIDE;
+
+        // through the host buffer, then straight to and from BRAM
+        for (int d = 0; d < 2; ++d) {
+            prof prof;
+            prof_ctor(&prof);
+            hw.direct_tx = d;
+            hw.direct_rx = d;
+            hw_submit(&hw, &map, &start, &end, &prof);
+            hw_wait(&hw, &prof);
+            uint64_t in = prof.prproc + prof.tx;
+            hw_fetch(&hw, &paths[d], &prof);
+            samples_of[d][0][i] = in;
+            samples_of[d][1][i] = prof.rx + prof.poproc;
+        }
+
+        mismatch += !path_equal(&paths[0], &paths[1]);
+        path_dtor(&paths[0]);
+        path_dtor(&paths[1]);
+        map_dtor(&map);
+    }
+
+    data_point stats[2][2];
+    for (int d = 0; d < 2; ++d)
+        for (int way = 0; way < 2; ++way)
+            calc_stats(&stats[d][way], samples_of[d][way], samples);
+
+    printf("Samples taken: %d\n", samples);
+    printf("Fabric: %s\n", emulated ? "emulated" : "board");
+    printf("Measured by the driver, whole %dx%d map (ns):\n", hw.side, hw.side);
+    printf("    Packing through the buffer: %llu\n", (unsigned long long) hw.io.bounce_tx);
+    printf("    Packing into BRAM: %llu\n", (unsigned long long) hw.io.direct_tx);
+    printf("    Following a copy: %llu\n", (unsigned long long) hw.io.bounce_rx);
+    printf("    Following in BRAM: %llu\n", (unsigned long long) hw.io.direct_rx);
+    printf("    Picked: %s in, %s out\n", direct_tx ? "BRAM" : "buffer",
+           direct_rx ? "BRAM" : "buffer");
+    printf("Map in through the buffer:\n");
+    print_stats(&stats[0][0]);
+    printf("Map in packed into BRAM:\n");
+    print_stats(&stats[1][0]);
+    printf("Path out through the buffer:\n");
+    print_stats(&stats[0][1]);
+    printf("Path out followed in BRAM:\n");
+    print_stats(&stats[1][1]);
+    printf("Path mismatches: %d\n", mismatch);
+
+    hw_dtor(&hw);
+    if (emu != NULL) {
+        emu_dtor(emu);
+        free(emu);
+    }
+    for (int d = 0; d < 2; ++d)
+        for (int way = 0; way < 2; ++way)
+            free(samples_of[d][way]);
+    return mismatch != 0;
+}
+
+int main(int argc, char * argv[])
+{
+    #ifdef INTERRUPT
+    if (sig_init())
+        return 1;
+    #endif
+
+    if (argc < 2) {
+        fprintf(stderr, "ERROR: please provide command\n");
+        return 1;
+    }
+
+    if (!strcmp("put_map", argv[1])) {
+        if (argc <= 2) {
+            fprintf(stderr, "ERROR: dkstr put_map <map path>\n");
+            return 1;
+        }
+        return put_map(argv[2]);
+    }
+    else if (!strcmp("dump_map", argv[1])) {
+        if (argc <= 2) {
+            fprintf(stderr, "ERROR: dkstr dump_map <map path>\n");
+            return 1;
+        }
+        return dump_map(argv[2]);
+    }
+    else if (!strcmp("bin_map", argv[1])) {
+        if (argc < 4) {
+            fprintf(stderr, "ERROR: dkstr bin_map <map path> <binary map path> [packed]\n");
+            return 1;
+        }
+        return bin_map(argv[2], argv[3], argc >= 5 && !strcmp("packed", argv[4]));
+    }
+    else if (!strcmp("tile_map", argv[1])) {
+        if (argc < 4) {
+            fprintf(stderr, "ERROR: dkstr tile_map <map path> <tiled map path> [tile side]\n");
+            return 1;
+        }
+        int side = TILE_SIDE;
+        if (argc >= 5)
+            sscanf(argv[4], "%d", &side);
+        return tile_map(argv[2], argv[3], side);
+    }
+    else if (!strcmp("alt_map", argv[1])) {
+        if (argc <= 2) {
+            fprintf(stderr, "ERROR: dkstr alt_map <map path> [landmarks]\n");
+            return 1;
+        }
+        int landmarks = ALT_LANDMARKS;
+        if (argc >= 4)
+            sscanf(argv[3], "%d", &landmarks);
+        return alt_map(argv[2], landmarks);
+    }
+    else if (!strcmp("ch_map", argv[1])) {
+        if (argc <= 2) {
+            fprintf(stderr, "ERROR: dkstr ch_map <map path>\n");
+            return 1;
+        }
+        return ch_map(argv[2]);
+    }
+    else if (!strcmp("put_path", argv[1])) {
+        if (argc <= 2) {
+            fprintf(stderr, "ERROR: dkstr put_path <path hexdump path>\n");
+            return 1;
+        }
+        return put_path(argv[2]);
+    }
+    else if (!strcmp("print_path", argv[1])) {
+        if (argc <= 3) {
+            fprintf(stderr, "ERROR: dkstr print_path <bram for BRAM; path of hexdump> <width> <height>\n");
+            return 1;
+        }
+        int w, h;
+        sscanf(argv[3], "%d", &w);
+        sscanf(argv[4], "%d", &h);
+        if (!strcmp("bram", argv[2]))
+            return print_path(w,h);
+        else
+            return print_path_file(argv[2],w,h);
+    }
+    else if (!strcmp("play", argv[1])) {
+        if (argc <= 6) {
+            fprintf(stderr, "ERROR: dkstr play <map_path> <start_x> <start_y> <end_x> <end_y> [%s; default sw]\n", engine_names(","));
+            return 1;
+        }
+
+        coord start, end;
+        sscanf(argv[3], "%d", &start.x);
+        sscanf(argv[4], "%d", &start.y);
+        sscanf(argv[5], "%d", &end.x);
+        sscanf(argv[6], "%d", &end.y);
+
+        const backend_ops * ops = backend_find(argc > 7 ? argv[7] : "sw");
+        if (ops == NULL) {
+            fprintf(stderr, "ERROR: invalid engine %s\n", argv[7]);
+            return 1;
+        }
+
+        return play_map(argv[2], ops, &start, &end);
+    }
+    else if (!strcmp("playback", argv[1])) {
+        if (argc <= 5) {
+            fprintf(stderr, "ERROR: dkstr playback <map_path> <paths_path> <end_x> <end_y>\n");
+            return 1;
+        }
+
+        coord end;
+        sscanf(argv[4], "%d", &end.x);
+        sscanf(argv[5], "%d", &end.y);
+
+        playback_map(argv[2], argv[3], &end);
+    }
+    else if (!strcmp("rand", argv[1])) {
+        if (argc <= 6) {
+            fprintf(stderr, "ERROR: dkstr rand <seed> <start_x> <start_y> <end_x> <end_y> [%s; default sw]\n", engine_names(","));
+            return 1;
+        }
+
+        coord start, end;
+        unsigned int seed;
+
+        sscanf(argv[2], "%u", &seed);
+        sscanf(argv[3], "%d", &start.x);
+        sscanf(argv[4], "%d", &start.y);
+        sscanf(argv[5], "%d", &end.x);
+        sscanf(argv[6], "%d", &end.y);
+
+        const backend_ops * ops = backend_find(argc > 7 ? argv[7] : "sw");
+        if (ops == NULL) {
+            fprintf(stderr, "ERROR: invalid engine %s\n", argv[7]);
+            return 1;
+        }
+
+        map_seed(seed);
+        return play_map(NULL, ops, &start, &end);
+    }
+    else if (!strcmp("profile", argv[1])) {
+        if (argc < 4) {
+            fprintf(stderr, "ERROR: dkstr profile <%s, tree, cache, replan, batch, load, tiled, sweep, fabric, windows, pipe, io, alt-vs-astar, ch-build, threads> <samples> [seed] [cold | packed | size | ends | budget KiB | changes | engine | landmarks] [budget KiB | max size | engine | size]\n", engine_names(", "));
+            return 1;
+        }
+
+        unsigned int seed = time(NULL);
+        int samples;
+        sscanf(argv[3], "%d", &samples);
+        if (argc >= 5)
+            sscanf(argv[4], "%u", &seed);
+
+        if (!strcmp("tree", argv[2])) {
+            int ends = 32;
+            if (argc >= 6)
+                sscanf(argv[5], "%d", &ends);
+            return profile_tree(seed, samples, ends);
+        }
+        if (!strcmp("cache", argv[2])) {
+            int budget = 1024;
+            if (argc >= 6)
+                sscanf(argv[5], "%d", &budget);
+            return profile_cache(seed, samples, (size_t) budget * 1024);
+        }
+        if (!strcmp("replan", argv[2])) {
+            int changes = 4;
+            if (argc >= 6)
+                sscanf(argv[5], "%d", &changes);
+            return profile_replan(seed, samples, changes);
+        }
+        if (!strcmp("load", argv[2])) {
+            int size = 2048;
+            if (argc >= 6)
+                sscanf(argv[5], "%d", &size);
+            return profile_load(seed, samples, size);
+        }
+        if (!strcmp("tiled", argv[2])) {
+            int size = 2048;
+            int budget = 256;
+            if (argc >= 6)
+                sscanf(argv[5], "%d", &size);
+            if (argc >= 7)
+                sscanf(argv[6], "%d", &budget);
+            return profile_tiled(seed, samples, size, (size_t) budget * 1024);
+        }
+        if (!strcmp("fabric", argv[2]))
+            return profile_fabric(seed, samples);
+        if (!strcmp("pipe", argv[2])) {
+            const char * engine = argc >= 6 ? argv[5] : "emu";
+            if (strcmp(engine, "hw") && strcmp(engine, "emu")) {
+                fprintf(stderr, "ERROR: invalid engine %s\n", engine);
+                return 1;
+            }
+            return profile_pipe(seed, samples, !strcmp(engine, "emu"));
+        }
+        if (!strcmp("io", argv[2])) {
+            const char * engine = argc >= 6 ? argv[5] : "emu";
+            if (strcmp(engine, "hw") && strcmp(engine, "emu")) {
+                fprintf(stderr, "ERROR: invalid engine %s\n", engine);
+                return 1;
+            }
+            return profile_io(seed, samples, !strcmp(engine, "emu"));
+        }
+        if (!strcmp("windows", argv[2])) {
+            int size = 256;
+            if (argc >= 6)
+                sscanf(argv[5], "%d", &size);
+            const backend_ops * ops = backend_find(argc >= 7 ? argv[6] : "emutile");
+            if (ops == NULL ||
+                (strcmp(ops->name, "hwtile") && strcmp(ops->name, "emutile"))) {
+                fprintf(stderr, "ERROR: invalid engine %s\n", argv[6]);
+                return 1;
+            }
+            return profile_windows(seed, samples, size, ops);
+        }
+        if (!strcmp("sweep", argv[2])) {
+            const backend_ops * ops = backend_find(argc >= 6 ? argv[5] : "dj");
+            int max = 16384;
+            if (ops == NULL) {
+                fprintf(stderr, "ERROR: invalid engine %s\n", argv[5]);
+                return 1;
+            }
+            if (argc >= 7)
+                sscanf(argv[6], "%d", &max);
+            return profile_sweep(seed, samples, ops, max);
+        }
+        if (!strcmp("batch", argv[2])) {
+            const backend_ops * ops = backend_find(argc >= 6 ? argv[5] : "dj");
+            if (ops == NULL) {
+                fprintf(stderr, "ERROR: invalid engine %s\n", argv[5]);
+                return 1;
+            }
+            if (ops->find == NULL) {
+                fprintf(stderr, "ERROR: engine %s cannot run in a batch\n", ops->name);
+                return 1;
+            }
+            return profile_batch(seed, samples, ops);
+        }
+        if (!strcmp("alt-vs-astar", argv[2])) {
+            int landmarks = ALT_LANDMARKS;
+            int size = 256;
+            if (argc >= 6)
+                sscanf(argv[5], "%d", &landmarks);
+            if (argc >= 7)
+                sscanf(argv[6], "%d", &size);
+            return profile_alt(seed, samples, landmarks, size);
+        }
+        if (!strcmp("ch-build", argv[2])) {
+            int size = 256;
+            if (argc >= 6)
+                sscanf(argv[5], "%d", &size);
+            return profile_ch(seed, samples, size);
+        }
+        if (!strcmp("threads", argv[2])) {
+            int size = 1024;
+            if (argc >= 6)
+                sscanf(argv[5], "%d", &size);
+            return profile_threads(seed, samples, size);
+        }
+
+        const backend_ops * ops = backend_find(argv[2]);
+        if (ops == NULL) {
+            fprintf(stderr, "ERROR: invalid engine %s\n", argv[2]);
+            return 1;
+        }
+        int size = RAND_SIDE;
+        int cold = 0;
+        int packed = 0;
+        for (int i = 5; i < argc; ++i) {
+            cold |= !strcmp(argv[i], "cold");
+            packed |= !strcmp(argv[i], "packed");
+            sscanf(argv[i], "%d", &size);
+        }
+        if (ops->side > 0 && size > ops->side) {
+            fprintf(stderr, "ERROR: %s only routes maps up to %dx%d\n", ops->name, ops->side, ops->side);
+            return 1;
+        }
 
-        return profile(seed, hw, samples);
+        return profile(seed, ops, samples, size, cold, packed);
 
     }
     else {
@@ -0,0 +1,247 @@
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#ifdef INTERRUPT
+#include <signal.h>
+#endif
+
+#include "map.h"
+#include "hw.h"
+#include "emu.h"
+
+// Fabric emulator
+//
+// Every node of the fabric (neu.v) holds a weight, a cost and a direction,
+// and on each clock looks at one of its eight neighbours, north first and
+// then clockwise. Entering the node from that neighbour costs the
+// neighbour's cost, twice the weight, and 2 for a straight move or 3 for a
+// diagonal one; if that is less than the node's cost, the node takes it and
+// points at the neighbour. All nodes leave reset together, so on a given
+// clock they all look the same way. Costs are cost_size bits wide: walls,
+// the border and nodes not reached yet read as all ones, and a sum that
+// carries out of cost_size bits is dropped, so on the fabric paths that
+// cost that much are never found.
+//
+// The start node is held at cost 0 while the fabric runs, and the fabric
+// (fabric.v) stops once no node has changed for 16 clocks. Both halves of
+// the emulated cycle read last clock's costs and write the next one's, as
+// the registers do.
+//
+// The map and the directions go through BRAM a word of 8 nibbles at a time,
+// with the nodes in row-major order dim to a row. Loading and storing take
+// 8 clocks per word to move the nibbles, overlapped with the transaction
+// of the next word; the counters model that with EMU_TXN_CYCLES rather
+// than clock the AXI master.
+//
+// Spawned, the fabric waits on its own thread to be rung and then runs as
+// above, while the host goes on with other work and polls the control
+// register as it does the board's.
+
+void emu_ctor(emu * emu, int dim, int cost_size)
+{
+    // costs, unreached included, are kept in 16 bits
+    assert(cost_size > 0 && cost_size <= 16);
+    int n = dim * dim;
+    emu->dim = dim;
+    emu->cost_size = cost_size;
+    memset(emu->bram, 0, sizeof(emu->bram));
+    for (int i = 0; i < EMU_REGS; ++i)
+        emu->regs[i] = 0;
+    emu->weight = (uint8_t *) calloc(n, sizeof(uint8_t));
+    emu->cost[0] = (uint16_t *) malloc(sizeof(uint16_t) * n);
+    emu->cost[1] = (uint16_t *) malloc(sizeof(uint16_t) * n);
+    emu->dir = (uint8_t *) calloc(n, sizeof(uint8_t));
+    emu->threaded = false;
+    emu->rung = false;
+    emu->stop = false;
+}
+
+void emu_dtor(emu * emu)
+{
+    if (emu->threaded) {
+        pthread_mutex_lock(&emu->lock);
+        emu->stop = true;
+        pthread_cond_signal(&emu->ring);
+        pthread_mutex_unlock(&emu->lock);
+        pthread_join(emu->thread, NULL);
+        pthread_mutex_destroy(&emu->lock);
+        pthread_cond_destroy(&emu->ring);
+    }
+    free(emu->weight);
+    free(emu->cost[0]);
+    free(emu->cost[1]);
+    free(emu->dir);
+}
+
+// clocks spent per word on top of moving its 8 nibbles, waiting for the
+// transaction started with them
+static inline
+uint32_t emu_txn_wait(void)
+{
+    return EMU_TXN_CYCLES > 8 ? EMU_TXN_CYCLES - 8 : 1;
+}
+
+// returns the cycles spent loading
+static
+uint32_t emu_load(emu * emu)
+{
+    int n = emu->dim * emu->dim;
+    uint32_t words = (n + 7) / 8;
+    for (int i = 0; i < n; ++i)
+        emu->weight[i] = (emu->bram[i >> 3] >> ((i & 7) * 4)) & 0xF;
+    return 1 + EMU_TXN_CYCLES + words * (8 + emu_txn_wait());
+}
+
+// returns the cycles spent running
+static
+uint32_t emu_relax(emu * emu, int x0, int y0)
+{
+    int dim = emu->dim;
+    int n = dim * dim;
+    uint16_t inf = (1 << emu->cost_size) - 1;
+    uint16_t * cost = emu->cost[0];
+    uint16_t * next = emu->cost[1];
+    // a start the fabric does not have is never cleared
+    int start = x0 < dim && y0 < dim ? x0 + y0 * dim : -1;
+
+    // reset, with the start node cleared
+    for (int i = 0; i < n; ++i) {
+        cost[i] = inf;
+        emu->dir[i] = 0;
+    }
+    if (start >= 0)
+        cost[start] = 0;
+
+    uint16_t history = 0xFFFF;
+    uint32_t cycles = 0;
+    for (int state = 0; ; state = (state + 1) & 7) {
+        ++cycles;
+        if (history == 0)
+            break;
+
+        int dx = hw_dirs[state][0];
+        int dy = hw_dirs[state][1];
+        uint32_t step = (dx != 0 && dy != 0) ? 0x3 : 0x2;
+        bool activity = false;
+        for (int y = 0; y < dim; ++y) {
+            for (int x = 0; x < dim; ++x) {
+                int i = x + y * dim;
+                next[i] = cost[i];
+                if (i == start || emu->weight[i] == MAP_WALL)
+                    continue;
+                int nx = x + dx;
+                int ny = y + dy;
+                uint32_t adj = (nx < 0 || ny < 0 || nx >= dim || ny >= dim)
+                             ? inf : cost[nx + ny * dim];
+                uint32_t travel = adj + (emu->weight[i] << 1) + step;
+                // a carry out of cost_size bits is never less than cost
+                if (travel < cost[i]) {
+                    next[i] = travel;
+                    emu->dir[i] = 0x8 | state;
+                    activity = true;
+                }
+            }
+        }
+        uint16_t * swap = cost;
+        cost = next;
+        next = swap;
+        history = (history << 1) | activity;
+    }
+    return cycles;
+}
+
+// returns the cycles spent storing
+static
+uint32_t emu_store(emu * emu)
+{
+    int n = emu->dim * emu->dim;
+    uint32_t words = (n + 7) / 8;
+    uint32_t * bram_dir = emu->bram + (HW_BRAM_DIR - HW_BRAM_MAP) / 4;
+    uint32_t value = 0;
+    for (int i = 0; i < n; ++i) {
+        value |= (uint32_t) emu->dir[i] << ((i & 7) * 4);
+        if ((i & 7) == 7 || i == n - 1) {
+            bram_dir[i >> 3] = value;
+            value = 0;
+        }
+    }
+    return words * (8 + emu_txn_wait()) + EMU_TXN_CYCLES;
+}
+
+void emu_run(emu * emu)
+{
+    uint32_t ctrl = emu->regs[0];
+    int x = (ctrl >> CTRL_X_SHF) & CTRL_X_MASK;
+    int y = (ctrl >> CTRL_Y_SHF) & CTRL_Y_MASK;
+
+    // a load comes first when both are asked for
+    if (ctrl & CTRL_LD)
+        emu->regs[CTRL_CNT_LD] = emu_load(emu);
+    if (ctrl & CTRL_RUN) {
+        emu->regs[CTRL_CNT_RUN] = emu_relax(emu, x, y);
+        emu->regs[CTRL_CNT_ST] = emu_store(emu);
+    }
+    // the directions and counters are out before run clears
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    emu->regs[0] = (y & CTRL_Y_MASK) << CTRL_Y_SHF |
+                   (x & CTRL_X_MASK) << CTRL_X_SHF;
+
+    #ifdef INTERRUPT
+    // int_done, as the kernel module passes it on
+    if (ctrl & CTRL_RUN)
+        raise(SIGIO);
+    #endif
+}
+
+static
+void * emu_device(void * arg)
+{
+    emu * emu = (struct emu_ *) arg;
+    for (;;) {
+        pthread_mutex_lock(&emu->lock);
+        while (!emu->rung && !emu->stop)
+            pthread_cond_wait(&emu->ring, &emu->lock);
+        bool stop = emu->stop;
+        emu->rung = false;
+        pthread_mutex_unlock(&emu->lock);
+        if (stop)
+            break;
+        emu_run(emu);
+    }
+    return NULL;
+}
+
+void emu_spawn(emu * emu)
+{
+    pthread_mutex_init(&emu->lock, NULL);
+    pthread_cond_init(&emu->ring, NULL);
+    emu->threaded = true;
+    pthread_create(&emu->thread, NULL, emu_device, emu);
+}
+
+void emu_ring(emu * emu)
+{
+    if (!emu->threaded) {
+        emu_run(emu);
+        return;
+    }
+    pthread_mutex_lock(&emu->lock);
+    emu->rung = true;
+    pthread_cond_signal(&emu->ring);
+    pthread_mutex_unlock(&emu->lock);
+}
+
+static
+void emu_doorbell(void * fabric)
+{
+    emu_ring((emu *) fabric);
+}
+
+void emu_driver(emu * emu, hw * hw)
+{
+    hw_ctor_mem(hw, emu->bram, emu->regs, emu->dim, emu_doorbell, emu);
+}
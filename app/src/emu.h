@@ -0,0 +1,74 @@
+#ifndef __EMU_H__
+#define __EMU_H__
+
+// the accelerator's fabric emulated in software
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+#include "hw.h"
+
+// the fabric the board runs
+#define EMU_DIM FABRIC_DIM
+#define EMU_COST_SIZE FABRIC_COST_SIZE
+
+// cycles from the fabric's request for a BRAM word to the word arriving or
+// being written, through the AXI master. the testbench memory in
+// source/test takes about as long
+#define EMU_TXN_CYCLES 20
+
+#define EMU_BRAM_WORDS ((HW_BRAM_END - HW_BRAM_MAP + 1) / 4)
+#define EMU_REGS 4
+
+// the fabric of source/src/fabric.v and neu.v with the BRAM and control
+// registers it sits behind. the host drives it as it drives the board,
+// through hw_ctor_mem over bram and regs, and rings it with emu_ring once
+// the control register is written. the fabric's work is done right there,
+// or, after emu_spawn, on a thread of its own while the host carries on,
+// as the board's would be
+typedef struct emu_
+{
+    int dim;                    // DIM: the fabric is dim x dim nodes
+    int cost_size;              // COST_SIZE: bits of a node's cost
+    uint32_t bram[EMU_BRAM_WORDS];
+    volatile uint32_t regs[EMU_REGS];   // control, then the cycle counters
+    // node registers
+    uint8_t * weight;
+    uint16_t * cost[2];         // this cycle's, and the next one's
+    uint8_t * dir;
+    // device thread
+    bool threaded;
+    bool rung;
+    bool stop;
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t ring;
+} emu;
+
+// a dim x dim fabric with costs of cost_size bits, at most 16
+void emu_ctor(emu * emu, int dim, int cost_size);
+// stops the device thread first, if there is one
+void emu_dtor(emu * emu);
+
+// run the fabric on its own thread from now on
+void emu_spawn(emu * emu);
+// the control register was written: run the fabric, or wake its thread
+void emu_ring(emu * emu);
+// constructs hw as the driver of this fabric, ringing it on each kick
+void emu_driver(emu * emu, hw * hw);
+
+// acts on the control register as the fabric's state machine does: loads
+// the map from BRAM, relaxes it from the start node, stores the directions
+// back and clears the run bit, counting cycles as the fabric would
+void emu_run(emu * emu);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif//__EMU_H__
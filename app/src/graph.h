@@ -0,0 +1,181 @@
+#ifndef __GRAPH_H__
+#define __GRAPH_H__
+
+// graph scratchpad shared by the software engines; not part of the public API
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "map.h"
+#include "path.h"
+#include "world.h"
+#include "tiles.h"
+
+extern const int32_t cost_table[128];
+
+#define DIR_R  1
+#define DIR_L -1
+#define DIR_U -1
+#define DIR_D  1
+#define DIR_H  0    // halt
+#define DIR_N  -2   // NULL direction
+
+// directions are stored in the accelerator's nibble encoding:
+// bit 3 marks a valid direction, bits 0-2 index acceldirs
+#define DIR_VALID 0x8
+#define DIR_NONE  0x0
+
+#define COST_INF UINT64_MAX
+
+// most buckets the bucket queue may use before falling back to a heap
+#define BUCKET_MAX 256
+
+// node storage is structure-of-arrays so the hot loops work on plain words:
+// a dense cost array, one direction nibble per byte, and bitsets for the
+// visited and queued flags
+typedef struct graph_
+{
+    int w;
+    int h;
+    cost_t * cost;
+    uint8_t * dir;
+    uint32_t * visit;
+    uint32_t * queued;
+    uint32_t * stamp;
+    uint32_t epoch;
+} graph;
+
+static inline
+bool bit_get(const uint32_t * set, idx_t i)
+{
+    return (set[i >> 5] >> (i & 31)) & 1;
+}
+
+static inline
+void bit_set(uint32_t * set, idx_t i)
+{
+    set[i >> 5] |= 1u << (i & 31);
+}
+
+static inline
+void bit_clr(uint32_t * set, idx_t i)
+{
+    set[i >> 5] &= ~(1u << (i & 31));
+}
+
+static inline
+idx_t graph_idx(const graph * graph, int x, int y)
+{
+    return x + (idx_t) graph->w * y;
+}
+
+// nodes whose stamp is not the current epoch are left over from an older
+// query: they are reset the first time they are touched
+static inline
+void graph_touch(const graph * graph, idx_t i)
+{
+    if (graph->stamp[i] != graph->epoch) {
+        graph->stamp[i] = graph->epoch;
+        graph->cost[i] = COST_INF;
+        graph->dir[i] = DIR_NONE;
+        bit_clr(graph->visit, i);
+        bit_clr(graph->queued, i);
+    }
+}
+
+//__attribute__((always_inline))
+static inline
+int32_t calc_cost(char c)
+{
+    return cost_table[(int) c];
+}
+//#define calc_cost(c) cost_table[c]
+
+static inline
+int32_t nibble_cost(uint8_t c)
+{
+    return c == MAP_WALL ? (int32_t) 0xDEADBEEF : c;
+}
+
+// cost of entering cell i, 0xDEADBEEF for walls. packed and tiled maps hold
+// the cost itself, so they skip the cost table
+static inline
+int32_t tile_cost_idx(const map * map, idx_t i)
+{
+    if (map->packed)
+        return nibble_cost(map_nibble(map, i));
+    if (map->tiles)
+        return nibble_cost(tstore_nibble(map->tiles, i % map->w, i / map->w));
+    return calc_cost(map->buffer[i]);
+}
+
+static inline
+int32_t tile_cost(const map * map, int x, int y)
+{
+    if (map->tiles)
+        return nibble_cost(tstore_nibble(map->tiles, x, y));
+    return tile_cost_idx(map, x + (idx_t) map->w * y);
+}
+
+static const int dirs[8][3] =
+{
+    // x  ,  y,    cost (Q31.1)
+    {DIR_L, DIR_U, 0x3},
+    {DIR_H, DIR_U, 0x2},
+    {DIR_R, DIR_U, 0x3},
+    {DIR_R, DIR_H, 0x2},
+    {DIR_R, DIR_D, 0x3},
+    {DIR_H, DIR_D, 0x2},
+    {DIR_L, DIR_D, 0x3},
+    {DIR_L, DIR_H, 0x2}
+};
+
+// nibble for each entry of dirs; dirs[(i + 4) % 8] is the reverse of dirs[i]
+static const uint8_t dir_codes[8] =
+{
+    DIR_VALID | 7,
+    DIR_VALID | 0,
+    DIR_VALID | 1,
+    DIR_VALID | 2,
+    DIR_VALID | 3,
+    DIR_VALID | 4,
+    DIR_VALID | 5,
+    DIR_VALID | 6,
+};
+
+static const int acceldirs[8][2] =
+{
+    // x  ,  y,
+    {DIR_H, DIR_U},
+    {DIR_R, DIR_U},
+    {DIR_R, DIR_H},
+    {DIR_R, DIR_D},
+    {DIR_H, DIR_D},
+    {DIR_L, DIR_D},
+    {DIR_L, DIR_H},
+    {DIR_L, DIR_U},
+};
+
+search * search_acquire(search * search, struct search_ * scratch, const map * map);
+void search_release(search * search, struct search_ * scratch);
+// workspace for the backward side of a bidirectional search
+search * rev_acquire(search * search, const map * map);
+void gen_graph(graph * graph, search * search);
+void graph_view(graph * graph, search * search);
+void graph_clear(graph * graph);
+void gen_path(graph * graph, const coord * start, const coord * end,
+              path * path);
+
+uint32_t min_tile_cost(void);
+uint32_t max_tile_cost(void);
+cost_t octile(const coord * a, const coord * b);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif//__GRAPH_H__
@@ -0,0 +1,119 @@
+#ifndef __HEAP_H__
+#define __HEAP_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+
+#include "path.h"
+
+// indexed binary min-heap of node indices
+// pos maps a node index to its slot so a queued node's key can be decreased
+typedef struct heap_
+{
+    idx_t * buffer;     // node index in each slot
+    cost_t * key;       // key of each slot
+    idx_t * pos;        // slot of each node; -1 if not queued
+    idx_t size;
+    idx_t cap;
+} heap;
+
+// the workspace keeps pos at -1 between queries, so this is O(1)
+static inline
+void heap_ctor(heap * h, search * s)
+{
+    h->cap = (idx_t) s->w * s->h;
+    h->buffer = s->heap;
+    h->key = s->key;
+    h->pos = s->pos;
+    h->size = 0;
+}
+
+// unlink whatever an early exit left queued
+static inline
+void heap_dtor(heap * h)
+{
+    for (idx_t i = 0; i < h->size; ++i)
+        h->pos[h->buffer[i]] = -1;
+    h->size = 0;
+}
+
+static inline
+void heap_set(heap * h, idx_t slot, idx_t n, cost_t key)
+{
+    h->buffer[slot] = n;
+    h->key[slot] = key;
+    h->pos[n] = slot;
+}
+
+static inline
+void heap_up(heap * h, idx_t slot)
+{
+    idx_t n = h->buffer[slot];
+    cost_t key = h->key[slot];
+    while (slot > 0) {
+        idx_t parent = (slot - 1) / 2;
+        if (h->key[parent] <= key)
+            break;
+        heap_set(h, slot, h->buffer[parent], h->key[parent]);
+        slot = parent;
+    }
+    heap_set(h, slot, n, key);
+}
+
+static inline
+void heap_down(heap * h, idx_t slot)
+{
+    idx_t n = h->buffer[slot];
+    cost_t key = h->key[slot];
+    for (;;) {
+        idx_t child = slot * 2 + 1;
+        if (child >= h->size)
+            break;
+        if (child + 1 < h->size && h->key[child + 1] < h->key[child])
+            child += 1;
+        if (key <= h->key[child])
+            break;
+        heap_set(h, slot, h->buffer[child], h->key[child]);
+        slot = child;
+    }
+    heap_set(h, slot, n, key);
+}
+
+// insert node n, or lower its key if it is already queued
+static inline
+void heap_push(heap * h, idx_t n, cost_t key)
+{
+    idx_t slot = h->pos[n];
+    if (slot < 0) {
+        slot = h->size++;
+    } else if (key >= h->key[slot]) {
+        return;
+    }
+    heap_set(h, slot, n, key);
+    heap_up(h, slot);
+}
+
+static inline
+bool heap_pop(heap * h, idx_t * n)
+{
+    if (h->size == 0)
+        return false;
+
+    *n = h->buffer[0];
+    h->pos[*n] = -1;
+    h->size -= 1;
+    if (h->size > 0) {
+        heap_set(h, 0, h->buffer[h->size], h->key[h->size]);
+        heap_down(h, 0);
+    }
+    return true;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif//__HEAP_H__
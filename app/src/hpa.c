@@ -0,0 +1,633 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include "map.h"
+#include "path.h"
+#include "world.h"
+#include "graph.h"
+#include "heap.h"
+#include "hpa.h"
+
+//#define dprintf(...) fprintf(stderr, __VA_ARGS__)
+#define dprintf(str, ...)
+
+// Hierarchical pathfinding (HPA*)
+//
+// Along each border between two clusters, every run of cells that can be
+// crossed straight over becomes an entrance: one transition in its middle,
+// or one at each end if the run is HPA_SPLIT cells or longer. A cell that
+// can only be crossed diagonally gets a transition of its own. Transition
+// cells are the abstract nodes; a cluster stores the costs between all of
+// its nodes, found with a Dijkstra confined to the cluster, and the links
+// from its nodes across its borders.
+//
+// A query adds start and end as two more nodes connected to the nodes of
+// their clusters, runs A* over the abstract graph, then refines each hop:
+// hops inside a cluster are searched again with A* on that cluster alone,
+// hops across a border are a single move. The result is close to, but not
+// always exactly, the shortest path. If the abstract graph misses a route
+// (two clusters only touching at a corner, say) the query falls back to a
+// full A*.
+//
+// Changing a tile dirties its cluster. Its borders are shared with its
+// neighbors, so the next query rebuilds it and its four neighbors.
+
+// entrances at least this long get a transition at each end
+#define HPA_SPLIT 6
+
+// a move from a node across its cluster's border
+typedef struct hpa_link_
+{
+    int slot;               // node it leaves from
+    idx_t cell;             // map index of the node it reaches
+    cost_t cost;
+} hpa_link;
+
+typedef struct hpa_cluster_
+{
+    int x0, y0;             // first tile
+    int w, h;               // size; smaller than the side at the map edges
+    int count;              // nodes
+    idx_t * cell;           // map index of each node
+    cost_t * dist;          // count x count costs, row is the source node
+    int links;
+    hpa_link * link;        // grouped by slot
+    int * first;            // first link of each slot, count + 1 entries
+    bool dirty;             // marked since the last rebuild
+    bool stale;             // needs a rebuild, dirty or next to a dirty one
+} cluster;
+
+static inline
+bool passable(const map * map, int x, int y)
+{
+    return tile_cost(map, x, y) != (int32_t) 0xDEADBEEF;
+}
+
+static inline
+int cluster_of(const hpa * hpa, int x, int y)
+{
+    return x / hpa->size + hpa->cw * (y / hpa->size);
+}
+
+static inline
+coord cell_coord(const map * map, idx_t cell)
+{
+    coord c = {.x = cell % map->w, .y = cell / map->w};
+    return c;
+}
+
+// slot of the node at cell, adding it if it is new
+static
+int cluster_node(cluster * cl, idx_t cell)
+{
+    for (int i = 0; i < cl->count; ++i) {
+        if (cl->cell[i] == cell)
+            return i;
+    }
+    cl->cell = (idx_t *) realloc(cl->cell, sizeof(idx_t) * (cl->count + 1));
+    cl->cell[cl->count] = cell;
+    return cl->count++;
+}
+
+static
+int cluster_find(const cluster * cl, idx_t cell)
+{
+    for (int i = 0; i < cl->count; ++i) {
+        if (cl->cell[i] == cell)
+            return i;
+    }
+    return -1;
+}
+
+// add the transition between cell a of this cluster and cell b across the
+// border to the cluster
+static
+void cluster_link(cluster * cl, const map * map, coord a, coord b)
+{
+    int slot = cluster_node(cl, a.x + (idx_t) map->w * a.y);
+    int step = (a.x != b.x && a.y != b.y) ? 0x3 : 0x2;
+
+    cl->link = (hpa_link *) realloc(cl->link, sizeof(hpa_link) * (cl->links + 1));
+    cl->link[cl->links].slot = slot;
+    cl->link[cl->links].cell = b.x + (idx_t) map->w * b.y;
+    cl->link[cl->links].cost = step + (tile_cost(map, b.x, b.y) << 1);
+    cl->links += 1;
+}
+
+// find the transitions across one border. the a side runs from (ax, ay)
+// along (dx, dy) for len cells, the b side is the row of cells next to it
+// across the border. both clusters scan their shared border the same way,
+// so they agree on its transitions; mine says which side is this cluster's
+static
+void border_scan(cluster * cl, const map * map, int ax, int ay, int dx,
+                 int dy, int len, bool mine_a)
+{
+    int ox = dy;
+    int oy = dx;
+    #define A(k) ((coord) {.x = ax + (k) * dx, .y = ay + (k) * dy})
+    #define B(k) ((coord) {.x = ax + (k) * dx + ox, .y = ay + (k) * dy + oy})
+    #define PASS_A(k) passable(map, A(k).x, A(k).y)
+    #define PASS_B(k) passable(map, B(k).x, B(k).y)
+    #define STRAIGHT(k) ((k) >= 0 && (k) < len && PASS_A(k) && PASS_B(k))
+    #define ADD(i, j) (mine_a ? cluster_link(cl, map, A(i), B(j)) \
+                              : cluster_link(cl, map, B(j), A(i)))
+
+    for (int k = 0; k < len; ) {
+        if (!STRAIGHT(k)) {
+            // cells that can only be crossed diagonally
+            if (k + 1 < len && !STRAIGHT(k + 1)) {
+                if (PASS_A(k) && PASS_B(k + 1))
+                    ADD(k, k + 1);
+                if (PASS_A(k + 1) && PASS_B(k))
+                    ADD(k + 1, k);
+            }
+            k += 1;
+            continue;
+        }
+
+        int run = k;
+        while (STRAIGHT(k))
+            k += 1;
+        if (k - run >= HPA_SPLIT) {
+            ADD(run, run);
+            ADD(k - 1, k - 1);
+        }
+        else {
+            int mid = (run + k - 1) / 2;
+            ADD(mid, mid);
+        }
+    }
+
+    #undef A
+    #undef B
+    #undef PASS_A
+    #undef PASS_B
+    #undef STRAIGHT
+    #undef ADD
+}
+
+// copy the cluster into the padded sub-map, which is packed whatever kind
+// the map is
+static
+void cluster_load(hpa * hpa, const map * map, const cluster * cl)
+{
+    memset(hpa->sub.packed, 0xFF, sizeof(uint32_t) * map_words(hpa->size, hpa->size));
+    for (int y = 0; y < cl->h; ++y) {
+        for (int x = 0; x < cl->w; ++x) {
+            int32_t c = tile_cost(map, cl->x0 + x, cl->y0 + y);
+            map_put_nibble(&hpa->sub, x, y, c == (int32_t) 0xDEADBEEF ? MAP_WALL : c);
+        }
+    }
+}
+
+// Dijkstra from src over the loaded cluster. in reverse every cost is the
+// cost of getting from a cell to src instead, so a move is charged the tile
+// of the cell being expanded rather than of the one reached
+static
+void local_search(hpa * hpa, graph * graph, const coord * src, bool reverse,
+                  prof * prof)
+{
+    const map * map = &hpa->sub;
+    heap heap;
+
+    gen_graph(graph, &hpa->local);
+    heap_ctor(&heap, &hpa->local);
+
+    idx_t idx = graph_idx(graph, src->x, src->y);
+    graph_touch(graph, idx);
+    graph->cost[idx] = 0;
+    heap_push(&heap, idx, 0);
+
+    while (heap_pop(&heap, &idx)) {
+        prof->expand += 1;
+        coord curr = {.x = idx % graph->w, .y = idx / graph->w};
+        bit_set(graph->visit, idx);
+
+        int32_t here = tile_cost(map, curr.x, curr.y);
+        if (reverse && here == (int32_t) 0xDEADBEEF)
+            continue;
+
+        for (int i = 0; i < 8; i += 1) {
+            coord next = {.x = curr.x + dirs[i][0], .y = curr.y + dirs[i][1]};
+
+            if (next.x < 0 || next.x >= graph->w ||
+                next.y < 0 || next.y >= graph->h)
+                continue;
+
+            int32_t tile = tile_cost(map, next.x, next.y);
+            if (tile == (int32_t) 0xDEADBEEF)
+                continue;
+
+            idx_t n = graph_idx(graph, next.x, next.y);
+            graph_touch(graph, n);
+            if (bit_get(graph->visit, n))
+                continue;
+
+            cost_t cost = graph->cost[idx] + dirs[i][2] +
+                          ((reverse ? here : tile) << 1);
+            if (cost < graph->cost[n]) {
+                graph->cost[n] = cost;
+                heap_push(&heap, n, cost);
+            }
+        }
+    }
+    heap_dtor(&heap);
+}
+
+// cost the last local_search found for the map cell
+static inline
+cost_t local_cost(const hpa * hpa, graph * graph, const map * map,
+                  const cluster * cl, idx_t cell)
+{
+    coord c = cell_coord(map, cell);
+    idx_t i = graph_idx(graph, c.x - cl->x0, c.y - cl->y0);
+    graph_touch(graph, i);
+    return graph->cost[i];
+}
+
+static
+void cluster_rebuild(hpa * hpa, const map * map, int k)
+{
+    cluster * cl = &hpa->clusters[k];
+    int i = k % hpa->cw;
+    int j = k / hpa->cw;
+    cl->count = 0;
+    cl->links = 0;
+
+    if (i > 0)
+        border_scan(cl, map, cl->x0 - 1, cl->y0, 0, 1, cl->h, false);
+    if (i < hpa->cw - 1)
+        border_scan(cl, map, cl->x0 + cl->w - 1, cl->y0, 0, 1, cl->h, true);
+    if (j > 0)
+        border_scan(cl, map, cl->x0, cl->y0 - 1, 1, 0, cl->w, false);
+    if (j < hpa->ch - 1)
+        border_scan(cl, map, cl->x0, cl->y0 + cl->h - 1, 1, 0, cl->w, true);
+
+    // group the links by the node they leave from
+    hpa_link * link = (hpa_link *) malloc(sizeof(hpa_link) * cl->links);
+    cl->first = (int *) realloc(cl->first, sizeof(int) * (cl->count + 1));
+    memset(cl->first, 0, sizeof(int) * (cl->count + 1));
+    for (int l = 0; l < cl->links; ++l)
+        cl->first[cl->link[l].slot + 1] += 1;
+    for (int s = 0; s < cl->count; ++s)
+        cl->first[s + 1] += cl->first[s];
+    for (int l = 0; l < cl->links; ++l)
+        link[cl->first[cl->link[l].slot]++] = cl->link[l];
+    for (int s = cl->count; s > 0; --s)
+        cl->first[s] = cl->first[s - 1];
+    cl->first[0] = 0;
+    free(cl->link);
+    cl->link = link;
+
+    cl->dist = (cost_t *) realloc(cl->dist, sizeof(cost_t) * cl->count * cl->count);
+    cluster_load(hpa, map, cl);
+    prof prof;
+    prof_ctor(&prof);
+    for (int s = 0; s < cl->count; ++s) {
+        graph graph;
+        coord c = cell_coord(map, cl->cell[s]);
+        coord src = {.x = c.x - cl->x0, .y = c.y - cl->y0};
+        local_search(hpa, &graph, &src, false, &prof);
+        for (int t = 0; t < cl->count; ++t)
+            cl->dist[s * cl->count + t] = local_cost(hpa, &graph, map, cl, cl->cell[t]);
+    }
+}
+
+// lay the clusters out for a map of a new size; all of them start dirty
+static
+void hpa_layout(hpa * hpa, const map * map)
+{
+    for (int k = 0; k < hpa->cw * hpa->ch; ++k) {
+        free(hpa->clusters[k].cell);
+        free(hpa->clusters[k].dist);
+        free(hpa->clusters[k].link);
+        free(hpa->clusters[k].first);
+    }
+    free(hpa->clusters);
+
+    hpa->w = map->w;
+    hpa->h = map->h;
+    hpa->cw = (map->w + hpa->size - 1) / hpa->size;
+    hpa->ch = (map->h + hpa->size - 1) / hpa->size;
+    hpa->clusters = (cluster *) calloc(hpa->cw * hpa->ch, sizeof(cluster));
+    for (int k = 0; k < hpa->cw * hpa->ch; ++k) {
+        cluster * cl = &hpa->clusters[k];
+        cl->x0 = (k % hpa->cw) * hpa->size;
+        cl->y0 = (k / hpa->cw) * hpa->size;
+        cl->w = map->w - cl->x0 < hpa->size ? map->w - cl->x0 : hpa->size;
+        cl->h = map->h - cl->y0 < hpa->size ? map->h - cl->y0 : hpa->size;
+        cl->dirty = true;
+    }
+    hpa->dirty = hpa->cw * hpa->ch;
+}
+
+// rebuild the dirty clusters and their neighbors, then renumber the nodes
+static
+void hpa_refresh(hpa * hpa, const map * map)
+{
+    int n = hpa->cw * hpa->ch;
+    for (int k = 0; k < n; ++k) {
+        if (!hpa->clusters[k].dirty)
+            continue;
+        int i = k % hpa->cw;
+        int j = k / hpa->cw;
+        hpa->clusters[k].stale = true;
+        if (i > 0)
+            hpa->clusters[k - 1].stale = true;
+        if (i < hpa->cw - 1)
+            hpa->clusters[k + 1].stale = true;
+        if (j > 0)
+            hpa->clusters[k - hpa->cw].stale = true;
+        if (j < hpa->ch - 1)
+            hpa->clusters[k + hpa->cw].stale = true;
+    }
+    for (int k = 0; k < n; ++k) {
+        cluster * cl = &hpa->clusters[k];
+        if (cl->stale)
+            cluster_rebuild(hpa, map, k);
+        cl->dirty = false;
+        cl->stale = false;
+    }
+    hpa->dirty = 0;
+
+    int nodes = 0;
+    hpa->offset = (int *) realloc(hpa->offset, sizeof(int) * n);
+    for (int k = 0; k < n; ++k) {
+        hpa->offset[k] = nodes;
+        nodes += hpa->clusters[k].count;
+    }
+    hpa->nodes = nodes;
+    hpa->owner = (int *) realloc(hpa->owner, sizeof(int) * nodes);
+    for (int k = 0; k < n; ++k) {
+        for (int s = 0; s < hpa->clusters[k].count; ++s)
+            hpa->owner[hpa->offset[k] + s] = k;
+    }
+
+    // start and end go last
+    nodes += 2;
+    hpa->cost = (cost_t *) realloc(hpa->cost, sizeof(cost_t) * nodes);
+    hpa->parent = (int *) realloc(hpa->parent, sizeof(int) * nodes);
+    hpa->closed = (uint8_t *) realloc(hpa->closed, sizeof(uint8_t) * nodes);
+    hpa->heap = (idx_t *) realloc(hpa->heap, sizeof(idx_t) * nodes);
+    hpa->key = (cost_t *) realloc(hpa->key, sizeof(cost_t) * nodes);
+    hpa->pos = (idx_t *) realloc(hpa->pos, sizeof(idx_t) * nodes);
+}
+
+void hpa_ctor(hpa * hpa, int size)
+{
+    memset(hpa, 0, sizeof(*hpa));
+    hpa->size = size;
+    hpa->sub.w = size;
+    hpa->sub.h = size;
+    hpa->sub.buffer = NULL;
+    hpa->sub.packed = (uint32_t *) malloc(sizeof(uint32_t) * map_words(size, size));
+    hpa->sub.hash = 0;
+    search_ctor(&hpa->local, size, size);
+}
+
+void hpa_dtor(hpa * hpa)
+{
+    for (int k = 0; k < hpa->cw * hpa->ch; ++k) {
+        free(hpa->clusters[k].cell);
+        free(hpa->clusters[k].dist);
+        free(hpa->clusters[k].link);
+        free(hpa->clusters[k].first);
+    }
+    free(hpa->clusters);
+    free(hpa->offset);
+    free(hpa->owner);
+    free(hpa->cost);
+    free(hpa->parent);
+    free(hpa->closed);
+    free(hpa->heap);
+    free(hpa->key);
+    free(hpa->pos);
+    free(hpa->sub.packed);
+    search_dtor(&hpa->local);
+}
+
+void hpa_mark(hpa * hpa, int x, int y)
+{
+    if (hpa->clusters == NULL)
+        return;
+
+    cluster * cl = &hpa->clusters[cluster_of(hpa, x, y)];
+    if (!cl->dirty) {
+        cl->dirty = true;
+        hpa->dirty += 1;
+    }
+}
+
+// abstract A* state of one query
+typedef struct query_
+{
+    const map * map;
+    const coord * start;
+    const coord * end;
+    int ks;                 // start and end clusters
+    int ke;
+    cost_t * from_start;    // per node of ks
+    cost_t * to_end;        // per node of ke
+    cost_t direct;          // start to end within one cluster
+    heap heap;
+} query;
+
+static inline
+idx_t node_cell(const hpa * hpa, const query * q, int id)
+{
+    if (id == hpa->nodes)
+        return q->start->x + (idx_t) q->map->w * q->start->y;
+    if (id == hpa->nodes + 1)
+        return q->end->x + (idx_t) q->map->w * q->end->y;
+
+    int k = hpa->owner[id];
+    return hpa->clusters[k].cell[id - hpa->offset[k]];
+}
+
+static inline
+void abstract_relax(hpa * hpa, query * q, int u, int v, cost_t w)
+{
+    if (w == COST_INF || hpa->closed[v])
+        return;
+
+    cost_t cost = hpa->cost[u] + w;
+    if (cost < hpa->cost[v]) {
+        coord c = cell_coord(q->map, node_cell(hpa, q, v));
+        hpa->cost[v] = cost;
+        hpa->parent[v] = u;
+        heap_push(&q->heap, v, cost + octile(&c, q->end));
+    }
+}
+
+static
+bool abstract_search(hpa * hpa, query * q, prof * prof)
+{
+    int start = hpa->nodes;
+    int end = hpa->nodes + 1;
+    for (int i = 0; i < hpa->nodes + 2; ++i) {
+        hpa->cost[i] = COST_INF;
+        hpa->parent[i] = -1;
+        hpa->closed[i] = 0;
+        hpa->pos[i] = -1;
+    }
+    q->heap.buffer = hpa->heap;
+    q->heap.key = hpa->key;
+    q->heap.pos = hpa->pos;
+    q->heap.size = 0;
+    q->heap.cap = hpa->nodes + 2;
+
+    hpa->cost[start] = 0;
+    heap_push(&q->heap, start, octile(q->start, q->end));
+
+    idx_t u;
+    while (heap_pop(&q->heap, &u)) {
+        prof->expand += 1;
+        hpa->closed[u] = 1;
+        if (u == end)
+            break;
+
+        if (u == start) {
+            const cluster * cl = &hpa->clusters[q->ks];
+            for (int s = 0; s < cl->count; ++s)
+                abstract_relax(hpa, q, u, hpa->offset[q->ks] + s, q->from_start[s]);
+            if (q->ks == q->ke)
+                abstract_relax(hpa, q, u, end, q->direct);
+            continue;
+        }
+
+        int k = hpa->owner[u];
+        int s = u - hpa->offset[k];
+        const cluster * cl = &hpa->clusters[k];
+        for (int t = 0; t < cl->count; ++t) {
+            if (t != s)
+                abstract_relax(hpa, q, u, hpa->offset[k] + t, cl->dist[s * cl->count + t]);
+        }
+        for (int l = cl->first[s]; l < cl->first[s + 1]; ++l) {
+            coord c = cell_coord(q->map, cl->link[l].cell);
+            int k2 = cluster_of(hpa, c.x, c.y);
+            int t = cluster_find(&hpa->clusters[k2], cl->link[l].cell);
+            if (t >= 0)
+                abstract_relax(hpa, q, u, hpa->offset[k2] + t, cl->link[l].cost);
+        }
+        if (k == q->ke)
+            abstract_relax(hpa, q, u, end, q->to_end[s]);
+    }
+    heap_dtor(&q->heap);
+    return hpa->cost[end] != COST_INF;
+}
+
+// push a move onto the path stack, merging it into the top one if it goes
+// the same way
+static
+void path_push(path * path, const movement * move)
+{
+    if (vector_size(&path->moves) > 0) {
+        movement * top = (movement *) vector_backp(&path->moves);
+        if (top->x_dir == move->x_dir && top->y_dir == move->y_dir) {
+            top->count += move->count;
+            return;
+        }
+    }
+    vector_push_back(&path->moves, move);
+}
+
+// turn the abstract path into moves. the path is a stack whose top is the
+// first move, so hops are refined from the end back to the start
+static
+void refine(hpa * hpa, query * q, path * path, prof * prof)
+{
+    const map * map = q->map;
+    for (int v = hpa->nodes + 1; v != hpa->nodes; v = hpa->parent[v]) {
+        int u = hpa->parent[v];
+        coord a = cell_coord(map, node_cell(hpa, q, u));
+        coord b = cell_coord(map, node_cell(hpa, q, v));
+        int k = cluster_of(hpa, a.x, a.y);
+
+        if (k != cluster_of(hpa, b.x, b.y)) {
+            movement move = {.count = 1, .x_dir = b.x - a.x, .y_dir = b.y - a.y};
+            path_push(path, &move);
+            continue;
+        }
+
+        const cluster * cl = &hpa->clusters[k];
+        coord la = {.x = a.x - cl->x0, .y = a.y - cl->y0};
+        coord lb = {.x = b.x - cl->x0, .y = b.y - cl->y0};
+        struct path_ seg;
+        struct prof_ local;
+        cluster_load(hpa, map, cl);
+        apath_find(&hpa->local, &hpa->sub, &la, &lb, &seg, &local);
+        prof->expand += local.expand;
+        for (size_t i = 0; i < vector_size(&seg.moves); ++i) {
+            movement move;
+            vector_get(&seg.moves, i, &move);
+            path_push(path, &move);
+        }
+        path_dtor(&seg);
+    }
+}
+
+void hpath_find(hpa * hpa, search * search, const map * map,
+                const coord * start, const coord * end, path * path,
+                prof * prof)
+{
+    query q;
+    graph graph;
+
+    prof_ctor(prof);
+
+    prof_start(prof);
+    path_ctor(path);
+    if (hpa->clusters == NULL || hpa->w != map->w || hpa->h != map->h)
+        hpa_layout(hpa, map);
+    if (hpa->dirty)
+        hpa_refresh(hpa, map);
+
+    // connect start and end to the nodes of their clusters
+    q.map = map;
+    q.start = start;
+    q.end = end;
+    q.ks = cluster_of(hpa, start->x, start->y);
+    q.ke = cluster_of(hpa, end->x, end->y);
+
+    const cluster * cs = &hpa->clusters[q.ks];
+    const cluster * ce = &hpa->clusters[q.ke];
+    q.from_start = (cost_t *) malloc(sizeof(cost_t) * (cs->count + 1));
+    q.to_end = (cost_t *) malloc(sizeof(cost_t) * (ce->count + 1));
+
+    coord src = {.x = start->x - cs->x0, .y = start->y - cs->y0};
+    cluster_load(hpa, map, cs);
+    local_search(hpa, &graph, &src, false, prof);
+    for (int s = 0; s < cs->count; ++s)
+        q.from_start[s] = local_cost(hpa, &graph, map, cs, cs->cell[s]);
+    q.direct = COST_INF;
+    if (q.ks == q.ke)
+        q.direct = local_cost(hpa, &graph, map, cs, end->x + (idx_t) map->w * end->y);
+
+    coord dst = {.x = end->x - ce->x0, .y = end->y - ce->y0};
+    cluster_load(hpa, map, ce);
+    local_search(hpa, &graph, &dst, true, prof);
+    for (int s = 0; s < ce->count; ++s)
+        q.to_end[s] = local_cost(hpa, &graph, map, ce, ce->cell[s]);
+    prof_end(prof); prof->prproc = prof_dt(prof);
+
+    prof_start(prof);
+    bool found = abstract_search(hpa, &q, prof);
+    prof_end(prof); prof->exec = prof_dt(prof);
+
+    prof_start(prof);
+    if (found) {
+        refine(hpa, &q, path, prof);
+    }
+    else {
+        // the abstraction can miss routes through cluster corners
+        struct prof_ full;
+        path_dtor(path);
+        apath_find(search, map, start, end, path, &full);
+        prof->expand += full.expand;
+    }
+    free(q.from_start);
+    free(q.to_end);
+    prof_end(prof); prof->poproc = prof_dt(prof);
+}
@@ -0,0 +1,65 @@
+#ifndef __HPA_H__
+#define __HPA_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+#include "map.h"
+#include "path.h"
+#include "world.h"
+#include "prof.h"
+
+// default cluster side in tiles
+#define HPA_CLUSTER 16
+
+// HPA* abstraction of one map: the grid is cut into square clusters, the
+// cells where paths can cross between clusters become abstract nodes, and
+// the costs between the nodes of each cluster are found once. queries
+// search the abstract graph and only refine the clusters they cross.
+//
+// build one per map and keep it for as long as the map lives: it is built
+// on the first query and only the clusters marked with hpa_mark are rebuilt
+// on later ones
+typedef struct hpa_
+{
+    int size;                       // cluster side
+    int w;                          // map size the abstraction is built for
+    int h;
+    int cw;                         // clusters across and down
+    int ch;
+    struct hpa_cluster_ * clusters;
+    int dirty;                      // clusters waiting for a rebuild
+    int nodes;                      // abstract nodes, 0 if not yet counted
+    int * offset;                   // id of each cluster's first node
+    int * owner;                    // cluster of each node id
+    // abstract search scratch, nodes + 2 entries (start and end last)
+    cost_t * cost;
+    int * parent;
+    uint8_t * closed;
+    idx_t * heap;
+    cost_t * key;
+    idx_t * pos;
+    // one cluster, padded with walls, to search within
+    map sub;
+    search local;
+} hpa;
+
+void hpa_ctor(hpa * hpa, int size);
+void hpa_dtor(hpa * hpa);
+
+// tile (x, y) of the map changed: its cluster is rebuilt on the next query
+void hpa_mark(hpa * hpa, int x, int y);
+
+// search is only used if the query has to fall back to a full A*
+void hpath_find(hpa * hpa, search * search, const map * map,
+                const coord * start, const coord * end, path * path,
+                prof * prof);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif//__HPA_H__
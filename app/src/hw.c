@@ -0,0 +1,438 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <unistd.h>
+#include <sched.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <sys/types.h>
+
+#include <mem/mem.h>
+
+#include "map.h"
+#include "world.h"
+#include "path.h"
+#include "prof.h"
+#include "hw.h"
+
+// signal stuff
+#ifdef INTERRUPT
+int sigio_handled = 0;
+void sig_handler(int signo)
+{
+    if (signo == SIGIO) {
+        sigio_handled = 1;
+    }
+}
+
+#define INT_DEVICE "/dev/dkstr_int"
+int fd;
+int sig_init(void)
+{
+    int status = 0;
+    struct sigaction action;
+    sigemptyset(&action.sa_mask);
+    sigaddset(&action.sa_mask, SIGIO);
+    action.sa_handler = sig_handler;
+    action.sa_flags = 0;
+    sigaction(SIGIO, &action, NULL);
+
+    // acquire the device
+    fd = open(INT_DEVICE, O_RDONLY);
+    if (fd == -1) {
+        fprintf(stderr, "Unable to open " INT_DEVICE "\n");
+        return 1;
+    }
+
+    // setup flags for the device
+    int fc;
+    fc = fcntl(fd, F_SETOWN, getpid());
+    if (fc == -1) {
+        fprintf(stderr, "Unable to SETOWN\n");
+        status = 2;
+        goto cleanup;
+    }
+
+    fc = fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_ASYNC);
+    if (fc == -1) {
+        fprintf(stderr, "Unable to SETFL OASYNC\n");
+        status = 3;
+        goto cleanup;
+    }
+
+    return 0;
+cleanup:
+    close(fd);
+    return status;
+}
+
+void sig_done(void)
+{
+    close(fd);
+}
+
+sigset_t wait_mask, wait_mask_old, wait_mask_most;
+void sig_wait_setup(void)
+{
+    sigio_handled = 0;
+    // need to run this block every time to preven sigsuspend race cond.
+    // this is literally magic
+    sigfillset(&wait_mask);
+    sigfillset(&wait_mask_most);
+    sigdelset(&wait_mask_most, SIGIO);
+    sigdelset(&wait_mask_most, SIGINT);
+    sigprocmask(SIG_SETMASK, &wait_mask, &wait_mask_old);
+}
+
+void sig_wait(void)
+{
+    while (sigio_handled == 0)
+        sigsuspend(&wait_mask_most);
+    sigprocmask(SIG_SETMASK, &wait_mask_old, NULL);
+}
+#endif
+
+void convert_map(const map * map, uint32_t * buffer)
+{
+    if (map->packed) {
+        // already in the accelerator's layout
+        for (size_t i = 0; i < map_words(map->w, map->h); ++i)
+            buffer[i] = map->packed[i];
+        return;
+    }
+    map_pack_words(map, buffer);
+}
+
+void convert_window(const map * map, int side, uint32_t * buffer)
+{
+    if (map->w == side && map->h == side) {
+        convert_map(map, buffer);
+        return;
+    }
+
+    // walls right of and below the map keep paths inside it
+    for (size_t i = 0; i < map_words(side, side); ++i)
+        buffer[i] = 0xFFFFFFFF;
+    for (int y = 0; y < map->h; ++y) {
+        for (int x = 0; x < map->w; ++x) {
+            int i = x + y * side;
+            buffer[i >> 3] &= ~(0xFu << ((i & 7) * 4));
+            buffer[i >> 3] |= (uint32_t) map_cost(map, x, y) << ((i & 7) * 4);
+        }
+    }
+}
+
+void hw_gen_path(int w, int h, const coord * start, const coord * end,
+                const uint32_t * buffer, path * path)
+{
+    path_ctor(path);
+
+    uint8_t dir = 0;
+    uint8_t prev_dir = 0xFF;
+    coord curr = *end;
+    int count = 0;
+    int max = w * h;
+    // each word is read once while the path stays in it, which counts
+    // when buffer is the BRAM itself
+    int index = -1;
+    uint32_t word = 0;
+    while (!(curr.x == start->x && curr.y == start->y)) {
+        if (count++ >= max) {
+            //printf("Max hit\n");
+            return;
+        }
+
+        // convert into a linear index into w*h*8 4-bit buffer
+        int lindex = curr.x + curr.y * w;
+        if (lindex / 8 != index) {
+            index = lindex / 8;
+            word = buffer[index];
+        }
+        dir = (word >> ((lindex % 8) * 4)) & 0xF;
+        if (dir & 0x8)
+            dir &= 0x7;
+        else {
+            //printf("No path from (%d,%d) to (%d,%d)\n", start->x, start->y, end->x, end->y);
+            return;
+        }
+
+        /*
+        printf("Going from (%d,%d) -> (%d,%d)\n",
+               curr.x, curr.y,
+               curr.x + hw_dirs[dir][0], curr.y + hw_dirs[dir][1]);
+        */
+
+        if (dir == prev_dir) {
+            movement * move_p = (movement *) vector_backp(&path->moves);
+            move_p->count += 1;
+        }
+        else {
+            movement move;
+            move.count = 1;
+            // reverse since we're moving backwards
+            move.x_dir = -hw_dirs[dir][0];
+            move.y_dir = -hw_dirs[dir][1];
+            vector_push_back(&path->moves, &move);
+        }
+        curr.x = curr.x + hw_dirs[dir][0];
+        curr.y = curr.y + hw_dirs[dir][1];
+
+        prev_dir = dir;
+    }
+}
+
+int hw_ctor(hw * hw)
+{
+    hw->buffer = (uint32_t *) malloc(sizeof(uint32_t) * map_words(FABRIC_DIM, FABRIC_DIM));
+    if (mem_ctor(&hw->mem_bram, MEM_MMAP, 1, (void*)(uintptr_t) HW_BRAM_MAP, (void*)(uintptr_t) HW_BRAM_END) != MEM_OKAY) {
+        free(hw->buffer);
+        return 1;
+    }
+    if (mem_ctor(&hw->mem_ctrl, MEM_MMAP, 1, (void*)(uintptr_t) HW_CTRL, (void*)(uintptr_t) HW_CTRL_END) != MEM_OKAY) {
+        mem_dtor(&hw->mem_bram);
+        free(hw->buffer);
+        return 1;
+    }
+    hw->bram_map = mem_addr(&hw->mem_bram, (void*)(uintptr_t) HW_BRAM_MAP);
+    hw->bram_dir = mem_addr(&hw->mem_bram, (void*)(uintptr_t) HW_BRAM_DIR);
+    hw->ctrl = mem_addr(&hw->mem_ctrl, (void*)(uintptr_t) HW_CTRL);
+    hw->side = FABRIC_DIM;
+    hw->mapped = true;
+    hw->run = NULL;
+    hw->fabric = NULL;
+    hw->w = 0;
+    hw->h = 0;
+    hw->calibrated = false;
+    hw->direct_tx = false;
+    hw->direct_rx = false;
+    return 0;
+}
+
+void hw_ctor_mem(hw * hw, uint32_t * bram, volatile uint32_t * ctrl, int side,
+                 void (*run)(void * fabric), void * fabric)
+{
+    hw->buffer = (uint32_t *) malloc(sizeof(uint32_t) * map_words(side, side));
+    hw->bram_map = bram;
+    hw->bram_dir = bram + (HW_BRAM_DIR - HW_BRAM_MAP) / sizeof(uint32_t);
+    hw->ctrl = ctrl;
+    hw->side = side;
+    hw->mapped = false;
+    hw->run = run;
+    hw->fabric = fabric;
+    hw->w = 0;
+    hw->h = 0;
+    hw->calibrated = false;
+    hw->direct_tx = false;
+    hw->direct_rx = false;
+}
+
+// times of the fastest of a few runs
+#define HW_CALIBRATE_RUNS 8
+
+void hw_calibrate(hw * hw)
+{
+    int side = hw->side;
+    prof prof;
+
+    // an open map, and directions west along the bottom row and then north
+    // up the first column, so that following them reads a row of words and
+    // then a word per row, as paths across the fabric do
+    map open = {.w = side, .h = side,
+                .buffer = (char *) malloc(sizeof(char) * side * side)};
+    memset(open.buffer, ' ', sizeof(char) * side * side);
+    map dirs = {.w = side, .h = side, .packed = hw->buffer};
+    for (int y = 0; y < side; ++y)
+        for (int x = 0; x < side; ++x)
+            map_put_nibble(&dirs, x, y, x > 0 ? 0x8 | 6 : 0x8 | 0);
+    coord start = {.x = 0, .y = 0};
+    coord end = {.x = side - 1, .y = side - 1};
+
+    hw->io.bounce_tx = UINT64_MAX;
+    hw->io.direct_tx = UINT64_MAX;
+    hw->io.bounce_rx = UINT64_MAX;
+    hw->io.direct_rx = UINT64_MAX;
+    for (int r = 0; r < HW_CALIBRATE_RUNS; ++r) {
+        path path;
+        uint64_t dt;
+
+        // directions in BRAM, out of the way of the packing below
+        hw_send(hw, hw->buffer, side, side);
+        memcpy(hw->bram_dir, hw->bram_map, sizeof(uint32_t) * map_words(side, side));
+
+        prof_start(&prof);
+        hw_recv(hw, hw->buffer, side, side);
+        hw_gen_path(side, side, &start, &end, hw->buffer, &path);
+        prof_end(&prof);
+        dt = prof_dt(&prof);
+        hw->io.bounce_rx = dt < hw->io.bounce_rx ? dt : hw->io.bounce_rx;
+        path_dtor(&path);
+
+        prof_start(&prof);
+        hw_gen_path(side, side, &start, &end, hw->bram_dir, &path);
+        prof_end(&prof);
+        dt = prof_dt(&prof);
+        hw->io.direct_rx = dt < hw->io.direct_rx ? dt : hw->io.direct_rx;
+        path_dtor(&path);
+
+        prof_start(&prof);
+        convert_map(&open, hw->buffer);
+        hw_send(hw, hw->buffer, side, side);
+        prof_end(&prof);
+        dt = prof_dt(&prof);
+        hw->io.bounce_tx = dt < hw->io.bounce_tx ? dt : hw->io.bounce_tx;
+
+        prof_start(&prof);
+        convert_map(&open, hw->bram_map);
+        prof_end(&prof);
+        dt = prof_dt(&prof);
+        hw->io.direct_tx = dt < hw->io.direct_tx ? dt : hw->io.direct_tx;
+    }
+    free(open.buffer);
+
+    hw->direct_tx = hw->io.direct_tx < hw->io.bounce_tx;
+    hw->direct_rx = hw->io.direct_rx < hw->io.bounce_rx;
+    hw->calibrated = true;
+}
+
+void hw_prepare(hw * hw)
+{
+    if (!hw->calibrated)
+        hw_calibrate(hw);
+}
+
+void hw_dtor(hw * hw)
+{
+    if (hw->mapped) {
+        mem_dtor(&hw->mem_bram);
+        mem_dtor(&hw->mem_ctrl);
+    }
+    free(hw->buffer);
+}
+
+int hw_submit(hw * hw, const map * map, const coord * start, const coord * end,
+              prof * prof)
+{
+    hw->w = 0;
+    hw->h = 0;
+    if (!hw_fits(hw, map))
+        return 1;
+    hw_prepare(hw);
+
+    hw->w = map->w;
+    hw->h = map->h;
+    hw->start = *start;
+    hw->end = *end;
+    if (hw->direct_tx) {
+        // packing is the transfer
+        prof_start(prof);
+        convert_window(map, hw->side, hw->bram_map);
+        prof_end(prof); prof->tx += prof_dt(prof);
+    }
+    else {
+        prof_start(prof);
+        convert_window(map, hw->side, hw->buffer);
+        prof_end(prof); prof->prproc += prof_dt(prof);
+
+        // transfer node weights to bram
+        prof_start(prof);
+        hw_send(hw, hw->buffer, hw->side, hw->side);
+        prof_end(prof); prof->tx += prof_dt(prof);
+    }
+
+    // setup the ctrl reg value and program
+    prof_start(prof);
+    #if defined(INTERRUPT)
+    // interrupt
+    sig_wait_setup();
+    #endif
+    hw_kick(hw, start);
+    prof_end(prof); prof->exec += prof_dt(prof);
+    return 0;
+}
+
+void hw_send(hw * hw, const uint32_t * words, int w, int h)
+{
+    // since 8 node weights fit into a single word, figure out how
+    // many words we need
+    memcpy(hw->bram_map, words, sizeof(uint32_t) * map_words(w, h));
+}
+
+void hw_kick(hw * hw, const coord * start)
+{
+    uint32_t ctrl = CTRL_RUN | CTRL_LD |
+                    (start->y & CTRL_Y_MASK) << CTRL_Y_SHF |
+                    (start->x & CTRL_X_MASK) << CTRL_X_SHF;
+    *hw->ctrl = ctrl;
+    if (hw->run != NULL)
+        hw->run(hw->fabric);
+}
+
+void hw_recv(hw * hw, uint32_t * words, int w, int h)
+{
+    memcpy(words, hw->bram_dir, sizeof(uint32_t) * map_words(w, h));
+}
+
+void hw_cycles(hw * hw, prof * prof)
+{
+    prof->ld_cycles += hw->ctrl[CTRL_CNT_LD];
+    prof->run_cycles += hw->ctrl[CTRL_CNT_RUN];
+    prof->st_cycles += hw->ctrl[CTRL_CNT_ST];
+}
+
+void hw_spin(hw * hw)
+{
+    int loops = 0;
+    while (hw_busy(hw)) {
+        // an emulated fabric may be waiting for this CPU
+        if (hw->run != NULL)
+            sched_yield();
+        ++loops;
+    }
+    //printf("poll loops: %d\n", loops);
+}
+
+void hw_wait(hw * hw, prof * prof)
+{
+    if (hw->w == 0)
+        return;
+
+    prof_start(prof);
+    #if defined(INTERRUPT)
+    sig_wait();
+    #else
+    // poll
+    hw_spin(hw);
+    #endif
+    prof_end(prof); prof->exec += prof_dt(prof);
+
+    hw_cycles(hw, prof);
+}
+
+void hw_fetch(hw * hw, path * path, prof * prof)
+{
+    if (hw->w == 0) {
+        path_ctor(path);
+        return;
+    }
+
+    if (hw->direct_rx) {
+        // following the directions is the transfer
+        prof_start(prof);
+        hw_gen_path(hw->side, hw->side, &hw->start, &hw->end, hw->bram_dir,
+                    path);
+        prof_end(prof); prof->rx += prof_dt(prof);
+        return;
+    }
+
+    // transfer back
+    prof_start(prof);
+    hw_recv(hw, hw->buffer, hw->side, hw->side);
+    prof_end(prof); prof->rx += prof_dt(prof);
+    prof_start(prof);
+    hw_gen_path(hw->side, hw->side, &hw->start, &hw->end, hw->buffer, path);
+    // or load the path: slower
+    // path_load(map, start, end, bram_dir, path);
+    prof_end(prof); prof->poproc += prof_dt(prof);
+}
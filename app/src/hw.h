@@ -0,0 +1,172 @@
+#ifndef __HW_H__
+#define __HW_H__
+
+// driver for the accelerator on the programmable logic
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <mem/mem.h>
+
+#include "map.h"
+#include "path.h"
+#include "world.h"
+#include "prof.h"
+
+// wait for the accelerator's interrupt (kmod/) instead of polling
+//#define INTERRUPT
+
+// physical addresses of the accelerator's BRAM (map weights, then the
+// direction nibbles it writes back) and of its control registers
+#define HW_BRAM_MAP 0x40000000
+#define HW_BRAM_DIR 0x40001000
+#define HW_BRAM_END 0x40001fff
+#define HW_CTRL     0x40004000
+#define HW_CTRL_END 0x40004fff
+
+// the fabric as the bitstream builds it: DIM and COST_SIZE of the fabric
+// instance in vivado/dkstra_last_v1_0.v. larger maps are routed in software
+#define FABRIC_DIM 28
+#define FABRIC_COST_SIZE 9
+
+// the way each direction nibble the fabric writes back points, toward the
+// node's parent: the node looked at that neighbour on that clock
+static const int hw_dirs[8][2] =
+{
+    { 0,-1},// north
+    { 1,-1},// northeast
+    { 1, 0},// east
+    { 1, 1},// southeast
+    { 0, 1},// south
+    {-1, 1},// southwest
+    {-1, 0},// west
+    {-1,-1},// northwest
+};
+
+// control register: run and load bits and the start coordinates. the fabric
+// clears run once the directions are in BRAM; the words after it count the
+// cycles it spent loading the map, relaxing it and storing the directions
+#define CTRL_RUN (1 << 31)
+#define CTRL_LD  (1 << 30)
+#define CTRL_X_MASK (0x1F)
+#define CTRL_Y_MASK (0x1F)
+#define CTRL_Y_SHF (5)
+#define CTRL_X_SHF (0)
+#define CTRL_CNT_LD  1
+#define CTRL_CNT_RUN 2
+#define CTRL_CNT_ST  3
+
+// what moving a whole map through BRAM took, each way, when the driver
+// started: packing it into the host buffer and copying that, against
+// packing it straight into BRAM; copying the directions back and following
+// them, against following them in BRAM. the driver goes the faster way
+typedef struct hw_io_
+{
+    uint64_t bounce_tx;
+    uint64_t direct_tx;
+    uint64_t bounce_rx;
+    uint64_t direct_rx;
+} hw_io;
+
+// the accelerator's BRAM and control registers, mapped once and kept for
+// as many queries as the caller runs, with the staging buffers of the
+// query in flight
+typedef struct hw_
+{
+    mem_context mem_bram;
+    mem_context mem_ctrl;
+    uint32_t * bram_map;
+    uint32_t * bram_dir;
+    volatile uint32_t * ctrl;
+    uint32_t * buffer;      // map words going out, directions coming back
+    int side;               // largest map side the fabric takes
+    bool mapped;            // false over memory that is not the board's
+    void (*run)(void * fabric); // rings a fabric that is not the board, or NULL
+    void * fabric;
+    hw_io io;
+    bool calibrated;        // io has been measured
+    bool direct_tx;         // pack maps straight into BRAM
+    bool direct_rx;         // follow directions in BRAM
+    int w;                  // map of the query in flight
+    int h;
+    coord start;
+    coord end;
+} hw;
+
+// neither touches BRAM: the ways in and out of it are timed on the first
+// hw_submit (hw_prepare), so commands that only read or write BRAM find it
+// as they left it. returns 0 on success
+int hw_ctor(hw * hw);
+// the same driver over BRAM and control registers somewhere else, such as
+// those of an emulated fabric (emu.h) of the given side. hw_kick calls run
+// on fabric once the control register is written
+void hw_ctor_mem(hw * hw, uint32_t * bram, volatile uint32_t * ctrl, int side,
+                 void (*run)(void * fabric), void * fabric);
+void hw_dtor(hw * hw);
+
+static inline
+bool hw_fits(const hw * hw, const map * map)
+{
+    return map->w <= hw->side && map->h <= hw->side;
+}
+
+// the steps of a query, for callers that schedule them themselves (hwpipe.h).
+// words are a w x h map in the BRAM layout going out, or the directions
+// coming back; none of these are timed
+void hw_send(hw * hw, const uint32_t * words, int w, int h);
+// start the fabric on the map in BRAM from start
+void hw_kick(hw * hw, const coord * start);
+void hw_recv(hw * hw, uint32_t * words, int w, int h);
+// fill hw->io, overwriting BRAM, and pick the faster ways from it
+void hw_calibrate(hw * hw);
+// hw_calibrate unless it has been already
+void hw_prepare(hw * hw);
+// add the cycles the fabric counted for the last query to prof
+void hw_cycles(hw * hw, prof * prof);
+// poll until the fabric is done
+void hw_spin(hw * hw);
+
+// whether the fabric is still on the query last started; once it is not,
+// its directions are in BRAM
+static inline
+bool hw_busy(const hw * hw)
+{
+    if (*hw->ctrl & CTRL_RUN)
+        return true;
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return false;
+}
+
+// load the map and start routing from start; returns 1 if the map does not
+// fit the fabric. a smaller map is walled off in a corner of it
+int hw_submit(hw * hw, const map * map, const coord * start, const coord * end,
+              prof * prof);
+// block until the fabric is done, and add the cycles it counted to prof
+void hw_wait(hw * hw, prof * prof);
+// read the directions back and follow them from end to start
+void hw_fetch(hw * hw, path * path, prof * prof);
+
+// map weights in the accelerator's BRAM layout: one nibble per cell, 8 cells
+// per word, in row-major order
+void convert_map(const map * map, uint32_t * buffer);
+// the same for a map no larger than a side x side fabric, whose BRAM rows
+// are side cells long whatever the map's width: the map is put in the top
+// left corner with walls around it
+void convert_window(const map * map, int side, uint32_t * buffer);
+// follow the direction nibbles in buffer back from end to start
+void hw_gen_path(int w, int h, const coord * start, const coord * end,
+                 const uint32_t * buffer, path * path);
+
+#ifdef INTERRUPT
+int sig_init(void);
+void sig_done(void);
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif//__HW_H__
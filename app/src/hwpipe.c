@@ -0,0 +1,125 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include "map.h"
+#include "path.h"
+#include "world.h"
+#include "prof.h"
+#include "batch.h"
+#include "hw.h"
+#include "hwpipe.h"
+
+// Pipelined accelerator batches
+//
+// hw_submit, hw_wait and hw_fetch leave the host idle while the fabric runs
+// and the fabric idle while the host packs maps and follows directions. In
+// a batch, query i's turn is: start the fabric on it, decode query i-1 from
+// the other buffer, pack query i+1 into that buffer, then wait for the
+// fabric, read query i's directions back over its map and send query i+1.
+// Only the transfers and the control register are left between two runs.
+//
+// A host step counts as overlapped if the fabric is still busy once it is
+// done, which undercounts a step the fabric finishes in the middle of.
+
+void hwpipe_ctor(hwpipe * pipe, hw * hw)
+{
+    size_t words = map_words(hw->side, hw->side);
+    pipe->hw = hw;
+    pipe->buffer[0] = (uint32_t *) malloc(sizeof(uint32_t) * words);
+    pipe->buffer[1] = (uint32_t *) malloc(sizeof(uint32_t) * words);
+}
+
+void hwpipe_dtor(hwpipe * pipe)
+{
+    free(pipe->buffer[0]);
+    free(pipe->buffer[1]);
+}
+
+// a host step has just ended: count it as overlapped if the fabric is
+// still running
+static inline
+void host_step(hwpipe * pipe, bool running, uint64_t dt, prof * prof)
+{
+    if (running && hw_busy(pipe->hw))
+        prof->overlap += dt;
+}
+
+void hwpipe_solve(hwpipe * pipe, const query * queries, int count,
+                  path * paths, prof * prof)
+{
+    hw * hw = pipe->hw;
+    prof_ctor(prof);
+    if (count <= 0)
+        return;
+
+    prof_start(prof);
+    const map * first = queries[0].map;
+    if (hw_fits(hw, first))
+        convert_window(first, hw->side, pipe->buffer[0]);
+    prof_end(prof); prof->prproc += prof_dt(prof);
+
+    prof_start(prof);
+    if (hw_fits(hw, first))
+        hw_send(hw, pipe->buffer[0], hw->side, hw->side);
+    prof_end(prof); prof->tx += prof_dt(prof);
+
+    for (int i = 0; i < count; ++i) {
+        const query * q = &queries[i];
+        uint32_t * own = pipe->buffer[i & 1];
+        uint32_t * other = pipe->buffer[(i + 1) & 1];
+        bool running = hw_fits(hw, q->map);
+
+        prof_start(prof);
+        if (running)
+            hw_kick(hw, &q->start);
+        prof_end(prof); prof->exec += prof_dt(prof);
+
+        if (i > 0) {
+            const query * last = &queries[i - 1];
+            prof_start(prof);
+            if (hw_fits(hw, last->map))
+                hw_gen_path(hw->side, hw->side, &last->start, &last->end,
+                            other, &paths[i - 1]);
+            else
+                path_ctor(&paths[i - 1]);
+            prof_end(prof); prof->poproc += prof_dt(prof);
+            host_step(pipe, running, prof_dt(prof), prof);
+        }
+
+        const query * next = i + 1 < count ? &queries[i + 1] : NULL;
+        if (next != NULL && hw_fits(hw, next->map)) {
+            prof_start(prof);
+            convert_window(next->map, hw->side, other);
+            prof_end(prof); prof->prproc += prof_dt(prof);
+            host_step(pipe, running, prof_dt(prof), prof);
+        }
+
+        if (running) {
+            prof_start(prof);
+            hw_spin(hw);
+            prof_end(prof); prof->exec += prof_dt(prof);
+            hw_cycles(hw, prof);
+
+            prof_start(prof);
+            hw_recv(hw, own, hw->side, hw->side);
+            prof_end(prof); prof->rx += prof_dt(prof);
+        }
+
+        if (next != NULL && hw_fits(hw, next->map)) {
+            prof_start(prof);
+            hw_send(hw, other, hw->side, hw->side);
+            prof_end(prof); prof->tx += prof_dt(prof);
+        }
+    }
+
+    const query * last = &queries[count - 1];
+    prof_start(prof);
+    if (hw_fits(hw, last->map))
+        hw_gen_path(hw->side, hw->side, &last->start, &last->end,
+                    pipe->buffer[(count - 1) & 1], &paths[count - 1]);
+    else
+        path_ctor(&paths[count - 1]);
+    prof_end(prof); prof->poproc += prof_dt(prof);
+}
@@ -0,0 +1,44 @@
+#ifndef __HWPIPE_H__
+#define __HWPIPE_H__
+
+// batches of queries streamed through the accelerator
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+#include "map.h"
+#include "path.h"
+#include "world.h"
+#include "prof.h"
+#include "batch.h"
+#include "hw.h"
+
+// two host buffers taking turns: while the fabric runs one query, the
+// other buffer is decoded into the path of the query before it and then
+// packed with the map of the query after it. a buffer holds its query's
+// map on the way out and the same query's directions on the way back
+typedef struct hwpipe_
+{
+    hw * hw;
+    uint32_t * buffer[2];
+} hwpipe;
+
+void hwpipe_ctor(hwpipe * pipe, hw * hw);
+void hwpipe_dtor(hwpipe * pipe);
+
+// solves queries[i] into paths[i]; the paths are constructed here and the
+// caller destroys them, and a query whose map does not fit the fabric gets
+// an empty one. prof times packing as prproc, decoding as poproc and the
+// waits on the fabric as exec, so that they add up to the whole batch, and
+// prof->overlap is the part of prproc and poproc done with the fabric busy
+void hwpipe_solve(hwpipe * pipe, const query * queries, int count,
+                  path * paths, prof * prof);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif//__HWPIPE_H__
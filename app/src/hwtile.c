@@ -0,0 +1,420 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "map.h"
+#include "path.h"
+#include "world.h"
+#include "prof.h"
+#include "hw.h"
+#include "hwtile.h"
+
+// Tiled accelerator routes
+//
+// The map is cut into blocks, as few as keep the coarse map within the
+// fabric. A block's tile costs are averaged and scaled down, and its share
+// of walls added, to a cost of 0-3, so that crossing the whole coarse map
+// stays within the fabric's costs; only a block of nothing but walls is a
+// wall (unless the start or the end is in it). The fabric routes the
+// coarse map, and the guide is laid along the route from block centre to
+// block centre, with points no more than half a window apart.
+//
+// Then, from the start, each window is placed around the current cell and
+// the furthest guide point ahead that fits with it. The fabric routes the
+// window from the current cell, and the cost of every cell it reached is
+// read back from the directions. The route leaves the window by the cell
+// minimizing that cost plus an estimate of the rest of the way to the
+// guide point, of the cells closer to it than the current one; that keeps
+// each window making progress. A map that fits one window is a single
+// window, and its path is exactly the shortest: the fabric finds it when
+// its cost fits the fabric's 9-bit costs (FABRIC_COST_SIZE), and when it
+// does not the end goes unreached and A* routes the map in software.
+
+#define COST_UNSET (UINT32_MAX - 1)
+
+void hwtile_ctor(hwtile * tile, hw * hw)
+{
+    int side = hw->side;
+    int n = side * side;
+    tile->hw = hw;
+    tile->side = side;
+    tile->window.w = side;
+    tile->window.h = side;
+    tile->window.buffer = NULL;
+    tile->window.packed = (uint32_t *) calloc(map_words(side, side), sizeof(uint32_t));
+    tile->window.mapping = NULL;
+    tile->window.length = 0;
+    tile->window.tiles = NULL;
+    tile->window.hash = 0;
+    tile->cost = (uint32_t *) malloc(sizeof(uint32_t) * n);
+    tile->stack = (uint32_t *) malloc(sizeof(uint32_t) * n);
+    tile->sum = (uint32_t *) malloc(sizeof(uint32_t) * n);
+    tile->open = (uint32_t *) malloc(sizeof(uint32_t) * n);
+    tile->cells = (uint32_t *) malloc(sizeof(uint32_t) * n);
+    tile->guide = NULL;
+    tile->guides = 0;
+    tile->guide_cap = 0;
+    path_ctor(&tile->trail);
+}
+
+void hwtile_dtor(hwtile * tile)
+{
+    free(tile->window.packed);
+    free(tile->cost);
+    free(tile->stack);
+    free(tile->sum);
+    free(tile->open);
+    free(tile->cells);
+    free(tile->guide);
+    path_dtor(&tile->trail);
+}
+
+static inline
+int cheb(const coord * a, const coord * b)
+{
+    int dx = abs(a->x - b->x);
+    int dy = abs(a->y - b->y);
+    return dx > dy ? dx : dy;
+}
+
+// octile distance in half steps, as the fabric counts them
+static inline
+uint32_t octile(const coord * a, const coord * b)
+{
+    int dx = abs(a->x - b->x);
+    int dy = abs(a->y - b->y);
+    return dx > dy ? 2 * dx + dy : 2 * dy + dx;
+}
+
+static inline
+int clamp(int v, int lo, int hi)
+{
+    return v < lo ? lo : (v > hi ? hi : v);
+}
+
+static
+void guide_push(hwtile * tile, coord c)
+{
+    if (tile->guides == tile->guide_cap) {
+        tile->guide_cap = tile->guide_cap ? 2 * tile->guide_cap : 64;
+        tile->guide = (coord *) realloc(tile->guide, sizeof(coord) * tile->guide_cap);
+    }
+    tile->guide[tile->guides++] = c;
+}
+
+// points on the way from the last guide point to b, step apart at most
+static
+void guide_line(hwtile * tile, coord b, int step)
+{
+    coord a = tile->guide[tile->guides - 1];
+    int steps = (cheb(&a, &b) + step - 1) / step;
+    for (int i = 1; i <= steps; ++i) {
+        coord c = {.x = a.x + (b.x - a.x) * i / steps,
+                   .y = a.y + (b.y - a.y) * i / steps};
+        guide_push(tile, c);
+    }
+}
+
+// push a move onto the path stack, merging it into the top one if it goes
+// the same way
+static
+void trail_push(path * path, const movement * move)
+{
+    if (vector_size(&path->moves) > 0) {
+        movement * top = (movement *) vector_backp(&path->moves);
+        if (top->x_dir == move->x_dir && top->y_dir == move->y_dir) {
+            top->count += move->count;
+            return;
+        }
+    }
+    vector_push_back(&path->moves, move);
+}
+
+// the trail runs the other way from a path: append seg first move first
+static
+void trail_append(hwtile * tile, const path * seg)
+{
+    for (int i = vector_size(&seg->moves) - 1; i >= 0; --i) {
+        movement move;
+        vector_get(&seg->moves, i, &move);
+        trail_push(&tile->trail, &move);
+    }
+}
+
+// route the fabric's map, leaving its directions in hw->buffer: every
+// cell's is read, so they are copied back even where paths are followed
+// in BRAM
+static
+void window_run(hwtile * tile, const coord * start, const coord * end,
+                path * path, prof * prof)
+{
+    // calibrated first, or hw_submit would pick direct_rx over ours
+    hw_prepare(tile->hw);
+    bool direct = tile->hw->direct_rx;
+    tile->hw->direct_rx = false;
+    hw_submit(tile->hw, &tile->window, start, end, prof);
+    hw_wait(tile->hw, prof);
+    hw_fetch(tile->hw, path, prof);
+    tile->hw->direct_rx = direct;
+    prof->windows += 1;
+}
+
+// lays the guide from start to end along the coarse route
+static
+void coarse_route(hwtile * tile, const map * map, const coord * start,
+                  const coord * end, prof * prof)
+{
+    int side = tile->side;
+    int n = side * side;
+    int big = map->w > map->h ? map->w : map->h;
+    int b = (big + side - 1) / side;
+    int step = side / 2;
+
+    tile->guides = 0;
+    guide_push(tile, *start);
+    if (b == 1) {
+        guide_line(tile, *end, step);
+        return;
+    }
+
+    prof_start(prof);
+    coord cs = {.x = start->x / b, .y = start->y / b};
+    coord ce = {.x = end->x / b, .y = end->y / b};
+    memset(tile->sum, 0, sizeof(uint32_t) * n);
+    memset(tile->open, 0, sizeof(uint32_t) * n);
+    memset(tile->cells, 0, sizeof(uint32_t) * n);
+    for (int y = 0; y < map->h; ++y) {
+        for (int x = 0; x < map->w; ++x) {
+            int k = x / b + (y / b) * side;
+            uint8_t c = map_cost(map, x, y);
+            tile->cells[k] += 1;
+            if (c != MAP_WALL) {
+                tile->open[k] += 1;
+                tile->sum[k] += c;
+            }
+        }
+    }
+    for (int k = 0; k < n; ++k) {
+        bool ends = k == cs.x + cs.y * side || k == ce.x + ce.y * side;
+        uint32_t open = tile->open[k];
+        uint8_t c = MAP_WALL;
+        if (ends && open == 0)
+            c = 0;
+        else if (open > 0) {
+            // walls in a block make crossing it longer, but rarely block it
+            uint32_t walls = tile->cells[k] - open;
+            c = (tile->sum[k] * 3 + open * 7) / (open * 14) +
+                4 * walls / tile->cells[k];
+            c = c > 3 ? 3 : c;
+        }
+        map_put_nibble(&tile->window, k % side, k / side, c);
+    }
+    prof_end(prof); prof->prproc += prof_dt(prof);
+
+    path coarse;
+    window_run(tile, &cs, &ce, &coarse, prof);
+    coord c = cs;
+    for (int i = vector_size(&coarse.moves) - 1; i >= 0; --i) {
+        movement move;
+        vector_get(&coarse.moves, i, &move);
+        for (int j = 0; j < move.count; ++j) {
+            c.x += move.x_dir;
+            c.y += move.y_dir;
+            if (c.x == ce.x && c.y == ce.y)
+                break;
+            coord centre = {.x = clamp(c.x * b + b / 2, 0, map->w - 1),
+                            .y = clamp(c.y * b + b / 2, 0, map->h - 1)};
+            guide_line(tile, centre, step);
+        }
+    }
+    path_dtor(&coarse);
+    // a coarse map with no route leaves a straight guide
+    guide_line(tile, *end, step);
+}
+
+// copies the window at (x0, y0) to the fabric's map, with walls off the
+// map. returns the mean cost of its passable cells, in sixteenths
+static
+uint32_t window_load(hwtile * tile, const map * map, int x0, int y0)
+{
+    int side = tile->side;
+    uint32_t sum = 0;
+    uint32_t open = 0;
+    for (int y = 0; y < side; ++y) {
+        for (int x = 0; x < side; ++x) {
+            uint8_t c = MAP_WALL;
+            if (x0 + x < map->w && y0 + y < map->h)
+                c = map_cost(map, x0 + x, y0 + y);
+            if (c != MAP_WALL) {
+                sum += c;
+                open += 1;
+            }
+            map_put_nibble(&tile->window, x, y, c);
+        }
+    }
+    return open ? 16 * sum / open : 0;
+}
+
+// cost of every cell of the window the fabric reached from start, walking
+// its directions back to a cell already costed; UINT32_MAX where it did not
+static
+void window_costs(hwtile * tile, const coord * start)
+{
+    int side = tile->side;
+    int n = side * side;
+    const uint32_t * dirs = tile->hw->buffer;
+    uint32_t * cost = tile->cost;
+
+    for (int i = 0; i < n; ++i)
+        cost[i] = COST_UNSET;
+    cost[start->x + start->y * side] = 0;
+
+    for (int i = 0; i < n; ++i) {
+        int top = 0;
+        int j = i;
+        while (cost[j] == COST_UNSET) {
+            uint8_t d = (dirs[j >> 3] >> ((j & 7) * 4)) & 0xF;
+            if (!(d & 0x8) || top == n) {
+                cost[j] = UINT32_MAX;
+                break;
+            }
+            tile->stack[top++] = j;
+            j = (j % side + hw_dirs[d & 0x7][0]) +
+                (j / side + hw_dirs[d & 0x7][1]) * side;
+        }
+        uint32_t c = cost[j];
+        while (top > 0) {
+            int k = tile->stack[--top];
+            if (c != UINT32_MAX) {
+                uint8_t d = (dirs[k >> 3] >> ((k & 7) * 4)) & 0x7;
+                c += (hw_dirs[d][0] != 0 && hw_dirs[d][1] != 0) ? 0x3 : 0x2;
+                c += (uint32_t) map_nibble(&tile->window, k) << 1;
+            }
+            cost[k] = c;
+        }
+    }
+}
+
+// finishes the route from p in software. returns whether it found one
+static
+bool fallback(hwtile * tile, const map * map, const coord * p,
+              const coord * end, prof * prof)
+{
+    path seg;
+    struct prof_ local;
+    apath_find(NULL, map, p, end, &seg, &local);
+    // host work, so kept apart from the fabric's exec
+    prof->poproc += local.prproc + local.exec + local.poproc;
+    prof->expand += local.expand;
+    prof->fallbacks += 1;
+    bool found = vector_size(&seg.moves) > 0;
+    trail_append(tile, &seg);
+    path_dtor(&seg);
+    return found;
+}
+
+void hwtile_find(hwtile * tile, const map * map, const coord * start,
+                 const coord * end, path * path, prof * prof)
+{
+    int side = tile->side;
+    // a map that fits is one window. otherwise, how far ahead a window
+    // reaches, leaving room around both ends
+    bool whole = map->w <= side && map->h <= side;
+    int reach = whole ? side : side - 1 - side / 4;
+
+    prof_ctor(prof);
+    path_ctor(path);
+    path_dtor(&tile->trail);
+    path_ctor(&tile->trail);
+
+    coarse_route(tile, map, start, end, prof);
+
+    coord p = *start;
+    idx_t k = 0;
+    // every window gets closer to its guide point, so this is only a guard
+    idx_t limit = 4 * tile->guides + 16;
+    bool found = true;
+    while (!(p.x == end->x && p.y == end->y)) {
+        if (limit-- == 0) {
+            found = fallback(tile, map, &p, end, prof);
+            break;
+        }
+
+        idx_t j = k + 1;
+        while (j + 1 < tile->guides && cheb(&tile->guide[j + 1], &p) <= reach)
+            ++j;
+        coord g = tile->guide[j];
+        coord t = {.x = p.x + clamp(g.x - p.x, -reach, reach),
+                   .y = p.y + clamp(g.y - p.y, -reach, reach)};
+
+        prof_start(prof);
+        int x0 = clamp((p.x + t.x) / 2 - side / 2, 0,
+                       map->w > side ? map->w - side : 0);
+        int y0 = clamp((p.y + t.y) / 2 - side / 2, 0,
+                       map->h > side ? map->h - side : 0);
+        uint32_t mean = window_load(tile, map, x0, y0);
+        coord lp = {.x = p.x - x0, .y = p.y - y0};
+        coord lt = {.x = t.x - x0, .y = t.y - y0};
+        prof_end(prof); prof->prproc += prof_dt(prof);
+
+        struct path_ seg;
+        window_run(tile, &lp, &lt, &seg, prof);
+
+        prof_start(prof);
+        window_costs(tile, &lp);
+        // the guide point if the window got there, or else the cell that
+        // looks cheapest to carry on from, of those closer to it than p
+        int best = -1;
+        if (t.x == g.x && t.y == g.y &&
+            tile->cost[lt.x + lt.y * side] != UINT32_MAX)
+            best = lt.x + lt.y * side;
+        else if (!whole) {
+            uint32_t near = octile(&p, &g);
+            uint64_t best_f = UINT64_MAX;
+            for (int i = 0; i < side * side; ++i) {
+                if (tile->cost[i] == UINT32_MAX)
+                    continue;
+                coord c = {.x = x0 + i % side, .y = y0 + i / side};
+                uint32_t d = octile(&c, &g);
+                if (d >= near)
+                    continue;
+                uint64_t f = tile->cost[i] + d +
+                             2 * (uint64_t) mean * cheb(&c, &g) / 16;
+                if (f < best_f) {
+                    best_f = f;
+                    best = i;
+                }
+            }
+        }
+        coord lc = {.x = best % side, .y = best / side};
+        if (best >= 0 && (lc.x != lt.x || lc.y != lt.y)) {
+            path_dtor(&seg);
+            hw_gen_path(side, side, &lp, &lc, tile->hw->buffer, &seg);
+        }
+        prof_end(prof); prof->poproc += prof_dt(prof);
+
+        if (best < 0) {
+            path_dtor(&seg);
+            found = fallback(tile, map, &p, end, prof);
+            break;
+        }
+        trail_append(tile, &seg);
+        path_dtor(&seg);
+        p.x = x0 + lc.x;
+        p.y = y0 + lc.y;
+        if (p.x == g.x && p.y == g.y)
+            k = j;
+    }
+
+    prof_start(prof);
+    if (found) {
+        for (int i = vector_size(&tile->trail.moves) - 1; i >= 0; --i) {
+            movement move;
+            vector_get(&tile->trail.moves, i, &move);
+            trail_push(path, &move);
+        }
+    }
+    prof_end(prof); prof->poproc += prof_dt(prof);
+}
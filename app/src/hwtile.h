@@ -0,0 +1,52 @@
+#ifndef __HWTILE_H__
+#define __HWTILE_H__
+
+// maps larger than the accelerator's fabric, routed through windows of it
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+#include "map.h"
+#include "path.h"
+#include "world.h"
+#include "prof.h"
+#include "hw.h"
+
+// the fabric only ever starts from one node at cost 0, so windows cannot be
+// seeded with the costs of their neighbours. instead a coarse route is
+// found first, on the fabric itself, over the map shrunk to one cell per
+// block; then windows the size of the fabric walk along it, each leaving
+// by the cell that looks cheapest to carry on from. paths are close to, but
+// not always, the shortest. where no window gets any closer the rest of
+// the route is found in software, which also finds maps with no route
+typedef struct hwtile_
+{
+    hw * hw;                    // driver of the fabric the windows run on
+    int side;                   // the fabric's side
+    map window;                 // packed side x side map sent to the fabric
+    uint32_t * cost;            // costs in the last window, from its start
+    uint32_t * stack;           // cells waiting for their cost
+    uint32_t * sum;             // per block of the coarse map: tile costs,
+    uint32_t * open;            // passable cells
+    uint32_t * cells;           // and cells
+    coord * guide;              // points along the coarse route
+    idx_t guides;
+    idx_t guide_cap;
+    path trail;                 // moves so far, the first one at the bottom
+} hwtile;
+
+void hwtile_ctor(hwtile * tile, hw * hw);
+void hwtile_dtor(hwtile * tile);
+
+// prof->windows counts the fabric runs, the coarse one included
+void hwtile_find(hwtile * tile, const map * map, const coord * start,
+                 const coord * end, path * path, prof * prof);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif//__HWTILE_H__
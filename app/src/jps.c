@@ -0,0 +1,215 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include "map.h"
+#include "path.h"
+#include "world.h"
+#include "graph.h"
+#include "heap.h"
+
+//#define dprintf(...) fprintf(stderr, __VA_ARGS__)
+#define dprintf(str, ...)
+
+// Jump Point Search
+//
+// The pruning rules are the corner-cutting JPS rules generalized to tile
+// costs. Moving from p onto x, a neighbor m of x is pruned if p reaches m
+// around x for no more than through it (strictly less for diagonal moves).
+// Every move into m pays m's tile cost on both routes, so this only compares
+// x against the cell the detour passes through:
+// - straight moves: the forward diagonal m beside side cell s is forced
+//   unless s is passable and costs no more than x
+// - diagonal moves: the cell m at 90 degrees from the direction of travel,
+//   beside cell b behind x, is forced unless b is passable and costs no more
+//   than x
+// With a single tile type this reduces to plain JPS, so open regions are
+// crossed in single jumps. Cost changes along a jump simply add up.
+//
+// Only jump points get a direction during the search. Once the end is
+// settled the segments along its path are filled in cell by cell so
+// gen_path can follow them like any other engine's output.
+
+// tile cost of (x, y), or -1 if it is out of bounds or impassable
+static inline
+int32_t cell_cost(const map * map, int x, int y)
+{
+    if (x < 0 || x >= map->w || y < 0 || y >= map->h)
+        return -1;
+
+    int32_t c = tile_cost(map, x, y);
+    return c == (int32_t) 0xDEADBEEF ? -1 : c;
+}
+
+// mask of forced neighbor directions of (x, y) when entered along dirs[d]
+static inline
+uint8_t forced(const map * map, int x, int y, int d)
+{
+    int32_t c = cell_cost(map, x, y);
+    uint8_t mask = 0;
+    for (int k = -1; k <= 1; k += 2) {
+        // straight moves: side cell d + 2k guards forward diagonal d + k
+        // diagonal moves: rear cell d + 3k guards side cell d + 2k
+        int guard = (d & 1) ? (d + 2 * k) & 7 : (d + 3 * k) & 7;
+        int m = (d & 1) ? (d + k) & 7 : (d + 2 * k) & 7;
+        if (cell_cost(map, x + dirs[m][0], y + dirs[m][1]) < 0)
+            continue;
+        int32_t g = cell_cost(map, x + dirs[guard][0], y + dirs[guard][1]);
+        if (g < 0 || g > c)
+            mask |= 1 << m;
+    }
+    return mask;
+}
+
+// natural neighbor directions when travelling along dirs[d]: straight
+// moves continue, diagonals also fan out into their straight components
+static inline
+uint8_t natural(int d)
+{
+    if (d & 1)
+        return 1 << d;
+    return 1 << d | 1 << ((d + 7) & 7) | 1 << ((d + 1) & 7);
+}
+
+// step from (x, y) along dirs[d] until reaching a jump point; returns its
+// node index or -1 if the jump runs into a wall, adding the cost of every
+// step taken to cost
+static
+idx_t jump(const map * map, const coord * goal, int x, int y, int d, cost_t * cost)
+{
+    for (;;) {
+        x += dirs[d][0];
+        y += dirs[d][1];
+
+        int32_t c = cell_cost(map, x, y);
+        if (c < 0)
+            return -1;
+        *cost += dirs[d][2] + (c << 1);
+
+        if ((x == goal->x && y == goal->y) || forced(map, x, y, d))
+            return x + (idx_t) map->w * y;
+
+        // diagonals (even entries of dirs) stop where either of their
+        // straight components would find a jump point
+        if (!(d & 1)) {
+            cost_t straight = 0;
+            if (jump(map, goal, x, y, (d + 7) & 7, &straight) >= 0 ||
+                jump(map, goal, x, y, (d + 1) & 7, &straight) >= 0)
+                return x + (idx_t) map->w * y;
+        }
+    }
+}
+
+// fill in the cells skipped by jumps on the path from goal back to start.
+// every prefix of a shortest path is itself shortest, so walking back from a
+// jump point the running cost meets a settled node of exactly that cost at
+// the latest at the jump point the segment started from
+static
+void fill_path(const map * map, graph * graph, const coord * start, const coord * goal)
+{
+    idx_t n = graph_idx(graph, goal->x, goal->y);
+    idx_t s = graph_idx(graph, start->x, start->y);
+    graph_touch(graph, n);
+    if (!bit_get(graph->visit, n))
+        return;
+
+    while (n != s) {
+        uint8_t d = graph->dir[n] & 0x7;
+        cost_t cost = graph->cost[n];
+        int x = n % graph->w;
+        int y = n / graph->w;
+        for (;;) {
+            cost -= ((acceldirs[d][0] && acceldirs[d][1]) ? 0x3 : 0x2) +
+                    (tile_cost(map, x, y) << 1);
+            x += acceldirs[d][0];
+            y += acceldirs[d][1];
+
+            idx_t p = graph_idx(graph, x, y);
+            graph_touch(graph, p);
+            if (bit_get(graph->visit, p) && graph->cost[p] == cost) {
+                n = p;
+                break;
+            }
+            graph->cost[p] = cost;
+            graph->dir[p] = DIR_VALID | d;
+        }
+    }
+}
+
+static
+void jps_search(const map * map, graph * graph, heap * heap,
+                const coord * start, const coord * goal, prof * prof)
+{
+    idx_t idx = graph_idx(graph, start->x, start->y);
+    graph_touch(graph, idx);
+    graph->cost[idx] = 0;
+    heap_push(heap, idx, octile(start, goal));
+
+    while (heap_pop(heap, &idx)) {
+        prof->expand += 1;
+        coord curr = {.x = idx % graph->w, .y = idx / graph->w};
+        bit_set(graph->visit, idx);
+        dprintf("curr: (%d, %d)\n", curr.x, curr.y);
+        if (curr.x == goal->x && curr.y == goal->y)
+            break;
+
+        // successors: all 8 directions from the start, otherwise the
+        // natural and forced neighbors of the direction of travel
+        uint8_t mask = 0xFF;
+        if (graph->dir[idx] & DIR_VALID) {
+            // the stored nibble points back to the parent: reverse it
+            int t = ((graph->dir[idx] & 0x7) + 5) & 7;
+            mask = natural(t) | forced(map, curr.x, curr.y, t);
+        }
+
+        for (int i = 0; i < 8; i += 1) {
+            if (!(mask & (1 << i)))
+                continue;
+
+            cost_t cost = graph->cost[idx];
+            idx_t n = jump(map, goal, curr.x, curr.y, i, &cost);
+            if (n < 0)
+                continue;
+
+            graph_touch(graph, n);
+            if (bit_get(graph->visit, n))
+                continue;
+
+            if (cost < graph->cost[n]) {
+                coord next = {.x = n % graph->w, .y = n / graph->w};
+                graph->cost[n] = cost;
+                graph->dir[n] = dir_codes[(i + 4) & 7];
+                heap_push(heap, n, cost + octile(&next, goal));
+            }
+        }
+    }
+}
+
+// JPS: A* that only queues jump points, then fills in the skipped cells
+void jpath_find(search * search, const map * map, const coord * start,
+                const coord * end, path * path, prof * prof)
+{
+    struct search_ scratch;
+    heap heap;
+    graph graph;
+
+    prof_ctor(prof);
+
+    prof_start(prof);
+    path_ctor(path);
+    search = search_acquire(search, &scratch, map);
+    gen_graph(&graph, search);
+    heap_ctor(&heap, search);
+    prof_end(prof); prof->prproc = prof_dt(prof);
+
+    prof_start(prof);
+    jps_search(map, &graph, &heap, start, end, prof);
+    prof_end(prof); prof->exec = prof_dt(prof);
+
+    prof_start(prof);
+    fill_path(map, &graph, start, end);
+    gen_path(&graph, start, end, path);
+    heap_dtor(&heap);
+    search_release(search, &scratch);
+    prof_end(prof); prof->poproc = prof_dt(prof);
+}
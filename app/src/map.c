@@ -1,6 +1,188 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include "map.h"
+#include "tiles.h"
+
+extern const int32_t cost_table[128];
+
+static inline
+uint8_t char_nibble(char c)
+{
+    int32_t cost = cost_table[(unsigned char) c];
+    return cost == (int32_t) 0xDEADBEEF ? MAP_WALL : cost & 0xF;
+}
+
+// cost nibble of (x, y) on any kind of map
+static inline
+uint8_t cell_nibble(const map * map, int x, int y)
+{
+    if (map->tiles)
+        return tstore_nibble(map->tiles, x, y);
+    if (map->packed)
+        return map_nibble(map, x + (int64_t) map->w * y);
+    return char_nibble(map_get(map, x, y));
+}
+
+static inline
+size_t map_bytes(int encoding, int w, int h)
+{
+    size_t n = (size_t) w * h;
+    if (encoding == MAP_PACKED)
+        return sizeof(uint32_t) * ((n + 7) / 8);
+    return n;
+}
+
+int map_open(map * map, const char * file_name, int verify)
+{
+    int fd = open(file_name, O_RDONLY);
+    if (fd < 0)
+        return 1;
+
+    struct stat st;
+    if (fstat(fd, &st) || (size_t) st.st_size < MAP_DATA) {
+        close(fd);
+        return 1;
+    }
+
+    size_t length = st.st_size;
+    void * mapping = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED)
+        return 1;
+
+    const map_header * header = (const map_header *) mapping;
+    if (header->magic != MAP_MAGIC || header->version != MAP_VERSION ||
+        header->encoding > MAP_PACKED || header->w <= 0 || header->h <= 0 ||
+        MAP_DATA + map_bytes(header->encoding, header->w, header->h) > length) {
+        munmap(mapping, length);
+        return 1;
+    }
+
+    char * data = (char *) mapping + MAP_DATA;
+    map->w = header->w;
+    map->h = header->h;
+    map->buffer = header->encoding == MAP_CHARS ? data : NULL;
+    map->packed = header->encoding == MAP_PACKED ? (uint32_t *) data : NULL;
+    map->mapping = mapping;
+    map->length = length;
+    map->tiles = NULL;
+    map->hash = 0;
+
+    if (verify && map_hash(map) != header->checksum) {
+        munmap(mapping, length);
+        return 1;
+    }
+    return 0;
+}
+
+int map_save(const map * map, const char * file_name)
+{
+    if (map->tiles)
+        return 1;
+
+    FILE * file = fopen(file_name, "wb");
+    if (file == NULL)
+        return 1;
+
+    char header[MAP_DATA] = {0};
+    map_header * h = (map_header *) header;
+    h->magic = MAP_MAGIC;
+    h->version = MAP_VERSION;
+    h->encoding = map->packed ? MAP_PACKED : MAP_CHARS;
+    h->w = map->w;
+    h->h = map->h;
+    h->checksum = map_hash(map);
+
+    const void * data = map->packed ? (const void *) map->packed : map->buffer;
+    size_t bytes = map_bytes(h->encoding, map->w, map->h);
+    int err = fwrite(header, 1, MAP_DATA, file) != MAP_DATA ||
+              fwrite(data, 1, bytes, file) != bytes;
+    err |= fclose(file) != 0;
+    return err;
+}
+
+int map_open_tiled(map * map, const char * file_name, size_t budget)
+{
+    tstore * ts = (tstore *) malloc(sizeof(tstore));
+    if (tstore_open(ts, file_name, budget)) {
+        free(ts);
+        return 1;
+    }
+
+    map->w = ts->w;
+    map->h = ts->h;
+    map->buffer = NULL;
+    map->packed = NULL;
+    map->mapping = NULL;
+    map->tiles = ts;
+    map->hash = 0;
+    return 0;
+}
+
+static
+int map_rows(void * ctx, uint8_t * costs, int y0, int rows)
+{
+    const map * map = (const struct map_ *) ctx;
+    for (int y = 0; y < rows; ++y) {
+        for (int x = 0; x < map->w; ++x)
+            costs[(size_t) map->w * y + x] = cell_nibble(map, x, y0 + y);
+    }
+    return 0;
+}
+
+int map_save_tiled(const map * map, const char * file_name, int side)
+{
+    return tstore_write(file_name, map->w, map->h, side, map_rows, (void *) map);
+}
+
+typedef struct text_rows_
+{
+    FILE * file;
+    int w;
+    char * line;
+} text_rows;
+
+static
+int read_text_rows(void * ctx, uint8_t * costs, int y0, int rows)
+{
+    text_rows * tr = (text_rows *) ctx;
+    for (int y = 0; y < rows; ++y) {
+        // the line and then its newline, as map_load reads them
+        if (fgets(tr->line, tr->w + 1, tr->file) == NULL)
+            return 1;
+        for (int x = 0; x < tr->w; ++x)
+            costs[(size_t) tr->w * y + x] = char_nibble(tr->line[x]);
+        fgets(tr->line, tr->w + 1, tr->file);
+    }
+    return 0;
+}
+
+int map_convert_tiled(const char * text_name, const char * file_name, int side)
+{
+    FILE * file = fopen(text_name, "r");
+    if (file == NULL)
+        return 1;
+
+    char buf[64];
+    int w = 0, h = 0;
+    if (fgets(buf, sizeof(buf), file) == NULL ||
+        sscanf(buf, "%d %d", &h, &w) != 2 || w <= 0 || h <= 0) {
+        fclose(file);
+        return 1;
+    }
+
+    text_rows tr = {.file = file, .w = w};
+    tr.line = (char *) malloc(sizeof(char) * w + 1);
+    int err = tstore_write(file_name, w, h, side, read_text_rows, &tr);
+    free(tr.line);
+    fclose(file);
+    return err;
+}
 
 int map_load(map * map, const char * file_name)
 {
@@ -9,9 +191,24 @@ int map_load(map * map, const char * file_name)
         return 1;
     char buf[64];
 
+    // binary maps are used in place and tiled maps read as needed
+    uint32_t magic = 0;
+    if (fread(&magic, sizeof(magic), 1, file) == 1 &&
+        (magic == MAP_MAGIC || magic == TILE_MAGIC)) {
+        fclose(file);
+        if (magic == TILE_MAGIC)
+            return map_open_tiled(map, file_name, MAP_TILE_BUDGET);
+        return map_open(map, file_name, 1);
+    }
+    rewind(file);
+
     fgets(buf, sizeof(buf), file);
 
     sscanf(buf, "%d %d", &map->h, &map->w);
+    map->packed = NULL;
+    map->mapping = NULL;
+    map->tiles = NULL;
+    map->hash = 0;
     map->buffer = (char *) malloc(sizeof(char) * map->h * map->w);
 
     char * line = (char *) malloc(sizeof(char) * map->w + 1);
@@ -33,8 +230,25 @@ int map_load(map * map, const char * file_name)
 
 void map_copy(map * dst, const map * src)
 {
+    if (src->tiles) {
+        // the tiles come into memory packed
+        map_pack(dst, src);
+        return;
+    }
+
     dst->w = src->w;
     dst->h = src->h;
+    dst->mapping = NULL;
+    dst->tiles = NULL;
+    dst->hash = src->hash;
+    if (src->packed) {
+        size_t bytes = sizeof(uint32_t) * map_words(src->w, src->h);
+        dst->buffer = NULL;
+        dst->packed = (uint32_t *) malloc(bytes);
+        memcpy(dst->packed, src->packed, bytes);
+        return;
+    }
+    dst->packed = NULL;
     dst->buffer = (char *) malloc(sizeof(char) * src->h * src->w);
     for (int r = 0; r < src->h; ++r) {
         for (int c = 0; c < src->w; ++c) {
@@ -43,9 +257,98 @@ void map_copy(map * dst, const map * src)
     }
 }
 
+// walls are MAP_WALL, every other tile keeps the low 4 bits of its cost
+void map_pack_words(const map * src, uint32_t * words)
+{
+    size_t n = (size_t) src->w * src->h;
+    uint32_t value = 0;
+    size_t i = 0;
+    for (int y = 0; y < src->h; ++y) {
+        for (int x = 0; x < src->w; ++x, ++i) {
+            value |= (uint32_t) cell_nibble(src, x, y) << ((i & 7) * 4);
+            if ((i & 7) == 7) {
+                words[i >> 3] = value;
+                value = 0;
+            }
+        }
+    }
+    if (n & 7)
+        words[n >> 3] = value;
+}
+
+uint8_t map_cost(const map * map, int x, int y)
+{
+    return cell_nibble(map, x, y);
+}
+
+void map_pack(map * dst, const map * src)
+{
+    dst->w = src->w;
+    dst->h = src->h;
+    dst->buffer = NULL;
+    dst->packed = (uint32_t *) malloc(sizeof(uint32_t) * map_words(src->w, src->h));
+    dst->mapping = NULL;
+    dst->tiles = NULL;
+    dst->hash = 0;
+    map_pack_words(src, dst->packed);
+}
+
 void map_dtor(map * map)
 {
+    if (map->tiles) {
+        tstore_close(map->tiles);
+        free(map->tiles);
+        return;
+    }
+    if (map->mapping) {
+        munmap(map->mapping, map->length);
+        return;
+    }
     free(map->buffer);
+    free(map->packed);
+}
+
+// mixes 8 bytes at a time: 8 tiles, or 16 of a packed map
+static
+uint64_t hash_tiles(const map * map)
+{
+    // a tiled map's tiles are hashed once, when the file is written
+    if (map->tiles) {
+        uint64_t h = map->tiles->checksum ^ ((uint64_t) map->w << 32 | (uint32_t) map->h);
+        h *= 0xC4CEB9FE1A85EC53ull;
+        return h ^ (h >> 33);
+    }
+
+    const char * bytes = map->packed ? (const char *) map->packed : map->buffer;
+    size_t n = map->packed ? sizeof(uint32_t) * map_words(map->w, map->h)
+                           : (size_t) map->w * map->h;
+    uint64_t h = 0x9E3779B97F4A7C15ull ^ ((uint64_t) map->w << 32 | (uint32_t) map->h);
+    if (map->packed)
+        h = ~h;     // keep a packed map apart from a character map of its size
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        uint64_t v;
+        memcpy(&v, bytes + i, sizeof(v));
+        h = (h ^ v) * 0xFF51AFD7ED558CCDull;
+        h ^= h >> 32;
+    }
+    for (; i < n; ++i)
+        h = (h ^ (unsigned char) bytes[i]) * 0x100000001B3ull;
+    h ^= h >> 33;
+    h *= 0xC4CEB9FE1A85EC53ull;
+    h ^= h >> 33;
+    return h;
+}
+
+uint64_t map_hash(const map * map)
+{
+    uint64_t h = __atomic_load_n(&map->hash, __ATOMIC_RELAXED);
+    if (h == 0) {
+        h = hash_tiles(map);
+        // threads sharing the map all store the same value
+        __atomic_store_n(&((struct map_ *) map)->hash, h, __ATOMIC_RELAXED);
+    }
+    return h;
 }
 
 static void map_gen_border(map * map)
@@ -57,17 +360,17 @@ static void map_gen_border(map * map)
 
     // bottom border
     for (int i = 1; i < map->w - 1; i++) {
-        int offset = (map->h - 1) * map->w;
+        size_t offset = (size_t) (map->h - 1) * map->w;
         map->buffer[i + offset] = '-';
     }
 
     // left border
-    for (int i = 0; i < map->h * map->w; i += map->w) {
+    for (size_t i = 0; i < (size_t) map->h * map->w; i += map->w) {
         map->buffer[i] = '|';
     }
 
     // right border
-    for (int i = map->w - 1; i < map->h * map->w; i += map->w) {
+    for (size_t i = map->w - 1; i < (size_t) map->h * map->w; i += map->w) {
         map->buffer[i] = '|';
     }
 }
@@ -85,6 +388,10 @@ void map_rand(map * map, int width, int height)
     map->w = width;
     map->h = height;
     map->buffer = (char *) malloc(sizeof(char) * height * width);
+    map->packed = NULL;
+    map->mapping = NULL;
+    map->tiles = NULL;
+    map->hash = 0;
 
     // seed the random number generator
     rand_r(&sv_seed);
@@ -112,7 +419,7 @@ void map_rand(map * map, int width, int height)
                 }
                 rand_tickets -= tickets[ticket_i];
             }
-            map->buffer[row_i * map->w + col_i] = symbols[ticket_i];
+            map->buffer[row_i * (size_t) map->w + col_i] = symbols[ticket_i];
         }
     }
 }
@@ -5,30 +5,124 @@
 extern "C" {
 #endif
 
+#include <stddef.h>
+#include <stdint.h>
+
+// nibble of an impassable cell in a packed map
+#define MAP_WALL 0xF
+
+// a map holds either one tile character per cell in buffer, or, once
+// packed with map_pack, 4-bit tile costs in packed: eight cells per word,
+// the cell at x + w * y in bits (i & 7) * 4 of word i >> 3, the same layout
+// as the accelerator's bram_map. the other pointer is NULL.
+// maps opened from a binary file point both straight into the mapping.
+// maps opened from a tiled map file have neither: their tiles are read
+// through tiles, a bounded cache of the file (tiles.h)
 typedef struct map_
 {
     int w;
     int h;
     char * buffer;
+    uint32_t * packed;
+    void * mapping;         // binary map file, NULL if the tiles are malloced
+    size_t length;
+    struct tstore_ * tiles; // tiled map file, NULL if the map is in memory
+    uint64_t hash;          // map_hash's, 0 until it is worked out
 } map;
 
+// tile cache map_load gives tiled map files
+#define MAP_TILE_BUDGET ((size_t) 64 << 20)
+
+// character maps only
 //__attribute__((always_inline))
 static inline
 char map_get(const map * map, int x, int y)
 {
-    return map->buffer[x + map->w * y];
+    return map->buffer[x + (size_t) map->w * y];
 }
 
 static inline
 void map_put(map * map, int x, int y, char c)
 {
-    map->buffer[x + map->w * y] = c;
+    map->buffer[x + (size_t) map->w * y] = c;
+    map->hash = 0;
 }
 
-// returns 0 on success
+// packed maps only
+static inline
+uint8_t map_nibble(const map * map, int64_t i)
+{
+    return (map->packed[i >> 3] >> ((i & 7) * 4)) & 0xF;
+}
+
+static inline
+void map_put_nibble(map * map, int x, int y, uint8_t c)
+{
+    int64_t i = x + (int64_t) map->w * y;
+    uint32_t shift = (i & 7) * 4;
+    map->packed[i >> 3] = (map->packed[i >> 3] & ~(0xFu << shift)) |
+                          (uint32_t) c << shift;
+    map->hash = 0;
+}
+
+// words a packed map of w * h cells takes
+static inline
+size_t map_words(int w, int h)
+{
+    return ((size_t) w * h + 7) / 8;
+}
+
+// binary map files start with this header, followed by the tiles at
+// MAP_DATA: w * h tile characters or map_words(w, h) packed words, in the
+// byte order of the machine that wrote them. checksum is map_hash of the
+// map, so a file can be checked without parsing anything
+#define MAP_MAGIC 0x504D4B44    // "DKMP"
+#define MAP_VERSION 1
+#define MAP_CHARS 0             // encodings
+#define MAP_PACKED 1
+#define MAP_DATA 64             // tiles start a cache line in
+
+typedef struct map_header_
+{
+    uint32_t magic;
+    uint16_t version;
+    uint16_t encoding;
+    int32_t w;
+    int32_t h;
+    uint64_t checksum;
+} map_header;
+
+// reads a text map, opens a binary one with map_open and checks it, or
+// opens a tiled one with a MAP_TILE_BUDGET cache. returns 0 on success
 int map_load(map * map, const char * file_name);
+// maps a binary map file and uses its tiles in place; nothing is read until
+// a tile is. the mapping is private: map_put on an opened map changes the
+// map but never the file. verify hashes the whole map against the checksum.
+// returns 0 on success
+int map_open(map * map, const char * file_name, int verify);
+// writes a binary map file; returns 0 on success
+int map_save(const map * map, const char * file_name);
+// opens a tiled map file, caching at most budget bytes of its tiles.
+// returns 0 on success
+int map_open_tiled(map * map, const char * file_name, size_t budget);
+// writes any map as a tiled map file with tiles of side cells, a power of
+// two; returns 0 on success
+int map_save_tiled(const map * map, const char * file_name, int side);
+// converts a text map file to a tiled one a band of rows at a time, so
+// the map never has to fit in memory; returns 0 on success
+int map_convert_tiled(const char * text_name, const char * file_name, int side);
 void map_copy(map * dst, const map * src);
+// packed copy of any map
+void map_pack(map * dst, const map * src);
+// writes src's packed cost nibbles to words, map_words(w, h) of them
+void map_pack_words(const map * src, uint32_t * words);
+// cost nibble of (x, y) on any kind of map, MAP_WALL for walls
+uint8_t map_cost(const map * map, int x, int y);
 void map_dtor(map * map);
+// hash of the map's size and tiles, to recognize a map seen before. it is
+// worked out once and kept in map->hash until map_put or map_put_nibble
+// changes a tile; code writing buffer or packed itself sets hash to 0
+uint64_t map_hash(const map * map);
 
 void map_seed(unsigned int seed);
 void map_rand(map * map, int width, int height);
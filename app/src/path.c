@@ -2,15 +2,16 @@
 #include <stdio.h>
 #include <stdbool.h>
 #include <stdlib.h>
+#include <string.h>
 #include "map.h"
 #include "path.h"
 #include "world.h"
+#include "graph.h"
+#include "heap.h"
 
 //#define dprintf(...) fprintf(stderr, __VA_ARGS__)
 #define dprintf(str, ...)
 
-extern const int32_t cost_table[128];
-
 void path_ctor(path * path)
 {
     vector_ctor(&path->moves, sizeof(movement), NULL, NULL);
@@ -21,100 +22,116 @@ void path_dtor(path * path)
     vector_dtor(&path->moves);
 }
 
-// nodes contain a 28 bit cost and 4 bits for direction
-#define DIR_R  1
-#define DIR_L -1
-#define DIR_U -1
-#define DIR_D  1
-#define DIR_H  0    // halt
-#define DIR_N  -2   // NULL direction
-typedef struct node_
+void search_ctor(search * search, int w, int h)
 {
-    uint32_t cost : 26;
-    int32_t dir_x: 2;
-    int32_t dir_y: 2;
-    int32_t visit: 1;
-    int32_t queue: 1;
-} node;
+    idx_t n = (idx_t) w * h;
+    idx_t words = (n + 31) / 32;
+    search->w = w;
+    search->h = h;
+    search->epoch = 0;
+    search->stamp  = (uint32_t *) calloc(n, sizeof(uint32_t));
+    search->cost   = (cost_t *) malloc(sizeof(cost_t) * n);
+    search->dir    = (uint8_t *) malloc(sizeof(uint8_t) * n);
+    search->visit  = (uint32_t *) calloc(words, sizeof(uint32_t));
+    search->queued = (uint32_t *) calloc(words, sizeof(uint32_t));
+    search->queue  = (coord *) malloc(sizeof(coord) * n);
+    search->heap   = (idx_t *) malloc(sizeof(idx_t) * n);
+    search->key    = (cost_t *) malloc(sizeof(cost_t) * n);
+    search->pos    = (idx_t *) malloc(sizeof(idx_t) * n);
+    search->buckets = (idx_t *) malloc(sizeof(idx_t) * BUCKET_MAX);
+    search->rev    = NULL;
+    for (idx_t i = 0; i < n; ++i)
+        search->pos[i] = -1;
+}
 
-typedef struct graph_
+void search_dtor(search * search)
 {
-    int w;
-    int h;
-    node * buffer;
-} graph;
-
-static inline
-node * graph_ref(const graph * graph, int x, int y)
-{
-    return &(graph->buffer[x + graph->w * y]);
+    free(search->stamp);
+    free(search->cost);
+    free(search->dir);
+    free(search->visit);
+    free(search->queued);
+    free(search->queue);
+    free(search->heap);
+    free(search->key);
+    free(search->pos);
+    free(search->buckets);
+    if (search->rev) {
+        search_dtor(search->rev);
+        free(search->rev);
+    }
 }
 
-static inline
-node graph_get(const graph * graph, int x, int y)
+// hand back the caller's workspace, or build a scratch one in its place
+// if there is none. a workspace sized for another map is rebuilt
+search * search_acquire(search * search, struct search_ * scratch, const map * map)
 {
-    return graph->buffer[x + graph->w * y];
+    if (search == NULL) {
+        search_ctor(scratch, map->w, map->h);
+        return scratch;
+    }
+    if (search->w != map->w || search->h != map->h) {
+        search_dtor(search);
+        search_ctor(search, map->w, map->h);
+    }
+    return search;
 }
 
-static inline
-void graph_put(graph * graph, int x, int y, node c)
+void search_release(search * search, struct search_ * scratch)
 {
-    graph->buffer[x + graph->w * y] = c;
+    if (search == scratch)
+        search_dtor(scratch);
 }
 
-#define graph_node(graph,x,y) (graph)->buffer[x + (graph)->w * y]
-
-//__attribute__((always_inline))
-static inline
-int32_t calc_cost(char c)
+// look at the workspace's current query without starting a new one
+void graph_view(graph * graph, search * search)
 {
-    return cost_table[c];
+    graph->w = search->w;
+    graph->h = search->h;
+    graph->cost = search->cost;
+    graph->dir = search->dir;
+    graph->visit = search->visit;
+    graph->queued = search->queued;
+    graph->stamp = search->stamp;
+    graph->epoch = search->epoch;
 }
-//#define calc_cost(c) cost_table[c]
 
-// initialize a graph scratchpad
-// unvisited nodes have a direction of {0,0}
-// unusable nodes have a direction of {-2,-2}
-static
-void gen_graph(graph * graph, const map * map)
+// initialize a graph scratchpad for a new query
+// unvisited nodes have no direction and an infinite cost
+// moving to the next epoch invalidates every node in O(1)
+void gen_graph(graph * graph, search * search)
 {
-    graph->w = map->w;
-    graph->h = map->h;
-    graph->buffer = (int *) malloc(sizeof(node) * graph->w * graph->h);
-
-    for (int x = 0; x < map->w; ++x) {
-        for (int y = 0; y < map->h; ++y) {
-            node n = {.cost = -1, .dir_x = DIR_H, .dir_y = DIR_H, .visit = 0, .queue = 0};
-            graph_put(graph, x, y, n);
-        }
+    search->epoch += 1;
+    if (search->epoch == 0) {
+        // wrapped: clear the stamps so none of them alias the new epoch
+        memset(search->stamp, 0, sizeof(uint32_t) * search->w * (idx_t) search->h);
+        search->epoch = 1;
     }
-}
 
-static
-void graph_dtor(graph * graph)
-{
-    free(graph->buffer);
+    graph_view(graph, search);
 }
 
-static const int dirs[8][3] =
+// reset every node at once for engines that sweep the whole grid anyway.
+// these are straight dense loops the compiler can vectorize
+void graph_clear(graph * graph)
 {
-    // x  ,  y,    cost (Q31.1)
-    {DIR_L, DIR_U, 0x3},
-    {DIR_H, DIR_U, 0x2},
-    {DIR_R, DIR_U, 0x3},
-    {DIR_R, DIR_H, 0x2},
-    {DIR_R, DIR_D, 0x3},
-    {DIR_H, DIR_D, 0x2},
-    {DIR_L, DIR_D, 0x3},
-    {DIR_L, DIR_H, 0x2}
-};
+    idx_t n = (idx_t) graph->w * graph->h;
+    for (idx_t i = 0; i < n; ++i)
+        graph->cost[i] = COST_INF;
+    for (idx_t i = 0; i < n; ++i)
+        graph->dir[i] = DIR_NONE;
+    for (idx_t i = 0; i < n; ++i)
+        graph->stamp[i] = graph->epoch;
+    memset(graph->visit, 0, sizeof(uint32_t) * ((n + 31) / 32));
+    memset(graph->queued, 0, sizeof(uint32_t) * ((n + 31) / 32));
+}
 
 // return true if all nodes visitied
 bool check_nodes_visited(graph * g)
 {
-    int node_cnt = g->w * g->h;
-    for (int i = 0; i < node_cnt; ++i) {
-        if (!g->buffer[i].visit)
+    idx_t node_cnt = (idx_t) g->w * g->h;
+    for (idx_t i = 0; i < node_cnt; ++i) {
+        if (g->stamp[i] != g->epoch || !bit_get(g->visit, i))
             return false;
     }
 
@@ -124,29 +141,23 @@ bool check_nodes_visited(graph * g)
 typedef struct queue_
 {
     coord * buffer;
-    int head;
-    int enq_idx;
-    int deq_idx;
-    int cap;
-    int size;
+    idx_t head;
+    idx_t enq_idx;
+    idx_t deq_idx;
+    idx_t cap;
+    idx_t size;
 } queue;
 
 static
-void queue_ctor(queue * q, graph * g)
+void queue_ctor(queue * q, search * s)
 {
-    q->cap = g->w * g->h;
-    q->buffer = (coord *) malloc(sizeof(coord) * q->cap);
+    q->cap = (idx_t) s->w * s->h;
+    q->buffer = s->queue;
     q->enq_idx = 0;
     q->deq_idx = 0;
     q->size    = 0;
 }
 
-static
-void queue_dtor(queue * q)
-{
-    free(q->buffer);
-}
-
 static
 bool queue_enq(queue * q, const coord * c)
 {
@@ -175,8 +186,101 @@ bool queue_deq(queue * q, coord * c)
     return true;
 }
 
-static void gen_path(graph * graph, const coord * start, const coord * end,
-                     path * path)
+// circular bucket queue (Dial): with integer edge weights no larger than
+// cap - 1, every queued key lies within cap of the smallest one, so bucket
+// key % cap holds exactly the nodes of that key. nodes are chained through
+// intrusive doubly linked lists so a decreased key can be moved in O(1)
+typedef struct bucket_
+{
+    idx_t * head;   // first node of each bucket; -1 if empty
+    idx_t * next;
+    idx_t * prev;
+    cost_t * key;   // key each queued node was filed under
+    cost_t curr;    // smallest key that may still be queued
+    int cap;
+    idx_t size;
+} bucket;
+
+static
+void bucket_ctor(bucket * b, search * s, int cap)
+{
+    b->head = s->buckets;
+    b->next = s->heap;
+    b->prev = s->pos;
+    b->key = s->key;
+    b->curr = 0;
+    b->cap = cap;
+    b->size = 0;
+    for (int i = 0; i < cap; ++i)
+        b->head[i] = -1;
+}
+
+// bucket borrows the heap's slot index, which must read -1 again afterwards
+static
+void bucket_dtor(bucket * b)
+{
+    for (int i = 0; i < b->cap; ++i) {
+        for (idx_t n = b->head[i]; n >= 0; ) {
+            idx_t next = b->next[n];
+            b->prev[n] = -1;
+            n = next;
+        }
+        b->head[i] = -1;
+    }
+    b->size = 0;
+}
+
+static inline
+void bucket_unlink(bucket * b, idx_t n)
+{
+    idx_t next = b->next[n];
+    idx_t prev = b->prev[n];
+    if (prev >= 0)
+        b->next[prev] = next;
+    else
+        b->head[b->key[n] % b->cap] = next;
+    if (next >= 0)
+        b->prev[next] = prev;
+    b->size -= 1;
+}
+
+// file node n under key, moving it if it is already queued
+static inline
+void bucket_push(bucket * b, uint32_t * queued, idx_t n, cost_t key)
+{
+    if (bit_get(queued, n))
+        bucket_unlink(b, n);
+    else
+        bit_set(queued, n);
+
+    int slot = key % b->cap;
+    b->key[n] = key;
+    b->prev[n] = -1;
+    b->next[n] = b->head[slot];
+    if (b->head[slot] >= 0)
+        b->prev[b->head[slot]] = n;
+    b->head[slot] = n;
+    b->size += 1;
+}
+
+static inline
+bool bucket_pop(bucket * b, uint32_t * queued, idx_t * n)
+{
+    if (b->size == 0)
+        return false;
+
+    while (b->head[b->curr % b->cap] < 0)
+        b->curr += 1;
+
+    *n = b->head[b->curr % b->cap];
+    bucket_unlink(b, *n);
+    b->prev[*n] = -1;
+    bit_clr(queued, *n);
+    return true;
+}
+
+void gen_path(graph * graph, const coord * start, const coord * end,
+              path * path)
 {
     coord curr = *end;
     int x_dir = -1;
@@ -189,12 +293,15 @@ static void gen_path(graph * graph, const coord * start, const coord * end,
             end->x, end->y, start->x, start->y);
     while (!(curr.x == start->x && curr.y == start->y)) {
         // follow the directions
-        x_dir = graph_node(graph, curr.x, curr.y).dir_x;
-        y_dir = graph_node(graph, curr.x, curr.y).dir_y;
-        if (x_dir == 0 && y_dir == 0) {
+        idx_t i = graph_idx(graph, curr.x, curr.y);
+        graph_touch(graph, i);
+        uint8_t dir = graph->dir[i];
+        if (!(dir & DIR_VALID)) {
             //printf("failed");
             return;
         }
+        x_dir = acceldirs[dir & 0x7][0];
+        y_dir = acceldirs[dir & 0x7][1];
 
         coord next = {.x = curr.x + x_dir, .y = curr.y + y_dir};
 
@@ -234,9 +341,10 @@ static void gen_path(graph * graph, const coord * start, const coord * end,
 //
 
 // utilize the map to generate paths
-void path_find(const map * map, const coord * start, const coord * end,
+void path_find(search * search, const map * map, const coord * start, const coord * end,
                path * path, prof * prof)
 {
+    struct search_ scratch;
     queue queue;
     graph graph;
 
@@ -245,137 +353,364 @@ void path_find(const map * map, const coord * start, const coord * end,
 
     prof_start(prof);
     path_ctor(path);
-    gen_graph(&graph, map);
-    queue_ctor(&queue, &graph);
+    search = search_acquire(search, &scratch, map);
+    gen_graph(&graph, search);
+    queue_ctor(&queue, search);
     prof_end(prof); prof->prproc = prof_dt(prof);
 
 
     prof_start(prof);
     coord curr = *start;
-    graph_node(&graph, curr.x, curr.y).cost = 0;
+    idx_t idx = graph_idx(&graph, curr.x, curr.y);
+    graph_touch(&graph, idx);
+    graph.cost[idx] = 0;
 
     queue_enq(&queue, &curr);
 
     while (queue_deq(&queue, &curr)) {
-        graph_node(&graph, curr.x, curr.y).queue = 0;
+        prof->expand += 1;
+        idx_t c = graph_idx(&graph, curr.x, curr.y);
+        bit_clr(graph.queued, c);
         dprintf("curr: (%d, %d)\n", curr.x, curr.y);
         for (int i = 0; i < 8; i += 1) {
             coord next = {.x = curr.x + dirs[i][0], .y = curr.y + dirs[i][1]};
-            uint32_t cost = dirs[i][2];
+            cost_t cost = dirs[i][2];
 
             // early return if out of bounds or boundary
             if (next.x < 0 || next.x >= graph.w ||
                 next.y < 0 || next.y >= graph.h)
                 continue;
 
-            char tile = map_get(map, next.x, next.y);
-            cost += calc_cost(tile) << 1;   // compensate for tile costs not being fixed point
-            dprintf("    next tile: %c  (0x%08x)\n", tile, calc_cost(tile));
-            if (calc_cost(tile) == 0xDEADBEEF)
+            int32_t tile = tile_cost(map, next.x, next.y);
+            dprintf("    next tile: 0x%08x\n", tile);
+            if (tile == (int32_t) 0xDEADBEEF)
                 continue;
-            cost += graph_node(&graph, curr.x, curr.y).cost;   // get the start pos cost
+            cost += tile << 1;   // compensate for tile costs not being fixed point
+            cost += graph.cost[c];   // get the start pos cost
 
-            dprintf("    next: (%d, %d) = %d.%d\n", next.x, next.y, cost >> 1, (cost & 1) ? 5 : 0);
+            dprintf("    next: (%d, %d) = %llu.%d\n", next.x, next.y, cost >> 1, (cost & 1) ? 5 : 0);
             // redirect that node to current node if it costs less to move
-            if (cost < graph_node(&graph, next.x, next.y).cost) {
-                node * n = graph_ref(&graph, next.x, next.y);
-                n->cost = cost;
-                n->dir_x = curr.x - next.x;
-                n->dir_y = curr.y - next.y;
-                n->visit = 0;
+            idx_t n = graph_idx(&graph, next.x, next.y);
+            graph_touch(&graph, n);
+            if (cost < graph.cost[n]) {
+                graph.cost[n] = cost;
+                graph.dir[n] = dir_codes[(i + 4) & 7];
+                bit_clr(graph.visit, n);
                 dprintf("        updated\n");
-            }
 
-            if (graph_node(&graph, next.x, next.y).visit == 0 &&
-                graph_node(&graph, next.x, next.y).queue == 0) {
-                graph_node(&graph, next.x, next.y).queue = 1;
-                queue_enq(&queue, &next);
+                // a node that did not improve is already queued or visited,
+                // so only updated nodes can need queueing
+                if (!bit_get(graph.queued, n)) {
+                    bit_set(graph.queued, n);
+                    queue_enq(&queue, &next);
+                }
             }
         }
-        graph_node(&graph, curr.x, curr.y).visit = 1;
+        bit_set(graph.visit, c);
     }
     prof_end(prof); prof->exec = prof_dt(prof);
 
     // generate the path
     prof_start(prof);
     gen_path(&graph, start, end, path);
-    queue_dtor(&queue);
-    graph_dtor(&graph);
+    search_release(search, &scratch);
     prof_end(prof); prof->poproc = prof_dt(prof);
 }
 
-void ppath_find(const map * map, const coord * start, const coord * end,
-                path * path)
+// smallest tile cost a move can be charged, found once from the cost table
+uint32_t min_tile_cost(void)
 {
+    // found in a local and stored once, so threads racing on the first
+    // call never see a half-finished minimum
+    static int32_t min = -1;
+    if (min < 0) {
+        int32_t m = INT32_MAX;
+        for (int i = 0; i < 128; ++i) {
+            if (calc_cost(i) != (int32_t) 0xDEADBEEF && calc_cost(i) < m)
+                m = calc_cost(i);
+        }
+        min = m;
+    }
+    return min;
+}
+
+// octile distance in Q31.1 to match dirs: straight moves cost 0x2 and
+// diagonal moves 0x3, and every move pays at least the cheapest tile
+cost_t octile(const coord * a, const coord * b)
+{
+    cost_t dx = abs(a->x - b->x);
+    cost_t dy = abs(a->y - b->y);
+    cost_t lo = dx < dy ? dx : dy;
+    cost_t hi = dx < dy ? dy : dx;
+    return (hi << 1) + lo + ((min_tile_cost() << 1) * hi);
+}
+
+// settle nodes in order of cost over an indexed heap: every node is settled
+// exactly once, unlike the FIFO loop which re-expands a node whenever its
+// cost drops. if goal is given, keys are biased by the octile heuristic (A*)
+// and the search stops as soon as the goal is settled
+static
+void heap_search(const map * map, graph * graph, heap * heap,
+                 const coord * start, const coord * goal, prof * prof)
+{
+    idx_t idx = graph_idx(graph, start->x, start->y);
+    graph_touch(graph, idx);
+    graph->cost[idx] = 0;
+    heap_push(heap, idx, goal ? octile(start, goal) : 0);
+
+    while (heap_pop(heap, &idx)) {
+        prof->expand += 1;
+        coord curr = {.x = idx % graph->w, .y = idx / graph->w};
+        bit_set(graph->visit, idx);
+        dprintf("curr: (%d, %d)\n", curr.x, curr.y);
+        if (goal && curr.x == goal->x && curr.y == goal->y)
+            break;
+
+        for (int i = 0; i < 8; i += 1) {
+            coord next = {.x = curr.x + dirs[i][0], .y = curr.y + dirs[i][1]};
+
+            if (next.x < 0 || next.x >= graph->w ||
+                next.y < 0 || next.y >= graph->h)
+                continue;
+
+            int32_t tile = tile_cost(map, next.x, next.y);
+            if (tile == (int32_t) 0xDEADBEEF)
+                continue;
+
+            idx_t n = graph_idx(graph, next.x, next.y);
+            graph_touch(graph, n);
+            if (bit_get(graph->visit, n))
+                continue;
+
+            cost_t cost = graph->cost[idx] + dirs[i][2] + (tile << 1);
+            if (cost < graph->cost[n]) {
+                graph->cost[n] = cost;
+                graph->dir[n] = dir_codes[(i + 4) & 7];
+                heap_push(heap, n, goal ? cost + octile(&next, goal) : cost);
+            }
+        }
+    }
+}
+
+static
+void heap_path_find(search * search, const map * map, const coord * start,
+                    const coord * end, path * path, prof * prof, bool astar)
+{
+    struct search_ scratch;
+    heap heap;
     graph graph;
 
+    prof_ctor(prof);
+
+    prof_start(prof);
     path_ctor(path);
-    gen_graph(&graph, map);
+    search = search_acquire(search, &scratch, map);
+    gen_graph(&graph, search);
+    heap_ctor(&heap, search);
+    prof_end(prof); prof->prproc = prof_dt(prof);
 
-    graph_node(&graph, start->x, start->y).cost = 0;
+    prof_start(prof);
+    heap_search(map, &graph, &heap, start, astar ? end : NULL, prof);
+    prof_end(prof); prof->exec = prof_dt(prof);
 
-    // anytime a node has to change, set run to 1
-    int run;
-    int count = 0;
-    do {
-        ++count;
-        run = 0;
-        coord curr;
-        for (curr.y = 0; curr.y < graph.h; ++curr.y) {
-            for (curr.x = 0; curr.x < graph.w; ++curr.x) {
-                if (calc_cost(map_get(map, curr.x, curr.y)) == 0xDEADBEEF)
-                    continue;
-
-                for (int i = 0; i < 8; ++i) {
-                    coord prev;
-                    prev.x = curr.x + dirs[i][0];
-                    prev.y = curr.y + dirs[i][1];
-                    // if the coordinate to check is in bounds, check it
-                    // moving from prev to this node
-                    if ((0 <= prev.x && prev.x < graph.w) &&
-                        (0 <= prev.y && prev.y < graph.h) /*&&
-                        calc_cost(map_get(map, prev.x, prev.y)) != 0xDEADBEEF*/) {
-                        uint32_t cost = 0;
-                        cost += dirs[i][2];
-                        cost += graph_node(&graph, prev.x, prev.y).cost;
-                        cost += calc_cost(map_get(map, curr.x, curr.y)) << 1;
-
-                        // redirect current node if it costs less
-                        node * n = graph_ref(&graph, curr.x, curr.y);
-                        if (cost < n->cost) {
-                            run = 1;
-
-                            dprintf("(%d,%d) found better path from (%d, %d); cost %d -> %d\n",
-                                    curr.x, curr.y, prev.x, prev.y, n->cost, cost);
-                            n->cost = cost;
-                            n->dir_x = dirs[i][0];
-                            n->dir_y = dirs[i][1];
-                        }
-                    }
-                }
+    prof_start(prof);
+    gen_path(&graph, start, end, path);
+    heap_dtor(&heap);
+    search_release(search, &scratch);
+    prof_end(prof); prof->poproc = prof_dt(prof);
+}
+
+// Dijkstra: builds the full shortest path tree from start
+void dpath_find(search * search, const map * map, const coord * start,
+                const coord * end, path * path, prof * prof)
+{
+    heap_path_find(search, map, start, end, path, prof, false);
+}
+
+// A*: only explores toward end and stops once it is settled
+void apath_find(search * search, const map * map, const coord * start,
+                const coord * end, path * path, prof * prof)
+{
+    heap_path_find(search, map, start, end, path, prof, true);
+}
+
+// largest tile cost a move can be charged, found once from the cost table
+uint32_t max_tile_cost(void)
+{
+    static int32_t max = -1;
+    if (max < 0) {
+        int32_t m = 0;
+        for (int i = 0; i < 128; ++i) {
+            if (calc_cost(i) != (int32_t) 0xDEADBEEF && calc_cost(i) > m)
+                m = calc_cost(i);
+        }
+        max = m;
+    }
+    return max;
+}
+
+// Dijkstra over a bucket queue: tile costs are small integers, so pushing
+// and popping is O(1) instead of a heap's O(log n)
+static
+void bucket_search(const map * map, graph * graph, bucket * bucket,
+                   const coord * start, prof * prof)
+{
+    idx_t idx = graph_idx(graph, start->x, start->y);
+    graph_touch(graph, idx);
+    graph->cost[idx] = 0;
+    bucket_push(bucket, graph->queued, idx, 0);
+
+    while (bucket_pop(bucket, graph->queued, &idx)) {
+        prof->expand += 1;
+        coord curr = {.x = idx % graph->w, .y = idx / graph->w};
+        bit_set(graph->visit, idx);
+        dprintf("curr: (%d, %d)\n", curr.x, curr.y);
+
+        for (int i = 0; i < 8; i += 1) {
+            coord next = {.x = curr.x + dirs[i][0], .y = curr.y + dirs[i][1]};
+
+            if (next.x < 0 || next.x >= graph->w ||
+                next.y < 0 || next.y >= graph->h)
+                continue;
+
+            int32_t tile = tile_cost(map, next.x, next.y);
+            if (tile == (int32_t) 0xDEADBEEF)
+                continue;
+
+            idx_t n = graph_idx(graph, next.x, next.y);
+            graph_touch(graph, n);
+            if (bit_get(graph->visit, n))
+                continue;
+
+            cost_t cost = graph->cost[idx] + dirs[i][2] + (tile << 1);
+            if (cost < graph->cost[n]) {
+                graph->cost[n] = cost;
+                graph->dir[n] = dir_codes[(i + 4) & 7];
+                bucket_push(bucket, graph->queued, n, cost);
             }
         }
+    }
+}
 
-    } while (run && count < (graph.h * graph.w));
-    dprintf("cycles: %d\n", count);
+// buckets in Dial's ring: one more than the heaviest possible edge, a
+// diagonal onto the most expensive tile. packed maps hold any nibble below
+// a wall, whatever the cost table's range
+static
+int bucket_cap(void)
+{
+    uint32_t max = max_tile_cost();
+    if (max < MAP_WALL - 1)
+        max = MAP_WALL - 1;
+    return 0x3 + (max << 1) + 1;
+}
 
-    // generate the path
+// Dial's algorithm: the bucket ring is sized by bucket_cap. a cost table
+// whose range needs more than BUCKET_MAX buckets falls back to the heap
+void bpath_find(search * search, const map * map, const coord * start,
+                const coord * end, path * path, prof * prof)
+{
+    int cap = bucket_cap();
+    if (cap > BUCKET_MAX) {
+        dpath_find(search, map, start, end, path, prof);
+        return;
+    }
+
+    struct search_ scratch;
+    bucket bucket;
+    graph graph;
+
+    prof_ctor(prof);
+
+    prof_start(prof);
+    path_ctor(path);
+    search = search_acquire(search, &scratch, map);
+    gen_graph(&graph, search);
+    bucket_ctor(&bucket, search, cap);
+    prof_end(prof); prof->prproc = prof_dt(prof);
+
+    prof_start(prof);
+    bucket_search(map, &graph, &bucket, start, prof);
+    prof_end(prof); prof->exec = prof_dt(prof);
+
+    prof_start(prof);
     gen_path(&graph, start, end, path);
-    graph_dtor(&graph);
+    bucket_dtor(&bucket);
+    search_release(search, &scratch);
+    prof_end(prof); prof->poproc = prof_dt(prof);
+}
+
+void tree_ctor(tree * tree, int w, int h)
+{
+    search_ctor(&tree->search, w, h);
+    tree->start.x = 0;
+    tree->start.y = 0;
+}
+
+void tree_dtor(tree * tree)
+{
+    search_dtor(&tree->search);
+}
+
+// the full tree is what Dial's algorithm (or Dijkstra, for wide cost
+// tables) builds anyway when it is not stopped early
+void tree_find(tree * tree, const map * map, const coord * start, prof * prof)
+{
+    int cap = bucket_cap();
+    graph graph;
+
+    prof_ctor(prof);
+
+    prof_start(prof);
+    search * search = search_acquire(&tree->search, NULL, map);
+    gen_graph(&graph, search);
+    tree->start = *start;
+    prof_end(prof); prof->prproc = prof_dt(prof);
+
+    prof_start(prof);
+    if (cap > BUCKET_MAX) {
+        heap heap;
+        heap_ctor(&heap, search);
+        heap_search(map, &graph, &heap, start, NULL, prof);
+        heap_dtor(&heap);
+    }
+    else {
+        bucket bucket;
+        bucket_ctor(&bucket, search, cap);
+        bucket_search(map, &graph, &bucket, start, prof);
+        bucket_dtor(&bucket);
+    }
+    prof_end(prof); prof->exec = prof_dt(prof);
+}
+
+void tree_path(tree * tree, const coord * end, path * path)
+{
+    graph graph;
+    path_ctor(path);
+    graph_view(&graph, &tree->search);
+    gen_path(&graph, &tree->start, end, path);
+}
+
+cost_t tree_cost(tree * tree, const coord * end)
+{
+    graph graph;
+    graph_view(&graph, &tree->search);
+    idx_t i = graph_idx(&graph, end->x, end->y);
+    graph_touch(&graph, i);
+    return graph.cost[i];
 }
 
-static const int acceldirs[8][2] =
+void tree_pack(tree * tree, uint32_t * buffer)
 {
-    // x  ,  y,
-    {DIR_H, DIR_U},
-    {DIR_R, DIR_U},
-    {DIR_R, DIR_H},
-    {DIR_R, DIR_D},
-    {DIR_H, DIR_D},
-    {DIR_L, DIR_D},
-    {DIR_L, DIR_H},
-    {DIR_L, DIR_U},
-};
+    graph graph;
+    graph_view(&graph, &tree->search);
+    idx_t n = (idx_t) graph.w * graph.h;
+    for (idx_t i = 0; i < (n + 7) / 8; ++i)
+        buffer[i] = 0;
+    for (idx_t i = 0; i < n; ++i) {
+        graph_touch(&graph, i);
+        buffer[i >> 3] |= (uint32_t) graph.dir[i] << ((i & 7) * 4);
+    }
+}
 
 coord path_play(path * path, const map * map, const char * path_path, const coord * end_p)
 {
@@ -390,30 +725,26 @@ coord path_play(path * path, const map * map, const char * path_path, const coor
     uint32_t val;
     int count = 0;
     // generate a graph from this
+    struct search_ scratch;
     graph graph;
-    gen_graph(&graph, map);
+    search_ctor(&scratch, map->w, map->h);
+    gen_graph(&graph, &scratch);
     for (int r = 0; r < map->h; ++r) {
         for (int c = 0; c < map->w; ++c) {
             if (count == 0) {
                 fscanf(f, "%08x", &val);
             }
-            uint8_t dir = val & 0xF;
+            // same nibble encoding as the graph
+            idx_t i = graph_idx(&graph, c, r);
+            graph_touch(&graph, i);
+            graph.dir[i] = val & 0xF;
             val >>= 4;
-            node * n = graph_ref(&graph, c, r);
-            if (dir & 8) {
-                dir = dir & 0x7;
-                n->dir_x = acceldirs[dir][0];
-                n->dir_y = acceldirs[dir][1];
-            } else {
-                n->dir_x = DIR_H;
-                n->dir_y = DIR_H;
-            }
             count = (count + 1) % 8;
         }
     }
 
     gen_path(&graph, &start, &end, path);
-    graph_dtor(&graph);
+    search_dtor(&scratch);
     return start;
 }
 
@@ -424,29 +755,69 @@ void path_load(const map * map, const coord * start, const coord * end,
     uint32_t val;
     int count = 0;
     // generate a graph from this
+    struct search_ scratch;
     graph graph;
-    gen_graph(&graph, map);
+    search_ctor(&scratch, map->w, map->h);
+    gen_graph(&graph, &scratch);
     for (int r = 0; r < map->h; ++r) {
         for (int c = 0; c < map->w; ++c) {
             if (count == 0) {
                 val = *buffer;
                 ++buffer;
             }
-            uint8_t dir = val & 0xF;
+            // same nibble encoding as the graph
+            idx_t i = graph_idx(&graph, c, r);
+            graph_touch(&graph, i);
+            graph.dir[i] = val & 0xF;
             val >>= 4;
-            node * n = graph_ref(&graph, c, r);
-            if (dir & 8) {
-                dir = dir & 0x7;
-                n->dir_x = acceldirs[dir][0];
-                n->dir_y = acceldirs[dir][1];
-            } else {
-                n->dir_x = DIR_H;
-                n->dir_y = DIR_H;
-            }
             count = (count + 1) % 8;
         }
     }
 
     gen_path(&graph, start, end, path);
-    graph_dtor(&graph);
+    search_dtor(&scratch);
+}
+
+void path_walk(int w, int h, const coord * start, const coord * end,
+               const uint32_t * buffer, path * path)
+{
+    coord curr = *end;
+    int last_x_dir = 0;
+    int last_y_dir = 0;
+
+    path_ctor(path);
+    // a broken tree could loop: no path is longer than the map
+    for (idx_t steps = 0; steps < (idx_t) w * h; ++steps) {
+        if (curr.x == start->x && curr.y == start->y)
+            return;
+
+        idx_t i = curr.x + (idx_t) w * curr.y;
+        uint8_t dir = (buffer[i >> 3] >> ((i & 7) * 4)) & 0xF;
+        if (!(dir & DIR_VALID))
+            break;
+        int x_dir = acceldirs[dir & 0x7][0];
+        int y_dir = acceldirs[dir & 0x7][1];
+
+        // coalesce into one movement
+        if (x_dir == last_x_dir && y_dir == last_y_dir) {
+            movement * move_p = (movement *) vector_backp(&path->moves);
+            move_p->count += 1;
+        } else {
+            movement move;
+            move.count = 1;
+            // reverse since we're working backwards
+            move.x_dir = -x_dir;
+            move.y_dir = -y_dir;
+            vector_push_back(&path->moves, &move);
+        }
+        last_x_dir = x_dir;
+        last_y_dir = y_dir;
+
+        curr.x += x_dir;
+        curr.y += y_dir;
+    }
+
+    // no path: leave it empty like gen_path does
+    path_dtor(path);
+    path_ctor(path);
 }
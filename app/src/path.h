@@ -18,15 +18,85 @@ typedef struct path_
     vector(movement) moves;
 } path;
 
+// reusable scratch space for searching maps of one size. construct it once
+// and pass it to the search functions to skip allocating and initializing
+// a w*h graph per query: nodes are stamped with the query's epoch, so nodes
+// left over from earlier queries read as unvisited without being rewritten.
+// passing NULL instead builds a scratch workspace for that one call
+// costs are 64 bits wide and nodes are indexed with 64 bits, so neither
+// overflows on maps up to 65536x65536 and beyond
+typedef uint64_t cost_t;    // path cost in Q63.1
+typedef int64_t idx_t;      // node index, x + w * y
+
+typedef struct search_
+{
+    int w;
+    int h;
+    uint32_t epoch;         // current query
+    uint32_t * stamp;       // epoch each node was last written in
+    cost_t * cost;          // cost to reach each node
+    uint8_t * dir;          // direction nibble back toward the start
+    uint32_t * visit;       // visited bitset
+    uint32_t * queued;      // queued bitset
+    coord * queue;          // FIFO storage
+    idx_t * heap;           // heap slots
+    cost_t * key;           // heap keys
+    idx_t * pos;            // heap slot of each node
+    idx_t * buckets;        // bucket queue heads
+    struct search_ * rev;   // backward frontier of bidirectional searches,
+                            // built on first use
+} search;
+
+void search_ctor(search * search, int w, int h);
+void search_dtor(search * search);
+
 void path_ctor(path * path);
 void path_dtor(path * path);
-void path_find(const map * map, const coord * start, const coord * end,
-               path * path, prof * prof);
-void ppath_find(const map * map, const coord * start, const coord * end,
-               path * path);
+void path_find(search * search, const map * map, const coord * start,
+               const coord * end, path * path, prof * prof);
+void dpath_find(search * search, const map * map, const coord * start,
+                const coord * end, path * path, prof * prof);
+void apath_find(search * search, const map * map, const coord * start,
+                const coord * end, path * path, prof * prof);
+void bpath_find(search * search, const map * map, const coord * start,
+                const coord * end, path * path, prof * prof);
+void jpath_find(search * search, const map * map, const coord * start,
+                const coord * end, path * path, prof * prof);
+void ppath_find(search * search, const map * map, const coord * start,
+                const coord * end, path * path, prof * prof);
+// Bellman-Ford split into one tile per thread; threads <= 0 uses every CPU
+void tpath_find(search * search, const map * map, const coord * start,
+                const coord * end, path * path, prof * prof, int threads);
+void bidpath_find(search * search, const map * map, const coord * start,
+                  const coord * end, path * path, prof * prof);
+void biapath_find(search * search, const map * map, const coord * start,
+                  const coord * end, path * path, prof * prof);
+
+// shortest path tree from one start, for routing to many ends: tree_find
+// searches once, then tree_path extracts the path to any end in time
+// proportional to its length. the tree keeps its own workspace and stays
+// valid until the next tree_find
+typedef struct tree_
+{
+    search search;
+    coord start;
+} tree;
+
+void tree_ctor(tree * tree, int w, int h);
+void tree_dtor(tree * tree);
+void tree_find(tree * tree, const map * map, const coord * start, prof * prof);
+void tree_path(tree * tree, const coord * end, path * path);
+// in Q63.1; COST_INF if end is unreachable
+cost_t tree_cost(tree * tree, const coord * end);
+// write the tree's directions to buffer in the accelerator's bram_dir
+// layout: one nibble per cell, 8 cells per word, in row-major order
+void tree_pack(tree * tree, uint32_t * buffer);
 
 void path_load(const map * map, const coord * start, const coord * end,
                const uint32_t * buffer, path * path);
+// like path_load, but only reads the cells on the path
+void path_walk(int w, int h, const coord * start, const coord * end,
+               const uint32_t * buffer, path * path);
 
 #ifdef __cplusplus
 }
@@ -16,6 +16,16 @@ typedef struct prof_
     uint64_t    exec;
     uint64_t    rx;
     uint64_t    poproc;
+    uint64_t    expand;
+    uint64_t    hit;
+    uint64_t    miss;
+    uint64_t    evict;
+    uint64_t    ld_cycles;
+    uint64_t    run_cycles;
+    uint64_t    st_cycles;
+    uint64_t    windows;
+    uint64_t    fallbacks;
+    uint64_t    overlap;
     struct timespec start;
     struct timespec end;
 } prof;
@@ -28,6 +38,16 @@ prof_ctor(prof * prof)
     prof->exec   = 0;   // execution time
     prof->rx     = 0;   // receive time
     prof->poproc = 0;   // post processing (e.g. path generation)
+    prof->expand = 0;   // nodes expanded (software engines)
+    prof->hit    = 0;   // path tree cache lookups answered
+    prof->miss   = 0;   // path tree cache lookups searched
+    prof->evict  = 0;   // path trees evicted to stay in budget
+    prof->ld_cycles  = 0;   // fabric cycles loading the map (accelerator)
+    prof->run_cycles = 0;   // fabric cycles relaxing it
+    prof->st_cycles  = 0;   // fabric cycles storing the directions
+    prof->windows    = 0;   // fabric runs of a tiled route (hwtile.h)
+    prof->fallbacks  = 0;   // tiled routes finished in software
+    prof->overlap    = 0;   // host time hidden behind the fabric (hwpipe.h)
 }
 
 static inline
@@ -60,6 +80,23 @@ void prof_print(prof * prof)
            (float) prof->rx / (float) total * 100.0f);
     printf("Time to postprocess : %llu ns (%0.2f%%)\n", prof->poproc,
            (float) prof->poproc / (float) total * 100.0f);
+    printf("Nodes expanded      : %llu\n", (unsigned long long) prof->expand);
+    if (prof->hit + prof->miss > 0) {
+        printf("Cache hits          : %llu\n", (unsigned long long) prof->hit);
+        printf("Cache misses        : %llu\n", (unsigned long long) prof->miss);
+        printf("Cache evictions     : %llu\n", (unsigned long long) prof->evict);
+    }
+    if (prof->ld_cycles + prof->run_cycles + prof->st_cycles > 0) {
+        printf("Fabric load cycles  : %llu\n", (unsigned long long) prof->ld_cycles);
+        printf("Fabric run cycles   : %llu\n", (unsigned long long) prof->run_cycles);
+        printf("Fabric store cycles : %llu\n", (unsigned long long) prof->st_cycles);
+    }
+    if (prof->windows > 0) {
+        printf("Fabric windows      : %llu\n", (unsigned long long) prof->windows);
+        printf("Software fallbacks  : %llu\n", (unsigned long long) prof->fallbacks);
+    }
+    if (prof->overlap > 0)
+        printf("Host time overlapped: %llu ns\n", (unsigned long long) prof->overlap);
 }
 
 #ifdef __cplusplus
@@ -0,0 +1,338 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include "map.h"
+#include "path.h"
+#include "world.h"
+#include "graph.h"
+#include "replan.h"
+
+// Lifelong Planning A*
+//
+// Each node keeps g, its cost as last expanded, and rhs, the best cost
+// through any of its predecessors' g. Nodes where the two differ are queued
+// by [min(g, rhs) + h, min(g, rhs)] and expanded in that order until the end
+// is consistent and nothing queued could still improve it.
+//
+// A move into a tile pays that tile, so a tile change only changes the
+// costs of moves into its own cell: only its rhs has to be recomputed, and
+// the queue carries the change on from there. start and end never move, so
+// queued keys stay valid across updates.
+
+static inline
+cost_t min_cost(cost_t a, cost_t b)
+{
+    return a < b ? a : b;
+}
+
+static inline
+replan_key node_key(replan * rp, graph * graph, idx_t n)
+{
+    cost_t m = min_cost(graph->cost[n], rp->rhs[n]);
+    replan_key key = {.f = COST_INF, .g = COST_INF};
+    if (m == COST_INF)
+        return key;
+    coord c = {.x = n % graph->w, .y = n / graph->w};
+    key.f = m + octile(&c, &rp->end);
+    key.g = m;
+    return key;
+}
+
+static inline
+bool key_less(replan_key a, replan_key b)
+{
+    return a.f < b.f || (a.f == b.f && a.g < b.g);
+}
+
+// indexed min-heap on two-part keys, like heap.h
+
+static inline
+void queue_set(replan * rp, idx_t slot, idx_t n, replan_key key)
+{
+    rp->heap[slot] = n;
+    rp->key[slot] = key;
+    rp->pos[n] = slot;
+}
+
+static
+void queue_up(replan * rp, idx_t slot)
+{
+    idx_t n = rp->heap[slot];
+    replan_key key = rp->key[slot];
+    while (slot > 0) {
+        idx_t parent = (slot - 1) / 2;
+        if (!key_less(key, rp->key[parent]))
+            break;
+        queue_set(rp, slot, rp->heap[parent], rp->key[parent]);
+        slot = parent;
+    }
+    queue_set(rp, slot, n, key);
+}
+
+static
+void queue_down(replan * rp, idx_t slot)
+{
+    idx_t n = rp->heap[slot];
+    replan_key key = rp->key[slot];
+    for (;;) {
+        idx_t child = slot * 2 + 1;
+        if (child >= rp->size)
+            break;
+        if (child + 1 < rp->size && key_less(rp->key[child + 1], rp->key[child]))
+            child += 1;
+        if (!key_less(rp->key[child], key))
+            break;
+        queue_set(rp, slot, rp->heap[child], rp->key[child]);
+        slot = child;
+    }
+    queue_set(rp, slot, n, key);
+}
+
+// insert n or move it to its new key
+static
+void queue_put(replan * rp, idx_t n, replan_key key)
+{
+    idx_t slot = rp->pos[n];
+    if (slot < 0) {
+        queue_set(rp, rp->size++, n, key);
+        queue_up(rp, rp->size - 1);
+        return;
+    }
+    replan_key old = rp->key[slot];
+    rp->key[slot] = key;
+    if (key_less(key, old))
+        queue_up(rp, slot);
+    else
+        queue_down(rp, slot);
+}
+
+static
+void queue_remove(replan * rp, idx_t n)
+{
+    idx_t slot = rp->pos[n];
+    if (slot < 0)
+        return;
+
+    rp->pos[n] = -1;
+    rp->size -= 1;
+    if (slot == rp->size)
+        return;
+    // the last node fills the hole and moves whichever way its key says
+    idx_t last = rp->heap[rp->size];
+    queue_set(rp, slot, last, rp->key[rp->size]);
+    queue_up(rp, slot);
+    queue_down(rp, rp->pos[last]);
+}
+
+// cost of moving from neighbor dirs[i] of n onto n
+static inline
+cost_t move_cost(const map * map, int x, int y, int i)
+{
+    return dirs[i][2] + (tile_cost(map, x, y) << 1);
+}
+
+// recompute the lookahead of n from its predecessors and requeue it
+static
+void update_node(replan * rp, graph * graph, idx_t n)
+{
+    int x = n % graph->w;
+    int y = n / graph->w;
+    graph_touch(graph, n);
+
+    if (!(x == rp->start.x && y == rp->start.y)) {
+        cost_t rhs = COST_INF;
+        if (tile_cost(rp->map, x, y) != (int32_t) 0xDEADBEEF) {
+            for (int i = 0; i < 8; ++i) {
+                int px = x + dirs[i][0];
+                int py = y + dirs[i][1];
+                if (px < 0 || px >= graph->w || py < 0 || py >= graph->h)
+                    continue;
+
+                idx_t p = graph_idx(graph, px, py);
+                graph_touch(graph, p);
+                if (graph->cost[p] == COST_INF)
+                    continue;
+                rhs = min_cost(rhs, graph->cost[p] + move_cost(rp->map, x, y, i));
+            }
+        }
+        rp->rhs[n] = rhs;
+    }
+
+    if (graph->cost[n] != rp->rhs[n])
+        queue_put(rp, n, node_key(rp, graph, n));
+    else
+        queue_remove(rp, n);
+}
+
+static
+void update_succ(replan * rp, graph * graph, idx_t n)
+{
+    int x = n % graph->w;
+    int y = n / graph->w;
+    for (int i = 0; i < 8; ++i) {
+        int sx = x + dirs[i][0];
+        int sy = y + dirs[i][1];
+        if (sx < 0 || sx >= graph->w || sy < 0 || sy >= graph->h)
+            continue;
+        update_node(rp, graph, graph_idx(graph, sx, sy));
+    }
+}
+
+static
+void compute(replan * rp, graph * graph, prof * prof)
+{
+    idx_t goal = graph_idx(graph, rp->end.x, rp->end.y);
+    graph_touch(graph, goal);
+
+    while (rp->size > 0 &&
+           (key_less(rp->key[0], node_key(rp, graph, goal)) ||
+            rp->rhs[goal] != graph->cost[goal])) {
+        idx_t n = rp->heap[0];
+        queue_remove(rp, n);
+        prof->expand += 1;
+
+        if (graph->cost[n] > rp->rhs[n]) {
+            graph->cost[n] = rp->rhs[n];
+        }
+        else {
+            graph->cost[n] = COST_INF;
+            update_node(rp, graph, n);
+        }
+        update_succ(rp, graph, n);
+    }
+}
+
+// point every cell on the path at its best predecessor, then let gen_path
+// walk it
+static
+void extract(replan * rp, graph * graph, path * path)
+{
+    idx_t n = graph_idx(graph, rp->end.x, rp->end.y);
+    idx_t s = graph_idx(graph, rp->start.x, rp->start.y);
+    path_ctor(path);
+    graph_touch(graph, n);
+    if (graph->cost[n] == COST_INF)
+        return;
+
+    idx_t cells = (idx_t) graph->w * graph->h;
+    for (idx_t steps = 0; n != s && steps < cells; ++steps) {
+        int x = n % graph->w;
+        int y = n / graph->w;
+        cost_t best = COST_INF;
+        int from = -1;
+        for (int i = 0; i < 8; ++i) {
+            int px = x + dirs[i][0];
+            int py = y + dirs[i][1];
+            if (px < 0 || px >= graph->w || py < 0 || py >= graph->h)
+                continue;
+
+            idx_t p = graph_idx(graph, px, py);
+            graph_touch(graph, p);
+            if (graph->cost[p] == COST_INF)
+                continue;
+            cost_t cost = graph->cost[p] + move_cost(rp->map, x, y, i);
+            if (cost < best) {
+                best = cost;
+                from = i;
+            }
+        }
+        if (from < 0)
+            return;
+        graph->dir[n] = dir_codes[from];
+        n = graph_idx(graph, x + dirs[from][0], y + dirs[from][1]);
+    }
+    gen_path(graph, &rp->start, &rp->end, path);
+}
+
+void replan_ctor(replan * rp, int w, int h)
+{
+    idx_t n = (idx_t) w * h;
+    search_ctor(&rp->search, w, h);
+    rp->rhs = (cost_t *) malloc(sizeof(cost_t) * n);
+    rp->key = (replan_key *) malloc(sizeof(replan_key) * n);
+    rp->heap = (idx_t *) malloc(sizeof(idx_t) * n);
+    rp->pos = (idx_t *) malloc(sizeof(idx_t) * n);
+    for (idx_t i = 0; i < n; ++i)
+        rp->pos[i] = -1;
+    rp->size = 0;
+    rp->map = NULL;
+}
+
+void replan_dtor(replan * rp)
+{
+    search_dtor(&rp->search);
+    free(rp->rhs);
+    free(rp->key);
+    free(rp->heap);
+    free(rp->pos);
+}
+
+void replan_find(replan * rp, const map * map, const coord * start,
+                 const coord * end, path * path, prof * prof)
+{
+    graph graph;
+
+    prof_ctor(prof);
+
+    prof_start(prof);
+    if (rp->search.w != map->w || rp->search.h != map->h) {
+        replan_dtor(rp);
+        replan_ctor(rp, map->w, map->h);
+    }
+    rp->map = map;
+    rp->start = *start;
+    rp->end = *end;
+    for (idx_t i = 0; i < rp->size; ++i)
+        rp->pos[rp->heap[i]] = -1;
+    rp->size = 0;
+    for (idx_t i = 0; i < (idx_t) map->w * map->h; ++i)
+        rp->rhs[i] = COST_INF;
+    gen_graph(&graph, &rp->search);
+
+    idx_t s = graph_idx(&graph, start->x, start->y);
+    graph_touch(&graph, s);
+    rp->rhs[s] = 0;
+    queue_put(rp, s, node_key(rp, &graph, s));
+    prof_end(prof); prof->prproc = prof_dt(prof);
+
+    prof_start(prof);
+    compute(rp, &graph, prof);
+    prof_end(prof); prof->exec = prof_dt(prof);
+
+    prof_start(prof);
+    extract(rp, &graph, path);
+    prof_end(prof); prof->poproc = prof_dt(prof);
+}
+
+void replan_update(replan * rp, const coord * changed, int count,
+                   path * path, prof * prof)
+{
+    graph graph;
+
+    prof_ctor(prof);
+
+    prof_start(prof);
+    graph_view(&graph, &rp->search);
+    for (int i = 0; i < count; ++i)
+        update_node(rp, &graph, graph_idx(&graph, changed[i].x, changed[i].y));
+    prof_end(prof); prof->prproc = prof_dt(prof);
+
+    prof_start(prof);
+    compute(rp, &graph, prof);
+    prof_end(prof); prof->exec = prof_dt(prof);
+
+    prof_start(prof);
+    extract(rp, &graph, path);
+    prof_end(prof); prof->poproc = prof_dt(prof);
+}
+
+cost_t replan_cost(replan * rp)
+{
+    graph graph;
+    graph_view(&graph, &rp->search);
+    idx_t i = graph_idx(&graph, rp->end.x, rp->end.y);
+    graph_touch(&graph, i);
+    return graph.cost[i];
+}
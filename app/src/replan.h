@@ -0,0 +1,57 @@
+#ifndef __REPLAN_H__
+#define __REPLAN_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+#include "map.h"
+#include "path.h"
+#include "world.h"
+#include "prof.h"
+
+// incremental planner (LPA*) for one start and end on a map whose tiles
+// change: after replan_find, change tiles with map_put and hand the changed
+// cells to replan_update, which only repairs the part of the search they
+// affect. paths cost exactly what a search from scratch would find
+// queue key [min(g, rhs) + h, min(g, rhs)], compared in that order
+typedef struct replan_key_
+{
+    cost_t f;
+    cost_t g;
+} replan_key;
+
+typedef struct replan_
+{
+    const map * map;
+    coord start;
+    coord end;
+    search search;          // g values and the path's directions
+    cost_t * rhs;           // one-step lookahead costs
+    replan_key * key;       // queue keys
+    idx_t * heap;           // queue slots
+    idx_t * pos;            // queue slot of each node; -1 if not queued
+    idx_t size;             // queued nodes
+} replan;
+
+void replan_ctor(replan * replan, int w, int h);
+void replan_dtor(replan * replan);
+
+// plan from scratch; the map must outlive the planner's use of it
+void replan_find(replan * replan, const map * map, const coord * start,
+                 const coord * end, path * path, prof * prof);
+
+// cells whose tiles changed since the last call
+void replan_update(replan * replan, const coord * changed, int count,
+                   path * path, prof * prof);
+
+// cost of the current path; COST_INF if the end cannot be reached
+cost_t replan_cost(replan * replan);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif//__REPLAN_H__
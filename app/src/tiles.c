@@ -0,0 +1,187 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "tiles.h"
+
+static inline
+uint64_t mix(uint64_t h, uint64_t v)
+{
+    h = (h ^ v) * 0xFF51AFD7ED558CCDull;
+    return h ^ (h >> 32);
+}
+
+static inline
+int log2i(int v)
+{
+    int s = 0;
+    while ((1 << s) < v)
+        ++s;
+    return s;
+}
+
+int tstore_open(tstore * ts, const char * file_name, size_t budget)
+{
+    tile_header header;
+
+    ts->fd = open(file_name, O_RDONLY);
+    if (ts->fd < 0)
+        return 1;
+
+    struct stat st;
+    if (pread(ts->fd, &header, sizeof(header), 0) != sizeof(header) ||
+        fstat(ts->fd, &st) ||
+        header.magic != TILE_MAGIC || header.version != TILE_VERSION ||
+        header.w <= 0 || header.h <= 0 || header.side < 8 ||
+        (header.side & (header.side - 1))) {
+        close(ts->fd);
+        return 1;
+    }
+
+    ts->w = header.w;
+    ts->h = header.h;
+    ts->shift = log2i(header.side);
+    ts->mask = header.side - 1;
+    ts->tw = (header.w + ts->mask) >> ts->shift;
+    ts->th = (header.h + ts->mask) >> ts->shift;
+    ts->words = ((size_t) header.side * header.side) / 8;
+    ts->checksum = header.checksum;
+
+    size_t tiles = (size_t) ts->tw * ts->th;
+    if ((size_t) st.st_size < TILE_DATA + tiles * ts->words * sizeof(uint32_t)) {
+        close(ts->fd);
+        return 1;
+    }
+
+    ts->slots = budget / (ts->words * sizeof(uint32_t));
+    if (ts->slots < TILE_MIN_SLOTS)
+        ts->slots = TILE_MIN_SLOTS;
+    if ((size_t) ts->slots > tiles)
+        ts->slots = tiles;
+
+    ts->slot_of = (int *) malloc(sizeof(int) * tiles);
+    ts->tile_of = (int *) malloc(sizeof(int) * ts->slots);
+    ts->ref = (uint8_t *) calloc(ts->slots, sizeof(uint8_t));
+    ts->data = (uint32_t *) malloc(sizeof(uint32_t) * ts->words * ts->slots);
+    for (size_t i = 0; i < tiles; ++i)
+        ts->slot_of[i] = -1;
+    for (int i = 0; i < ts->slots; ++i)
+        ts->tile_of[i] = -1;
+    ts->hand = 0;
+    ts->last = -1;
+    ts->cur = NULL;
+    ts->faults = 0;
+    ts->error = 0;
+    return 0;
+}
+
+void tstore_close(tstore * ts)
+{
+    close(ts->fd);
+    free(ts->slot_of);
+    free(ts->tile_of);
+    free(ts->ref);
+    free(ts->data);
+}
+
+// the first slot CLOCK finds unreferenced, clearing reference bits on the way
+static
+int clock_victim(tstore * ts)
+{
+    for (;;) {
+        int s = ts->hand;
+        ts->hand = (ts->hand + 1) % ts->slots;
+        if (!ts->ref[s])
+            return s;
+        ts->ref[s] = 0;
+    }
+}
+
+void tstore_switch(tstore * ts, int t)
+{
+    int s = ts->slot_of[t];
+    if (s < 0) {
+        s = clock_victim(ts);
+        if (ts->tile_of[s] >= 0)
+            ts->slot_of[ts->tile_of[s]] = -1;
+
+        uint32_t * data = ts->data + ts->words * s;
+        size_t bytes = sizeof(uint32_t) * ts->words;
+        off_t offset = TILE_DATA + (off_t) t * bytes;
+        if (pread(ts->fd, data, bytes, offset) != (ssize_t) bytes) {
+            memset(data, 0xFF, bytes);
+            ts->error = 1;
+        }
+
+        ts->slot_of[t] = s;
+        ts->tile_of[s] = t;
+        ts->faults += 1;
+    }
+
+    ts->ref[s] = 1;
+    ts->last = t;
+    ts->cur = ts->data + ts->words * s;
+}
+
+int tstore_write(const char * file_name, int w, int h, int side,
+                 tile_rows_fn rows, void * ctx)
+{
+    if (side < 8 || (side & (side - 1)))
+        return 1;
+
+    FILE * file = fopen(file_name, "wb");
+    if (file == NULL)
+        return 1;
+
+    char head[TILE_DATA] = {0};
+    tile_header * header = (tile_header *) head;
+    header->magic = TILE_MAGIC;
+    header->version = TILE_VERSION;
+    header->w = w;
+    header->h = h;
+    header->side = side;
+
+    int tw = (w + side - 1) / side;
+    size_t words = ((size_t) side * side) / 8;
+    uint8_t * costs = (uint8_t *) malloc((size_t) w * side);
+    uint32_t * tile = (uint32_t *) malloc(sizeof(uint32_t) * words);
+    uint64_t checksum = 0x9E3779B97F4A7C15ull;
+
+    int err = fwrite(head, 1, TILE_DATA, file) != TILE_DATA;
+    for (int y0 = 0; y0 < h && !err; y0 += side) {
+        int band = h - y0 < side ? h - y0 : side;
+        err = rows(ctx, costs, y0, band);
+
+        // one band of rows is one row of tiles
+        for (int t = 0; t < tw && !err; ++t) {
+            memset(tile, 0xFF, sizeof(uint32_t) * words);
+            int x0 = t * side;
+            int cols = w - x0 < side ? w - x0 : side;
+            for (int y = 0; y < band; ++y) {
+                for (int x = 0; x < cols; ++x) {
+                    int i = x + side * y;
+                    uint32_t shift = (i & 7) * 4;
+                    uint32_t c = costs[(size_t) w * y + x0 + x] & 0xF;
+                    tile[i >> 3] = (tile[i >> 3] & ~(0xFu << shift)) | c << shift;
+                }
+            }
+            for (size_t i = 0; i < words; ++i)
+                checksum = mix(checksum, tile[i]);
+            err = fwrite(tile, sizeof(uint32_t), words, file) != words;
+        }
+    }
+
+    // the checksum is only known once every tile is written
+    header->checksum = checksum;
+    if (!err)
+        err = fseek(file, 0, SEEK_SET) || fwrite(head, 1, TILE_DATA, file) != TILE_DATA;
+    err |= fclose(file) != 0;
+
+    free(costs);
+    free(tile);
+    return err;
+}
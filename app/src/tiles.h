@@ -0,0 +1,97 @@
+#ifndef __TILES_H__
+#define __TILES_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+// default tile side; 128 x 128 cells are 8 KiB packed
+#define TILE_SIDE 128
+
+// smallest number of tiles the cache holds: a search crossing a tile corner
+// touches four at once
+#define TILE_MIN_SLOTS 4
+
+// tiled map files: a header, then the tiles at TILE_DATA in row-major tile
+// order, each side * side cells of packed 4-bit costs (0xF for walls) in
+// the map's nibble layout within the tile. tiles along the right and
+// bottom edges are padded with walls, so every tile has the same size and
+// its offset follows from its index
+#define TILE_MAGIC 0x4C544B44   // "DKTL"
+#define TILE_VERSION 1
+#define TILE_DATA 64
+
+typedef struct tile_header_
+{
+    uint32_t magic;
+    uint32_t version;
+    int32_t w;
+    int32_t h;
+    int32_t side;           // a power of two, at least 8
+    uint32_t reserved;
+    uint64_t checksum;      // of the tile data as stored
+} tile_header;
+
+// read-only view of a tiled map file through a bounded cache of tiles.
+// tiles are read on first use and evicted in CLOCK order (least recently
+// referenced first, roughly) once the cache is full. not thread safe: the
+// cache is updated by every read
+typedef struct tstore_
+{
+    int fd;
+    int w;
+    int h;
+    int shift;              // log2 of the tile side
+    int mask;               // side - 1
+    int tw;                 // tiles across and down
+    int th;
+    size_t words;           // words per tile
+    uint64_t checksum;
+    int slots;              // tiles the cache holds
+    int * slot_of;          // cache slot of each tile, -1 if not loaded
+    int * tile_of;          // tile in each slot, -1 if empty
+    uint8_t * ref;          // CLOCK reference bits
+    uint32_t * data;        // slots * words
+    int hand;               // next slot CLOCK looks at
+    int last;               // tile of the last read
+    const uint32_t * cur;   // its data
+    uint64_t faults;        // tiles read from the file
+    int error;              // a read failed; its tile reads as walls
+} tstore;
+
+// opens a tiled map file with a cache of budget bytes, rounded down to
+// whole tiles. returns 0 on success
+int tstore_open(tstore * ts, const char * file_name, size_t budget);
+void tstore_close(tstore * ts);
+
+// makes tile t current, reading it in if it is not cached
+void tstore_switch(tstore * ts, int t);
+
+// cost nibble of (x, y)
+static inline
+uint8_t tstore_nibble(tstore * ts, int x, int y)
+{
+    int t = (y >> ts->shift) * ts->tw + (x >> ts->shift);
+    if (t != ts->last)
+        tstore_switch(ts, t);
+    int i = (x & ts->mask) + ((y & ts->mask) << ts->shift);
+    return (ts->cur[i >> 3] >> ((i & 7) * 4)) & 0xF;
+}
+
+// rows of cost nibbles, one per byte, handed to the writer band by band
+typedef int (*tile_rows_fn)(void * ctx, uint8_t * costs, int y0, int rows);
+
+// writes a tiled map file of w x h cells with tiles of side cells. rows
+// reads side rows at a time (fewer for the last band), so a map is written
+// without ever being in memory whole. returns 0 on success
+int tstore_write(const char * file_name, int w, int h, int side,
+                 tile_rows_fn rows, void * ctx);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif//__TILES_H__